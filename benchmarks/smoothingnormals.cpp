@@ -0,0 +1,249 @@
+#include <core/smoothingnormals.h>
+#include <core/threadpool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <tiny_obj_loader.h>
+#include <vector>
+
+using namespace gamestart;
+
+// Runs the per-vertex std::map implementation ComputeSmoothingNormals replaced and the current one
+// on a generated mesh, reports the time of both and fails when their normals differ.
+
+namespace // Local utility functions
+{
+    const int GridSize = 700;
+    const int Repetitions = 3;
+    const float Tolerance = 1e-6f;
+
+    struct vec3
+    {
+        float v[3];
+        vec3()
+        {
+            v[0] = 0.0f;
+            v[1] = 0.0f;
+            v[2] = 0.0f;
+        }
+    };
+
+    void normalizeVector(vec3 &v)
+    {
+        float len2 = v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2];
+        if (len2 > 0.0f)
+        {
+            float len = sqrtf(len2);
+
+            v.v[0] /= len;
+            v.v[1] /= len;
+            v.v[2] /= len;
+        }
+    }
+
+    // The implementation before the flat arrays, as it was
+    void computeSmoothingNormalsWithMap(
+        const tinyobj::attrib_t &attrib,
+        const tinyobj::shape_t &shape,
+        std::map<int, vec3> &smoothVertexNormals)
+    {
+        smoothVertexNormals.clear();
+        std::map<int, vec3>::iterator iter;
+
+        for (size_t f = 0; f < shape.mesh.indices.size() / 3; f++)
+        {
+            // Get the three indexes of the face (all faces are triangular)
+            tinyobj::index_t idx0 = shape.mesh.indices[3 * f + 0];
+            tinyobj::index_t idx1 = shape.mesh.indices[3 * f + 1];
+            tinyobj::index_t idx2 = shape.mesh.indices[3 * f + 2];
+
+            // Get the three vertex indexes and coordinates
+            int vi[3];     // indexes
+            float v[3][3]; // coordinates
+
+            for (int k = 0; k < 3; k++)
+            {
+                vi[0] = idx0.vertex_index;
+                vi[1] = idx1.vertex_index;
+                vi[2] = idx2.vertex_index;
+
+                v[0][k] = attrib.vertices[3 * vi[0] + k];
+                v[1][k] = attrib.vertices[3 * vi[1] + k];
+                v[2][k] = attrib.vertices[3 * vi[2] + k];
+            }
+
+            // Compute the normal of the face
+            float normal[3];
+            CalcNormal(normal, v[0], v[1], v[2]);
+
+            // Add the normal to the three vertexes
+            for (size_t i = 0; i < 3; ++i)
+            {
+                iter = smoothVertexNormals.find(vi[i]);
+                if (iter != smoothVertexNormals.end())
+                {
+                    // add
+                    iter->second.v[0] += normal[0];
+                    iter->second.v[1] += normal[1];
+                    iter->second.v[2] += normal[2];
+                }
+                else
+                {
+                    smoothVertexNormals[vi[i]].v[0] = normal[0];
+                    smoothVertexNormals[vi[i]].v[1] = normal[1];
+                    smoothVertexNormals[vi[i]].v[2] = normal[2];
+                }
+            }
+
+        } // f
+
+        // Normalize the normals, that is, make them unit vectors
+        for (iter = smoothVertexNormals.begin(); iter != smoothVertexNormals.end(); iter++)
+        {
+            normalizeVector(iter->second);
+        }
+    }
+
+    // A bumpy grid with its faces shuffled, some faces degenerate, and a few vertices no face uses
+    void GenerateMesh(
+        tinyobj::attrib_t &attrib,
+        tinyobj::shape_t &shape)
+    {
+        std::mt19937 random(1);
+        std::uniform_real_distribution<float> height(-0.5f, 0.5f);
+
+        const int unused = 16;
+
+        for (int i = 0; i < unused; i++)
+        {
+            attrib.vertices.insert(attrib.vertices.end(), {100.0f, 100.0f, 100.0f});
+        }
+
+        for (int y = 0; y <= GridSize; y++)
+        {
+            for (int x = 0; x <= GridSize; x++)
+            {
+                attrib.vertices.insert(attrib.vertices.end(), {float(x), height(random), float(y)});
+            }
+        }
+
+        std::vector<int> faces;
+        for (int y = 0; y < GridSize; y++)
+        {
+            for (int x = 0; x < GridSize; x++)
+            {
+                int v0 = unused + y * (GridSize + 1) + x;
+                int v1 = v0 + 1;
+                int v2 = v0 + GridSize + 1;
+                int v3 = v2 + 1;
+
+                faces.insert(faces.end(), {v0, v2, v1, v1, v2, v3});
+            }
+        }
+
+        for (int i = 0; i < GridSize; i++)
+        {
+            faces.insert(faces.end(), {unused + i, unused + i, unused + i + 1});
+        }
+
+        std::vector<size_t> order(faces.size() / 3);
+        for (size_t f = 0; f < order.size(); f++)
+        {
+            order[f] = f;
+        }
+        std::shuffle(order.begin(), order.end(), random);
+
+        for (auto f : order)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                tinyobj::index_t index;
+                index.vertex_index = faces[3 * f + c];
+                index.normal_index = -1;
+                index.texcoord_index = -1;
+                shape.mesh.indices.push_back(index);
+            }
+
+            shape.mesh.num_face_vertices.push_back(3);
+            shape.mesh.material_ids.push_back(-1);
+            shape.mesh.smoothing_group_ids.push_back(1);
+        }
+    }
+
+    template <typename TFunction>
+    double Milliseconds(
+        TFunction fn)
+    {
+        double best = 0.0;
+        for (int i = 0; i < Repetitions; i++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+            best = i == 0 ? time : std::min(best, time);
+        }
+
+        return best;
+    }
+} // namespace
+
+int main()
+{
+    tinyobj::attrib_t attrib;
+    tinyobj::shape_t shape;
+    GenerateMesh(attrib, shape);
+
+    spdlog::info("{} vertices, {} faces", attrib.vertices.size() / 3, shape.mesh.indices.size() / 3);
+
+    std::map<int, vec3> mapNormals;
+    auto mapTime = Milliseconds([&]() { computeSmoothingNormalsWithMap(attrib, shape, mapNormals); });
+
+    // Both pools have the calling thread help out, so they run on one thread more than ThreadCount
+    ThreadPool oneWorker(1);
+    ThreadPool allThreads;
+
+    std::vector<float> normals;
+    SmoothingNormalsScratch scratch;
+
+    auto oneWorkerTime = Milliseconds([&]() { ComputeSmoothingNormals(attrib, shape, oneWorker, normals, scratch); });
+
+    std::vector<float> threadedNormals;
+    auto threadedTime = Milliseconds([&]() { ComputeSmoothingNormals(attrib, shape, allThreads, threadedNormals, scratch); });
+
+    spdlog::info("std::map:                 {:8.2f} ms", mapTime);
+    spdlog::info("flat arrays, {:2} threads: {:8.2f} ms ({:.1f}x)", oneWorker.ThreadCount() + 1, oneWorkerTime, mapTime / oneWorkerTime);
+    spdlog::info("flat arrays, {:2} threads: {:8.2f} ms ({:.1f}x)", allThreads.ThreadCount() + 1, threadedTime, mapTime / threadedTime);
+
+    size_t mismatches = 0;
+    for (size_t v = 0; v < attrib.vertices.size() / 3; v++)
+    {
+        auto found = mapNormals.find(static_cast<int>(v));
+
+        for (int k = 0; k < 3; k++)
+        {
+            float expected = found != mapNormals.end() ? found->second.v[k] : 0.0f;
+
+            if (std::fabs(normals[3 * v + k] - expected) > Tolerance || threadedNormals[3 * v + k] != normals[3 * v + k])
+            {
+                if (mismatches++ < 10)
+                {
+                    spdlog::error("vertex {} component {}: {} with the map, {} and {} with flat arrays", v, k, expected, normals[3 * v + k], threadedNormals[3 * v + k]);
+                }
+            }
+        }
+    }
+
+    if (mismatches > 0)
+    {
+        spdlog::error("{} normal components differ", mismatches);
+
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <core/mappedfile.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace gamestart
+{
+
+    // A pack holds every file under the assets directory in a single file:
+    //
+    //   AssetPackHeader
+    //   AssetPackEntry[slotCount]   open addressing hash table on the FNV-1a hash of the name
+    //   name table (namesSize bytes)
+    //   entry data, each entry aligned to AssetPackAlignment
+    //
+    // Names are relative to the assets directory with '/' separators. An entry is either
+    // stored as is, so it can be used straight from the mapping, or zlib compressed
+    // (AssetPackCompressed) and inflated on read.
+
+    const uint32_t AssetPackVersion = 1;
+    const uint64_t AssetPackAlignment = 64;
+    const uint32_t AssetPackCompressed = 1;
+
+    struct AssetPackHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t slotCount;
+        uint64_t slotsOffset;
+        uint64_t namesOffset;
+        uint64_t namesSize;
+    };
+
+    // An empty slot has a nameSize of 0
+    struct AssetPackEntry
+    {
+        uint64_t hash;
+        uint64_t offset;
+        uint64_t size;
+        uint64_t storedSize;
+        uint32_t nameOffset;
+        uint32_t nameSize;
+        uint32_t flags;
+        uint32_t reserved;
+    };
+
+    class AssetPack
+    {
+    public:
+        AssetPack();
+
+        virtual ~AssetPack();
+
+        static std::string PathFor(
+            const std::string &baseDirectory);
+
+        // The name a file under the assets directory has in a pack
+        static std::string NormalizeName(
+            const std::string &name);
+
+        // Packs the named files, relative to baseDirectory. The compressible ones are stored
+        // compressed when that saves at least an eighth, the others are stored as is so they
+        // can be used straight from the mapping.
+        static bool Build(
+            const std::string &packPath,
+            const std::string &baseDirectory,
+            const std::vector<std::string> &names,
+            const std::vector<std::string> &compressibleNames);
+
+        bool Open(
+            const std::string &packPath);
+
+        bool IsOpen() const;
+
+        const AssetPackEntry *Find(
+            const std::string &name) const;
+
+        // Points data into the mapping for stored entries, compressed entries are inflated
+        // into storage first
+        bool Read(
+            const AssetPackEntry &entry,
+            const unsigned char *&data,
+            size_t &size,
+            std::vector<unsigned char> &storage) const;
+
+    private:
+        MappedFile _file;
+        const AssetPackHeader *_header = nullptr;
+        const AssetPackEntry *_slots = nullptr;
+        const char *_names = nullptr;
+    };
+
+} // namespace gamestart
+
+#endif // ASSETPACK_H
@@ -1,33 +1,130 @@
 #ifndef ASSETSMANAGER_H
 #define ASSETSMANAGER_H
 
+#include <core/assetpack.h>
+#include <core/importstats.h>
+#include <core/meshdata.h>
+#include <core/programcache.h>
+#include <core/shaderlibrary.h>
+#include <core/stagingring.h>
+#include <core/threadpool.h>
+#include <core/vertexlayout.h>
+#include <deque>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 namespace gamestart
 {
 
+    // Features of the mesh shader variants, see AssetsManager::GetMeshShader
+    enum MeshShaderFeature : uint32_t
+    {
+        MeshShaderTextured = 1 << 0,
+        MeshShaderAlphaTested = 1 << 1,
+    };
+
     class LoadedMesh
     {
     public:
         GLuint vao;
         GLuint vbo;
+        GLuint ibo;
         int triangleCount;
+        int indexCount;
+        GLenum indexType;
         unsigned int materialId;
+
+        // The vertex shader computes positions as positionOffset + position * positionScale
+        VertexLayout vertexLayout;
+        glm::vec3 positionOffset, positionScale;
+
+        // Model space bounds of the vertices, TransformBounds moves them into world space
+        MeshBounds bounds;
+
+        // Ranges of the index buffer to cull separately, empty unless meshlets are built
+        std::vector<Meshlet> meshlets;
+
+        // Coarser levels, drawn with the same vertex array from their own range of the index buffer
+        std::vector<MeshLod> lods;
+    };
+
+    class TextureStream;
+
+    // Shared by every material using the same image file, owned by the texture cache of the
+    // AssetsManager. textureId stays 0 until the texture is uploaded.
+    class LoadedTexture
+    {
+    public:
+        std::string path;
+        GLuint textureId = 0;
+        int width = 0;
+        int height = 0;
+
+        // Mip levels are streamed in from the smallest one up, residentLevel is the largest
+        // level uploaded so far (0 is full resolution)
+        int levelCount = 1;
+        int residentLevel = 0;
+
+        size_t gpuBytes = 0;
+        bool hasAlpha = false;
+
+        // Set while there are larger levels to stream in, only used on the GL thread
+        std::shared_ptr<TextureStream> stream;
+    };
+
+    class LoadedMaterial
+    {
+    public:
+        glm::vec3 diffuse;
+        std::shared_ptr<LoadedTexture> diffuseTexture;
     };
 
     class LoadedAsset
     {
     public:
-        GLuint shaderId;
+        GLuint shaderId = 0;
         std::vector<LoadedMesh> loadedMeshes;
+        std::vector<LoadedMaterial> materials;
         glm::vec3 bbMin, bbMax;
+
+        // A sphere around the center of the box holding the spheres of all meshes
+        glm::vec3 center;
+        float radius = 0.0f;
+
+        // Set on the GL thread once every mesh of the asset is uploaded
+        bool isResident = false;
+
+        // Set instead when the import failed, the next load of the asset tries again
+        bool isFailed = false;
+
+        // Filled in along with isResident
+        ImportStats importStats;
+
+        // Kept up to date by the AssetsManager: bytes of the vertex and index buffers, the number
+        // of loads not matched by an unload yet and the last frame the asset was loaded or drawn
+        size_t gpuBytes = 0;
+        int references = 0;
+        uint64_t lastUsedFrame = 0;
     };
 
+    class GpuMemoryStats
+    {
+    public:
+        size_t residentBytes = 0;
+
+        // What evicting every unreferenced asset would free, textures still used elsewhere excluded
+        size_t evictableBytes = 0;
+    };
+
+    class ImportScratch;
+    class PendingAsset;
+    class StreamChunk;
+
     class AssetsManager
     {
     public:
@@ -35,22 +132,163 @@ namespace gamestart
 
         virtual ~AssetsManager();
 
+        // Packs the assets directory, with the mesh caches and cooked textures that are up to
+        // date, into the pack the AssetsManager loads from when it exists
+        static bool BuildAssetPack();
+
+        // Vertices are uploaded as full floats unless a caller opts in to one of the smaller,
+        // lossy layouts, see VertexLayout
         std::shared_ptr<LoadedAsset> LoadAsset(
-            const std::string &assetName);
+            const std::string &assetName,
+            VertexLayout vertexLayout = VertexLayout::Float);
 
+        // Returns the asset right away, it is imported on the thread pool and becomes
+        // resident once ProcessUploads has uploaded it
+        std::shared_ptr<LoadedAsset> LoadAssetAsync(
+            const std::string &assetName,
+            VertexLayout vertexLayout = VertexLayout::Float);
+
+        // LoadAssetAsync for a list of distinct names, with references[i] users of assetNames[i].
+        // Returns the assets in the order of the names, the new ones all import in parallel.
+        std::vector<std::shared_ptr<LoadedAsset>> LoadAssetsAsync(
+            const std::vector<std::string> &assetNames,
+            const std::vector<int> &references,
+            VertexLayout vertexLayout = VertexLayout::Float);
+
+        // Uploads imported assets to the GPU, call this on the GL thread once per frame
+        void ProcessUploads();
+
+        // The variant of the mesh shader with these MeshShaderFeature flags. While it is still
+        // compiling, a variant with fewer features is returned.
+        const ShaderProgram *GetMeshShader(
+            uint32_t features);
+
+        void SetUploadBudget(
+            float milliseconds);
+
+        // Asks for the textures of the asset at a resolution fitting screenSize pixels, call this
+        // every frame the asset is drawn. Textures nobody asks for drop back to their smallest mips.
+        void RequestTextureResolution(
+            const std::shared_ptr<LoadedAsset> &asset,
+            float screenSize);
+
+        // Drops references, the asset stays resident until it has to make room for other assets
         void UnloadAsset(
-            std::shared_ptr<LoadedAsset> asset);
+            std::shared_ptr<LoadedAsset> asset,
+            int references = 1);
+
+        // Unreferenced assets are evicted, least recently used first, while the resident bytes
+        // are over the budget
+        void SetGpuMemoryBudget(
+            size_t bytes);
+
+        GpuMemoryStats GetGpuMemoryStats();
+
+        // The stats of every import finished so far added up
+        ImportStats GetImportStats() const;
+
+        // Writes the total and the stats of every loaded asset as JSON
+        bool WriteImportStats(
+            const std::string &path) const;
+
+        // OBJ files larger than this are streamed: only the vertex attributes are kept, the faces
+        // are read back from the file, converted and uploaded a chunk at a time. These are not
+        // welded, optimized or written to a mesh cache. 0, the default, uses a quarter of the GPU
+        // memory budget.
+        void SetStreamingImportThreshold(
+            size_t bytes);
+
+        // Split the shapes of imported meshes into meshlets, see LoadedMesh::meshlets. Mesh
+        // caches written without them are imported again. Streamed OBJ files never get them.
+        void SetBuildMeshlets(
+            bool buildMeshlets);
+
+        // Levels of detail generated for every shape of imported meshes, see LoadedMesh::lods.
+        // Mesh caches written for another count are imported again. Streamed OBJ files get none.
+        void SetLodLevelCount(
+            int lodLevelCount);
 
     private:
         std::string _baseDirectory = ".";
+        AssetPack _pack;
         std::map<std::string, std::shared_ptr<LoadedAsset>> _loadedAssets;
+        std::map<std::string, std::shared_ptr<PendingAsset>> _pendingAssets;
+        std::mutex _uploadQueueMutex;
+        std::deque<std::shared_ptr<PendingAsset>> _uploadQueue;
+        float _uploadBudget = 2.0f;
+        size_t _gpuMemoryBudget = size_t(512) * 1024 * 1024;
+        size_t _streamingImportThreshold = 0;
+        bool _buildMeshlets = false;
+        int _lodLevelCount = 3;
+        ImportStats _importStats;
+
+        // Keyed by canonical path, the count is the number of material records using the texture
+        struct CachedTexture
+        {
+            std::shared_ptr<LoadedTexture> texture;
+            int references = 0;
+        };
+
+        uint64_t _frame = 0;
+
+        std::mutex _texturesMutex;
+        std::map<std::string, CachedTexture> _textures;
 
-        GLuint CompileShader(
-            const std::string &vertShaderStr,
-            const std::string &fragShaderStr);
+        // Safe to call from the thread pool, isNew tells the caller it has to decode the texture
+        std::shared_ptr<LoadedTexture> AcquireTexture(
+            const std::string &canonicalPath,
+            bool &isNew);
+
+        // Deletes the texture once the last material using it is released, call on the GL thread
+        void ReleaseTexture(
+            const std::shared_ptr<LoadedTexture> &texture);
+
+        // Uploads or drops at most one mip level, returns false when there was nothing to do
+        bool StreamTextures();
+
+        // Converts and uploads the next chunk of faces of a streamed OBJ once it is ready
+        void StreamShapes(
+            PendingAsset &pending);
+
+        std::shared_ptr<StreamChunk> StartChunk(
+            PendingAsset &pending,
+            size_t shape,
+            size_t firstTriangle);
+
+        // Imports running at the same time each take their own scratch
+        std::mutex _scratchMutex;
+        std::vector<std::unique_ptr<ImportScratch>> _scratch;
+
+        std::unique_ptr<ImportScratch> AcquireScratch();
+
+        void ReleaseScratch(
+            std::unique_ptr<ImportScratch> scratch);
+
+        void EvictAssets();
+
+        void FreeAsset(
+            LoadedAsset &asset);
+
+        ProgramCache _programCache;
+        ShaderLibrary _meshShaders;
+        StagingRing _stagingRing;
 
-        GLuint _meshWithoutAnimationShaderId = 0;
         GLuint GetMeshWithoutAnimationShader();
+
+        void ImportAsset(
+            PendingAsset &pending);
+
+        bool UploadStep(
+            PendingAsset &pending);
+
+        void FinishAsset(
+            PendingAsset &pending);
+
+        void FinishPendingAsset(
+            std::shared_ptr<PendingAsset> pending);
+
+        // Declared last, so imports still running finish before the members they use are destroyed
+        ThreadPool _threadPool;
     };
 
 } // namespace gamestart
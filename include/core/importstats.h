@@ -0,0 +1,81 @@
+#ifndef IMPORTSTATS_H
+#define IMPORTSTATS_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace gamestart
+{
+
+    // Stages of an asset import, in the order they run
+    enum class ImportStage
+    {
+        FileRead,
+        Parse,
+        NormalGeneration,
+        BufferBuild,
+        Optimize,
+        CacheWrite,
+        TextureDecode,
+        Upload,
+        Count,
+    };
+
+    const char *ImportStageName(
+        ImportStage stage);
+
+    class ImportStageStats
+    {
+    public:
+        double milliseconds = 0.0;
+        uint64_t bytes = 0;
+    };
+
+    // Where the time of one or more imports went. Stages are timed on the thread running them,
+    // work they spread over the thread pool is counted once, as wall time. Mapped files are
+    // paged in while they are parsed, so their read time shows up under Parse.
+    class ImportStats
+    {
+    public:
+        ImportStageStats stages[static_cast<size_t>(ImportStage::Count)];
+
+        int importCount = 0;
+        int meshCacheCount = 0;
+        int streamedCount = 0;
+        int textureCount = 0;
+        uint64_t vertexCount = 0;
+        uint64_t triangleCount = 0;
+
+        ImportStageStats &Stage(
+            ImportStage stage);
+
+        const ImportStageStats &Stage(
+            ImportStage stage) const;
+
+        // Adds the time since start and the bytes the stage produced or consumed
+        void Record(
+            ImportStage stage,
+            std::chrono::steady_clock::time_point start,
+            uint64_t bytes);
+
+        void Add(
+            const ImportStats &other);
+
+        double TotalMilliseconds() const;
+
+        // A JSON object with the counts and an object per stage, keyed by ImportStageName
+        std::string ToJson() const;
+    };
+
+    // Writes {"total": total, "assets": {name: stats, ...}} to path
+    bool WriteImportStats(
+        const std::string &path,
+        const ImportStats &total,
+        const std::map<std::string, ImportStats> &assets);
+
+} // namespace gamestart
+
+#endif // IMPORTSTATS_H
@@ -0,0 +1,59 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace gamestart
+{
+
+    class MappedFile
+    {
+    public:
+        MappedFile();
+
+        MappedFile(
+            const MappedFile &) = delete;
+
+        MappedFile &operator=(
+            const MappedFile &) = delete;
+
+        virtual ~MappedFile();
+
+        bool Open(
+            const std::string &filename);
+
+        void Close();
+
+        bool IsOpen() const;
+
+        // Tells the kernel the mapping is read front to back once, so it reads ahead further
+        // and drops the pages behind the reader sooner
+        void AdviseSequential() const;
+
+        const unsigned char *Data() const;
+
+        size_t Size() const;
+
+    private:
+        const unsigned char *_data = nullptr;
+        size_t _size = 0;
+
+#ifdef _WIN32
+        void *_file = nullptr;
+        void *_mapping = nullptr;
+#else
+        int _fd = -1;
+#endif
+    };
+
+    // Size and last write time of a file, cooked files store this to detect a changed source
+    bool GetFileStamp(
+        const std::string &filename,
+        uint64_t &size,
+        int64_t &time);
+
+} // namespace gamestart
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,195 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <core/mappedfile.h>
+#include <core/meshdata.h>
+#include <core/vertexlayout.h>
+
+#include <cstdint>
+#include <string>
+
+namespace gamestart
+{
+
+    // On-disk layout of a precooked mesh, all offsets are in bytes from the start of the file:
+    //
+    //   MeshCacheHeader
+    //   MeshCacheShape[shapeCount]
+    //   MeshCacheMaterial[materialCount]
+    //   MeshCacheDependency[dependencyCount]
+    //   string table (stringsSize bytes)
+    //   vertex, index and meshlet blobs, each aligned to MeshCacheAlignment
+    //
+    // The cache is only valid for the exact source file it was cooked from, this is checked
+    // against the size and last write time of the source stored in the header. The materials
+    // come from the .mtl files the source names, these are checked the same way against the
+    // dependencies, a file that was missing is stored with size and time 0. Indices are
+    // stored with the size the index buffer uses, indexStride is 2 or 4 bytes. Vertices are
+    // stored in vertexLayout, ready to be copied into the vertex buffer as is. Shapes only
+    // have meshlets when the import that wrote the cache built them. The index blob of a shape
+    // holds its indexCount indices followed by the lodIndexCount indices of its levels of detail.
+
+    const uint32_t MeshCacheVersion = 8;
+    const uint64_t MeshCacheAlignment = 16;
+
+    struct MeshCacheHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+        uint32_t shapeCount;
+        uint32_t materialCount;
+        uint32_t floatsPerVertex;
+        uint32_t stringsSize;
+        uint64_t stringsOffset;
+        float bbMin[3];
+        float bbMax[3];
+        uint32_t vertexLayout;
+        uint32_t vertexStride;
+        uint32_t lodLevelCount;
+        uint32_t dependencyCount;
+    };
+
+    struct MeshCacheShape
+    {
+        int32_t materialId;
+        uint32_t vertexCount;
+        uint64_t vertexOffset;
+        uint64_t vertexSize;
+        uint32_t indexCount;
+        uint32_t indexStride;
+        uint64_t indexOffset;
+        uint64_t indexSize;
+        float bbMin[3];
+        float bbMax[3];
+        float center[3];
+        float radius;
+        uint32_t meshletCount;
+        uint32_t lodCount;
+        uint64_t meshletOffset;
+        uint32_t lodIndexCount;
+        uint32_t reserved;
+        uint64_t lodOffset;
+    };
+
+    struct MeshCacheMeshlet
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float center[3];
+        float radius;
+        float coneAxis[3];
+        float coneCutoff;
+    };
+
+    struct MeshCacheLod
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error;
+        uint32_t reserved;
+    };
+
+    struct MeshCacheMaterial
+    {
+        float diffuse[3];
+        uint32_t diffuseTexnameOffset;
+        uint32_t diffuseTexnameSize;
+        uint32_t reserved;
+    };
+
+    // The path is relative to the directory of the source
+    struct MeshCacheDependency
+    {
+        uint64_t size;
+        int64_t time;
+        uint32_t pathOffset;
+        uint32_t pathSize;
+    };
+
+    class MeshCache
+    {
+    public:
+        MeshCache();
+
+        virtual ~MeshCache();
+
+        static std::string PathFor(
+            const std::string &sourcePath);
+
+        static bool Write(
+            const std::string &cachePath,
+            const std::string &sourcePath,
+            const MeshData &meshData,
+            VertexLayout vertexLayout);
+
+        // Whether the cache is valid and matches the source, whatever its vertex layout
+        static bool IsCurrent(
+            const std::string &cachePath,
+            const std::string &sourcePath);
+
+        // Fails when the cache is stale or was written with a different vertex layout
+        bool Open(
+            const std::string &cachePath,
+            const std::string &sourcePath,
+            VertexLayout vertexLayout);
+
+        // Uses a cache that is already in memory, the data has to outlive the MeshCache. There
+        // is no source to compare against, whoever put the cache there vouches for it.
+        bool Open(
+            const unsigned char *data,
+            size_t size,
+            VertexLayout vertexLayout);
+
+        void Close();
+
+        // Whether every shape with triangles has its meshlets in the cache
+        bool HasMeshlets() const;
+
+        const MeshCacheHeader &Header() const;
+
+        // Bytes of the whole cache
+        size_t Size() const;
+
+        const MeshCacheShape &Shape(
+            size_t index) const;
+
+        const void *ShapeVertices(
+            size_t index) const;
+
+        const void *ShapeIndices(
+            size_t index) const;
+
+        const MeshCacheMeshlet *ShapeMeshlets(
+            size_t index) const;
+
+        const MeshCacheLod *ShapeLods(
+            size_t index) const;
+
+        const MeshCacheMaterial &Material(
+            size_t index) const;
+
+        std::string MaterialDiffuseTexname(
+            size_t index) const;
+
+    private:
+        MappedFile _file;
+        const unsigned char *_data = nullptr;
+        size_t _size = 0;
+        const MeshCacheHeader *_header = nullptr;
+        const MeshCacheShape *_shapes = nullptr;
+        const MeshCacheMaterial *_materials = nullptr;
+        const char *_strings = nullptr;
+
+        // An empty sourcePath skips the check against the source
+        bool Validate(
+            const std::string &sourcePath,
+            VertexLayout vertexLayout) const;
+
+        void SetPointers();
+    };
+
+} // namespace gamestart
+
+#endif // MESHCACHE_H
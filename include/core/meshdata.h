@@ -0,0 +1,113 @@
+#ifndef MESHDATA_H
+#define MESHDATA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace gamestart
+{
+
+    // Interleaved vertex: position(3float), normal(3float), color(3float), texcoord(2float)
+    const int FloatsPerVertex = 3 + 3 + 3 + 2;
+
+    // One vertex in that layout, vertex arrays of the MeshData are arrays of these as floats
+    struct MeshVertex
+    {
+        float position[3];
+        float normal[3];
+        float color[3];
+        float texcoord[2];
+    };
+
+    static_assert(sizeof(MeshVertex) == FloatsPerVertex * sizeof(float), "MeshVertex must not contain padding");
+
+    // Bytes per index in the index buffer, 16 bit whenever the shape has few enough vertices
+    inline size_t IndexSizeFor(
+        size_t vertexCount)
+    {
+        return vertexCount <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t);
+    }
+
+    // Limits of a meshlet, the ones mesh shaders are usually written for
+    const size_t MaxMeshletVertices = 64;
+    const size_t MaxMeshletTriangles = 124;
+
+    // A run of consecutive triangles of a shape's index buffer, with the bounds to cull it by.
+    // Bounds are in model space. The triangles all face away from a camera at position p when
+    // dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius, a coneCutoff of 1
+    // means the triangles point in too many directions for that to ever be true.
+    struct Meshlet
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        glm::vec3 center;
+        float radius;
+        glm::vec3 coneAxis;
+        float coneCutoff;
+    };
+
+    // Bounds in model space. The sphere is centered on the box, a shape without vertices has
+    // an empty box with bbMin above bbMax.
+    struct MeshBounds
+    {
+        glm::vec3 bbMin;
+        glm::vec3 bbMax;
+        glm::vec3 center;
+        float radius;
+    };
+
+    // A coarser level of detail of a shape. Its triangles use the vertices of the shape, its
+    // indices follow the ones of the shape in the index buffer. The error is how far, in model
+    // units, the simplified surface is off from the shape at most.
+    struct MeshLod
+    {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        float error;
+    };
+
+    class MeshDataShape
+    {
+    public:
+        // Unique vertices, every triangle is three entries in indices
+        std::vector<float> vertices;
+        std::vector<uint32_t> indices;
+        int materialId;
+        MeshBounds bounds;
+
+        // Empty unless the import was asked to build them
+        std::vector<Meshlet> meshlets;
+
+        // Indices of all levels back to back, from fine to coarse
+        std::vector<uint32_t> lodIndices;
+        std::vector<MeshLod> lods;
+    };
+
+    class MeshDataMaterial
+    {
+    public:
+        glm::vec3 diffuse;
+        std::string diffuseTexname;
+    };
+
+    // CPU side result of an import, before anything is uploaded to the GPU
+    class MeshData
+    {
+    public:
+        std::vector<MeshDataShape> shapes;
+        std::vector<MeshDataMaterial> materials;
+        glm::vec3 bbMin, bbMax;
+
+        // Levels the import was asked for, shapes stop early when they do not simplify any further
+        int lodLevelCount = 0;
+
+        // Paths of the .mtl files the source asked for, the materials above come from these
+        std::vector<std::string> materialLibraries;
+    };
+
+} // namespace gamestart
+
+#endif // MESHDATA_H
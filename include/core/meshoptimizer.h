@@ -0,0 +1,190 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <core/meshdata.h>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace gamestart
+{
+
+    // Import time passes over an indexed shape, vertices are in the MeshData layout
+    // (FloatsPerVertex floats each). Run them in this order: OptimizeVertexCache,
+    // OptimizeOverdraw, OptimizeVertexFetch.
+
+    const unsigned int VertexCacheSize = 16;
+
+    // Working memory of the passes. The vectors are cleared and refilled, never shrunk, so once
+    // a shape of a similar size has been through them the next one does not allocate.
+    class MeshOptimizerScratch
+    {
+    public:
+        // How a vertex may move while simplifying. Border vertices only slide along the border,
+        // locked ones are on a seam or where the topology is not a manifold and stay where they are.
+        enum class VertexKind : uint8_t
+        {
+            Manifold,
+            Border,
+            Locked,
+        };
+
+        // Sum of squared distances to a set of weighted planes, as the symmetric 4x4 matrix
+        struct Quadric
+        {
+            double xx, xy, xz, yy, yz, zz;
+            double dx, dy, dz, dd;
+            double weight;
+
+            void AddPlane(
+                const glm::dvec3 &normal,
+                double distance,
+                double planeWeight);
+
+            void Add(
+                const Quadric &other);
+
+            // Weighted sum of squared distances from p to the planes
+            double Error(
+                const glm::dvec3 &p) const;
+        };
+
+        struct Collapse
+        {
+            uint32_t from;
+            uint32_t to;
+            double error;
+        };
+
+        // Vertex cache simulation and triangles per vertex
+        std::vector<uint32_t> timestamps;
+        std::vector<uint32_t> remaining;
+        std::vector<uint32_t> offsets;
+        std::vector<uint32_t> adjacency;
+        std::vector<uint32_t> fill;
+
+        // OptimizeVertexCache
+        std::vector<int> cachePositions;
+        std::vector<float> vertexScores;
+        std::vector<float> triangleScores;
+        std::vector<bool> emitted;
+        std::vector<uint32_t> cache;
+        std::vector<uint32_t> newCache;
+
+        // The new triangle order, copied back into the indices when done
+        std::vector<uint32_t> reordered;
+
+        // OptimizeOverdraw
+        std::vector<size_t> hardBoundaries;
+        std::vector<size_t> clusters;
+        std::vector<size_t> clusterOrder;
+        std::vector<float> clusterData;
+        std::vector<float> sortKeys;
+
+        // OptimizeVertexFetch
+        std::vector<uint32_t> remap;
+        std::vector<float> fetched;
+
+        // BuildMeshlets
+        std::vector<uint32_t> owners;
+        std::vector<Meshlet> meshlets;
+        std::vector<glm::vec3> triangleNormals;
+
+        // SimplifyMesh
+        std::vector<uint32_t> positionIds;
+        std::vector<uint32_t> positionTable;
+        std::vector<uint32_t> positionUses;
+        std::vector<uint64_t> edges;
+        std::vector<VertexKind> kinds;
+        std::vector<uint32_t> borderNext;
+        std::vector<uint32_t> borderPrev;
+        std::vector<Quadric> quadrics;
+        std::vector<Collapse> collapses;
+        std::vector<bool> touched;
+
+        // BuildLodChain
+        std::vector<uint32_t> lodLevel;
+        std::vector<uint32_t> lodIndices;
+        std::vector<MeshLod> lods;
+
+        size_t Bytes() const;
+    };
+
+    // acmr: transformed vertices per triangle, atvr: transformed vertices per vertex
+    struct VertexCacheStatistics
+    {
+        float acmr;
+        float atvr;
+    };
+
+    // Simulates a FIFO post-transform cache of VertexCacheSize entries
+    VertexCacheStatistics AnalyzeVertexCache(
+        const std::vector<uint32_t> &indices,
+        size_t vertexCount,
+        MeshOptimizerScratch &scratch);
+
+    // Reorders the triangles for post-transform cache hits (Forsyth, linear speed vertex
+    // cache optimisation)
+    void OptimizeVertexCache(
+        std::vector<uint32_t> &indices,
+        size_t vertexCount,
+        MeshOptimizerScratch &scratch);
+
+    // Splits the cache optimized triangle order into clusters and sorts the clusters so the
+    // ones facing outwards come first. A cluster only ends where its ACMR is at most
+    // threshold times the ACMR of the surrounding run, so the cache efficiency is kept.
+    void OptimizeOverdraw(
+        std::vector<uint32_t> &indices,
+        const std::vector<float> &vertices,
+        MeshOptimizerScratch &scratch,
+        float threshold = 1.05f);
+
+    // Renumbers the vertices in the order the indices first use them, so the vertex fetch
+    // reads the vertex buffer linearly
+    void OptimizeVertexFetch(
+        std::vector<float> &vertices,
+        std::vector<uint32_t> &indices,
+        MeshOptimizerScratch &scratch);
+
+    // Removes triangles by collapsing edges, cheapest first by the quadric error metric, until
+    // at most targetIndexCount indices are left or nothing can be collapsed any more. Vertices
+    // are never moved or added, the result uses the same vertices. Vertices on an open border
+    // only slide along it. Vertices on a seam, where vertices at the same position differ in
+    // normal, color or texture coordinates, stay in place, so UV seams and material borders
+    // keep their shape. Returns the error, an estimate of how far the surface moved in model units.
+    float SimplifyMesh(
+        const std::vector<uint32_t> &indices,
+        const std::vector<float> &vertices,
+        size_t targetIndexCount,
+        std::vector<uint32_t> &result,
+        MeshOptimizerScratch &scratch);
+
+    // Up to levelCount levels of detail, each with about half the triangles of the one before.
+    // The chain ends early when a level would keep most of the triangles of the one before.
+    // Every level is simplified from the full shape and ordered for the vertex cache. The
+    // level indices are appended to lodIndices, firstIndex counts from the end of indices. Both
+    // are appended to once, at the end.
+    void BuildLodChain(
+        const std::vector<uint32_t> &indices,
+        const std::vector<float> &vertices,
+        int levelCount,
+        std::vector<uint32_t> &lodIndices,
+        std::vector<MeshLod> &lods,
+        MeshOptimizerScratch &scratch);
+
+    // Splits the triangles into meshlets of at most MaxMeshletVertices vertices and
+    // MaxMeshletTriangles triangles, in the order they are. Run it last, the cache optimized
+    // order keeps neighbouring triangles together so the meshlets come out compact.
+    void BuildMeshlets(
+        const std::vector<uint32_t> &indices,
+        const std::vector<float> &vertices,
+        std::vector<Meshlet> &meshlets,
+        MeshOptimizerScratch &scratch);
+
+    // The box around the vertex positions and a sphere around its center holding all of them
+    MeshBounds ComputeBounds(
+        const std::vector<float> &vertices);
+
+} // namespace gamestart
+
+#endif // MESHOPTIMIZER_H
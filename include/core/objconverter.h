@@ -0,0 +1,73 @@
+#ifndef OBJCONVERTER_H
+#define OBJCONVERTER_H
+
+#include <core/importstats.h>
+#include <core/meshdata.h>
+#include <core/meshoptimizer.h>
+#include <core/smoothingnormals.h>
+#include <core/threadpool.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <tiny_obj_loader.h>
+#include <vector>
+
+namespace gamestart
+{
+
+    // Working memory of a mesh conversion. The vectors are cleared and refilled, never shrunk, so
+    // once an import of a similar size has run the next one converts without allocating.
+    class ImportScratch
+    {
+    public:
+        std::vector<MeshVertex> soup;
+        std::vector<MeshVertex> welded;
+        std::vector<uint32_t> weldTable;
+
+        // Smoothing normals, three floats per attrib vertex, and what it takes to compute them
+        std::vector<float> smoothVertexNormals;
+        SmoothingNormalsScratch smoothing;
+
+        MeshOptimizerScratch optimizer;
+
+        size_t Bytes() const;
+    };
+
+    // Writes the three vertices of face f of the shape to out[0], out[1] and out[2].
+    // smoothVertexNormals is nullptr when the shape has no smoothing groups.
+    void ConvertFace(
+        const tinyobj::attrib_t &attrib,
+        const tinyobj::shape_t &shape,
+        const std::vector<tinyobj::material_t> &materials,
+        const float *smoothVertexNormals,
+        size_t f,
+        MeshVertex *out);
+
+    // OpenGL viewer does not support texturing with per-face material.
+    int ShapeMaterialId(
+        const tinyobj::shape_t &shape,
+        size_t s,
+        size_t materialCount);
+
+    void ConvertMaterials(
+        const std::vector<tinyobj::material_t> &materials,
+        std::vector<MeshDataMaterial> &result);
+
+    // Turns parsed OBJ shapes into welded, optimized MeshData shapes, with meshlets when asked
+    // for and up to lodLevelCount levels of detail. The materials end with the default one.
+    // Once the scratch has converted a mesh of a similar size, only the vectors of meshData
+    // are allocated.
+    void ConvertObj(
+        MeshData &meshData,
+        const tinyobj::attrib_t &attrib,
+        const std::vector<tinyobj::shape_t> &shapes,
+        const std::vector<tinyobj::material_t> &materials,
+        ThreadPool &threadPool,
+        bool buildMeshlets,
+        int lodLevelCount,
+        ImportScratch &scratch,
+        ImportStats &stats);
+
+} // namespace gamestart
+
+#endif // OBJCONVERTER_H
@@ -0,0 +1,208 @@
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include <core/mappedfile.h>
+#include <core/threadpool.h>
+
+#include <istream>
+#include <map>
+#include <streambuf>
+#include <string>
+#include <tiny_obj_loader.h>
+#include <vector>
+
+namespace gamestart
+{
+
+    class MemoryStreamBuffer : public std::streambuf
+    {
+    public:
+        MemoryStreamBuffer(
+            const char *data,
+            size_t size);
+    };
+
+    // Reads memory through std::istream, without copying it
+    class MemoryStream : private MemoryStreamBuffer, public std::istream
+    {
+    public:
+        MemoryStream(
+            const char *data,
+            size_t size);
+    };
+
+    // Drop-in replacement for tinyobj::MaterialFileReader that maps the .mtl file instead of
+    // reading it through std::ifstream. mtllib names are resolved against the same search
+    // paths, with the same warnings when a file is not found.
+    class MappedMaterialReader : public tinyobj::MaterialReader
+    {
+    public:
+        MappedMaterialReader(
+            const std::string &mtlBaseDir);
+
+        virtual ~MappedMaterialReader();
+
+        virtual bool operator()(
+            const std::string &matId,
+            std::vector<tinyobj::material_t> *materials,
+            std::map<std::string, int> *matMap,
+            std::string *warn,
+            std::string *err) override;
+
+    private:
+        std::string _mtlBaseDir;
+        tinyobj::MaterialFileReader _fileReader;
+    };
+
+    // Same member order as tinyobj's internal vertex_index_t
+    struct ObjIndex
+    {
+        int v_idx, vt_idx, vn_idx;
+    };
+
+    // Face lines with the same material and smoothing group, the 'v', 'vn' and 'vt' records
+    // between them are counted while they are read back
+    struct ObjFaceRun
+    {
+        const char *begin;
+        const char *end;
+        size_t vertexCount;
+        size_t normalCount;
+        size_t texcoordCount;
+        int materialId;
+        unsigned int smoothingId;
+    };
+
+    class ObjStreamShape
+    {
+    public:
+        std::string name;
+        size_t firstRun = 0;
+        size_t runCount = 0;
+
+        // Polygons the ear clipping gives up on have fewer triangles than this
+        size_t triangleCount = 0;
+
+        bool hasSmoothingGroup = false;
+    };
+
+    // An OBJ file parsed by ObjParser::LoadObjForStreaming. Only the positions, normals and
+    // texture coordinates are parsed up front, along with where the faces of every shape are
+    // in the file. The faces are read back and triangulated a part at a time, so the indices
+    // of the whole file are never in memory. The file stays mapped until the stream is gone.
+    class ObjStream
+    {
+    public:
+        ObjStream();
+
+        ObjStream(
+            const ObjStream &) = delete;
+
+        ObjStream &operator=(
+            const ObjStream &) = delete;
+
+        virtual ~ObjStream();
+
+        // Without colors
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::material_t> materials;
+        std::vector<ObjStreamShape> shapes;
+
+        // Reads the faces of the shape from the first one on
+        void Rewind(
+            size_t shape);
+
+        // Replaces the faces in shape.mesh with the next faces of the shape, triangulated like
+        // ObjParser::LoadObj does, as many as fit in maxTriangles. A face that does not fit
+        // on its own is read whole. False when all faces of the shape have been read.
+        bool ReadTriangles(
+            size_t maxTriangles,
+            tinyobj::shape_t &shape);
+
+        // True once all faces of the shape have been read
+        bool AtEnd() const;
+
+    private:
+        friend class ObjParser;
+
+        MappedFile _file;
+        std::vector<ObjFaceRun> _runs;
+
+        // Read position
+        size_t _run = 0;
+        size_t _runEnd = 0;
+        const char *_line = nullptr;
+        size_t _vertexCount = 0;
+        size_t _normalCount = 0;
+        size_t _texcoordCount = 0;
+        std::vector<ObjIndex> _face;
+        std::vector<ObjIndex> _remainingFace;
+
+        void StartRun(
+            size_t run);
+    };
+
+    // Drop-in replacement for tinyobj::LoadObj (triangulated, with default vertex colors)
+    // that tokenizes straight from the mapped file, without copying lines into strings.
+    // Large files are split on line boundaries, the chunks are parsed on all threads of the
+    // pool and merged in file order, the result is bit-identical to tinyobj. Files using
+    // records this parser does not handle (l, p, t and vw) are passed on to tinyobj.
+    class ObjParser
+    {
+    public:
+        ObjParser(
+            ThreadPool &threadPool);
+
+        virtual ~ObjParser();
+
+        bool LoadObj(
+            tinyobj::attrib_t *attrib,
+            std::vector<tinyobj::shape_t> *shapes,
+            std::vector<tinyobj::material_t> *materials,
+            std::string *warn,
+            std::string *err,
+            const char *filename,
+            const char *mtl_basedir);
+
+        // Parses an OBJ file that is already in memory, materials are read through materialReader
+        bool LoadObj(
+            tinyobj::attrib_t *attrib,
+            std::vector<tinyobj::shape_t> *shapes,
+            std::vector<tinyobj::material_t> *materials,
+            std::string *warn,
+            std::string *err,
+            const char *data,
+            size_t size,
+            tinyobj::MaterialReader *materialReader);
+
+        // The mtllib names the last LoadObj asked the material reader for, in order, including
+        // the ones it did not find
+        const std::vector<std::string> &MaterialLibraries() const;
+
+        // Parses an OBJ file for streaming, see ObjStream. Polygons are triangulated against
+        // all vertices of the file rather than the ones before the next group. False, with
+        // the reason in err, for files LoadObj would pass on to tinyobj or fail to parse.
+        bool LoadObjForStreaming(
+            ObjStream &stream,
+            std::string *warn,
+            std::string *err,
+            const char *filename,
+            const char *mtl_basedir);
+
+        // The data has to stay valid while the stream is read
+        bool LoadObjForStreaming(
+            ObjStream &stream,
+            std::string *warn,
+            std::string *err,
+            const char *data,
+            size_t size,
+            tinyobj::MaterialReader *materialReader);
+
+    private:
+        ThreadPool &_threadPool;
+        std::vector<std::string> _materialLibraries;
+    };
+
+} // namespace gamestart
+
+#endif // OBJPARSER_H
@@ -0,0 +1,70 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <cstdint>
+#include <glad/glad.h>
+#include <string>
+
+namespace gamestart
+{
+
+    // Linked programs saved with glGetProgramBinary, one file per program:
+    //
+    //   ProgramCacheHeader
+    //   program binary (binarySize bytes)
+    //
+    // A program is found by a hash of its sources and the GL vendor, renderer and version
+    // strings, so a driver update never gets handed an old binary. Drivers may still
+    // reject a binary, the program is then compiled from source again.
+
+    const uint32_t ProgramCacheVersion = 1;
+
+    struct ProgramCacheHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t binarySize;
+    };
+
+    class ProgramCache
+    {
+    public:
+        ProgramCache();
+
+        virtual ~ProgramCache();
+
+        // Only valid once gladLoadGL has run
+        static bool IsSupported();
+
+        void SetDirectory(
+            const std::string &directory);
+
+        uint64_t KeyFor(
+            const std::string &vertShaderStr,
+            const std::string &fragShaderStr);
+
+        // Returns 0 when there is no usable binary for the key
+        GLuint Load(
+            uint64_t key);
+
+        // Call before linking a program that will be stored
+        static void MarkRetrievable(
+            GLuint program);
+
+        bool Store(
+            uint64_t key,
+            GLuint program);
+
+    private:
+        std::string _directory;
+        std::string _driver;
+
+        std::string PathFor(
+            uint64_t key) const;
+    };
+
+} // namespace gamestart
+
+#endif // PROGRAMCACHE_H
@@ -0,0 +1,96 @@
+#ifndef SHADERLIBRARY_H
+#define SHADERLIBRARY_H
+
+#include <core/programcache.h>
+#include <core/shaderprogram.h>
+
+#include <cstdint>
+#include <glad/glad.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace gamestart
+{
+
+    // Sources a family of shader variants is generated from. Bit i of a variant's feature
+    // mask adds "#define features[i]" to both stages, right after the #version line.
+    class ShaderSources
+    {
+    public:
+        std::string vertex;
+        std::string fragment;
+
+        // Bound to locations 0, 1, 2, ... in this order
+        std::vector<std::string> attributes;
+
+        std::vector<std::string> features;
+    };
+
+    // Compiles the variants of a shader as they are asked for, without stalling the frame.
+    // With KHR_parallel_shader_compile the driver compiles on its own threads and Update
+    // polls for completion, without it Update compiles one variant per call. Until a variant
+    // is ready, Get returns a ready variant with a subset of its features.
+    class ShaderLibrary
+    {
+    public:
+        ShaderLibrary(
+            ProgramCache &programCache,
+            const ShaderSources &sources);
+
+        virtual ~ShaderLibrary();
+
+        // Only the variant without any features is compiled blocking, it is the last fallback.
+        // Returns nullptr when that one does not compile.
+        const ShaderProgram *Get(
+            uint32_t features);
+
+        // Call once per frame on the GL thread
+        void Update();
+
+    private:
+        enum class VariantState
+        {
+            Compiling,
+            Linking,
+            Ready,
+            Failed,
+        };
+
+        struct Variant
+        {
+            VariantState state = VariantState::Compiling;
+            uint64_t cacheKey = 0;
+            GLuint vertShader = 0;
+            GLuint fragShader = 0;
+            GLuint program = 0;
+
+            // Set once the program is linked and reflected, it owns the program from then on
+            std::unique_ptr<ShaderProgram> reflected;
+        };
+
+        ProgramCache &_programCache;
+        ShaderSources _sources;
+        bool _isParallel = false;
+        std::map<uint32_t, Variant> _variants;
+
+        std::map<uint32_t, Variant>::iterator Start(
+            uint32_t features);
+
+        // Moves the variant on as far as the driver allows, or all the way when wait is set
+        void Advance(
+            Variant &variant,
+            bool wait);
+
+        void Finish(
+            Variant &variant);
+
+        std::string Permutation(
+            const std::string &source,
+            uint32_t features) const;
+    };
+
+} // namespace gamestart
+
+#endif // SHADERLIBRARY_H
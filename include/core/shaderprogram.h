@@ -0,0 +1,109 @@
+#ifndef SHADERPROGRAM_H
+#define SHADERPROGRAM_H
+
+#include <cstdint>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+namespace gamestart
+{
+
+    // Uniforms the engine sets every draw, their locations are resolved once when the
+    // program is reflected
+    enum class ShaderUniform
+    {
+        Projection,
+        Model,
+        PositionOffset,
+        PositionScale,
+        Texture,
+        Count,
+    };
+
+    // An active uniform or attribute. Arrays are listed once, without the "[0]" suffix.
+    struct ShaderVariable
+    {
+        std::string name;
+        GLint location;
+        GLenum type;
+        GLint size;
+    };
+
+    struct ShaderUniformBlock
+    {
+        std::string name;
+        GLuint index;
+        GLint dataSize;
+    };
+
+    // A linked program with the tables of its active uniforms, uniform blocks and attributes.
+    // The setters expect the program to be in use.
+    class ShaderProgram
+    {
+    public:
+        // Takes ownership of the linked program
+        explicit ShaderProgram(
+            GLuint id);
+
+        ShaderProgram(
+            const ShaderProgram &) = delete;
+
+        ShaderProgram &operator=(
+            const ShaderProgram &) = delete;
+
+        virtual ~ShaderProgram();
+
+        GLuint Id() const;
+
+        void Use() const;
+
+        const std::vector<ShaderVariable> &Uniforms() const;
+
+        const std::vector<ShaderUniformBlock> &UniformBlocks() const;
+
+        const std::vector<ShaderVariable> &Attributes() const;
+
+        // For uniforms without a ShaderUniform, resolve once and keep the location. Returns -1
+        // when the program does not use the uniform.
+        GLint UniformLocation(
+            const std::string &name) const;
+
+        bool HasUniform(
+            ShaderUniform uniform) const;
+
+        void Set(
+            ShaderUniform uniform,
+            int value) const;
+
+        void Set(
+            ShaderUniform uniform,
+            float value) const;
+
+        void Set(
+            ShaderUniform uniform,
+            const glm::vec3 &value) const;
+
+        void Set(
+            ShaderUniform uniform,
+            const glm::vec4 &value) const;
+
+        void Set(
+            ShaderUniform uniform,
+            const glm::mat4 &value) const;
+
+    private:
+        GLuint _id;
+        std::vector<ShaderVariable> _uniforms;
+        std::vector<ShaderUniformBlock> _uniformBlocks;
+        std::vector<ShaderVariable> _attributes;
+        GLint _locations[static_cast<size_t>(ShaderUniform::Count)];
+        GLenum _types[static_cast<size_t>(ShaderUniform::Count)];
+
+        void Reflect();
+    };
+
+} // namespace gamestart
+
+#endif // SHADERPROGRAM_H
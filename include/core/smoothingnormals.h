@@ -0,0 +1,67 @@
+#ifndef SMOOTHINGNORMALS_H
+#define SMOOTHINGNORMALS_H
+
+#include <core/threadpool.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <tiny_obj_loader.h>
+#include <vector>
+
+namespace gamestart
+{
+
+    // Working memory of ComputeSmoothingNormals. The vectors are cleared and refilled, never
+    // shrunk, so once a shape of a similar size has been through it the next one does not allocate.
+    class SmoothingNormalsScratch
+    {
+    public:
+        std::vector<float> faceNormals;
+        std::vector<uint32_t> vertexFaceOffsets;
+        std::vector<uint32_t> vertexFaceFill;
+        std::vector<uint32_t> vertexFaces;
+
+        size_t Bytes() const;
+    };
+
+    // True when any face of the shape is in a smoothing group
+    bool HasSmoothingGroup(
+        const tinyobj::shape_t &shape);
+
+    // Normalized normal of the triangle v0, v1, v2. Degenerate triangles get a zero normal.
+    void CalcNormal(
+        float N[3],
+        const float v0[3],
+        const float v1[3],
+        const float v2[3]);
+
+    // Smoothing normals for the vertices the shape uses, written into normals with three floats
+    // per attrib vertex. The normals of the other vertices are left as they are. Face normals are
+    // summed in face order, per vertex, so the result does not depend on how the work is split
+    // over the threads.
+    void ComputeSmoothingNormals(
+        const tinyobj::attrib_t &attrib,
+        const tinyobj::shape_t &shape,
+        ThreadPool &threadPool,
+        std::vector<float> &normals,
+        SmoothingNormalsScratch &scratch);
+
+    // For shapes that are read a part at a time. Adds the normals of the faces in the part to
+    // the vertices they use, in normals with three floats per attrib vertex that start out at
+    // zero, and widens [vertexBegin, vertexEnd) to the vertices it touched. Normalizing that
+    // range once all parts are in gives the same normals as ComputeSmoothingNormals.
+    void AccumulateSmoothingNormals(
+        const tinyobj::attrib_t &attrib,
+        const tinyobj::shape_t &part,
+        std::vector<float> &normals,
+        int &vertexBegin,
+        int &vertexEnd);
+
+    void NormalizeSmoothingNormals(
+        std::vector<float> &normals,
+        int vertexBegin,
+        int vertexEnd);
+
+} // namespace gamestart
+
+#endif // SMOOTHINGNORMALS_H
@@ -0,0 +1,77 @@
+#ifndef STAGINGRING_H
+#define STAGINGRING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <glad/glad.h>
+
+namespace gamestart
+{
+
+    // A persistently mapped buffer that uploads pass through on their way to their final buffer.
+    // Data is copied into the mapping and from there with glCopyBufferSubData, so the driver
+    // neither copies it again nor stalls on the destination. Space is handed out round the
+    // ring and only written again once the fence of the frame that used it has signaled.
+    class StagingRing
+    {
+    public:
+        explicit StagingRing(
+            size_t size);
+
+        StagingRing(
+            const StagingRing &) = delete;
+
+        StagingRing &operator=(
+            const StagingRing &) = delete;
+
+        virtual ~StagingRing();
+
+        // Only valid once gladLoadGL has run
+        static bool IsSupported();
+
+        // Creates the ring on first use. False when buffer storage is not supported or the
+        // buffer could not be mapped, uploads have to go through glBufferSubData then.
+        bool IsAvailable();
+
+        // Copies size bytes of data to offset in buffer. Uploads larger than the ring go in
+        // pieces, waiting for earlier frames when the ring is full.
+        void Upload(
+            GLuint buffer,
+            size_t offset,
+            const void *data,
+            size_t size);
+
+        // Fences the copies issued since the last call, call on the GL thread once per frame
+        void Fence();
+
+    private:
+        struct Region
+        {
+            GLsync fence;
+            size_t bytes;
+        };
+
+        size_t _size;
+        GLuint _buffer = 0;
+        uint8_t *_mapped = nullptr;
+        bool _failed = false;
+
+        // The _inUse bytes before _head, round the ring, are still read by the GPU or about to be
+        size_t _head = 0;
+        size_t _inUse = 0;
+        size_t _unfencedBytes = 0;
+        std::deque<Region> _regions;
+
+        bool Create();
+
+        size_t Allocate(
+            size_t size);
+
+        void Retire(
+            bool wait);
+    };
+
+} // namespace gamestart
+
+#endif // STAGINGRING_H
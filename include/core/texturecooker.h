@@ -0,0 +1,96 @@
+#ifndef TEXTURECOOKER_H
+#define TEXTURECOOKER_H
+
+#include <core/mappedfile.h>
+
+#include <cstdint>
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+
+namespace gamestart
+{
+
+    // A cooked texture is a KTX 1 file next to the source image holding the complete mip
+    // chain in a block compressed format:
+    //
+    //   BC1 (GL_COMPRESSED_RGB_S3TC_DXT1_EXT)   images without alpha, or with opaque alpha
+    //   BC3 (GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)  images with alpha
+    //   BC5 (GL_COMPRESSED_RG_RGTC2)            two channel images
+    //
+    // The size and last write time of the source are stored in the key/value data, a cooked
+    // texture is only used as long as they match the source.
+
+    const uint32_t CookedTextureVersion = 1;
+
+    class CookedTextureLevel
+    {
+    public:
+        int width;
+        int height;
+        const unsigned char *data;
+        size_t size;
+    };
+
+    class CookedTexture
+    {
+    public:
+        CookedTexture();
+
+        virtual ~CookedTexture();
+
+        static std::string PathFor(
+            const std::string &sourcePath);
+
+        // The format Cook would use for these pixels
+        static GLenum FormatFor(
+            const unsigned char *pixels,
+            int width,
+            int height,
+            int components);
+
+        // Only valid once gladLoadGL has run, the result does not change after that so this
+        // is fine to call from the thread pool
+        static bool IsFormatSupported(
+            GLenum internalFormat);
+
+        static bool Cook(
+            const std::string &cookedPath,
+            const std::string &sourcePath,
+            const unsigned char *pixels,
+            int width,
+            int height,
+            int components);
+
+        bool Open(
+            const std::string &cookedPath,
+            const std::string &sourcePath);
+
+        // Uses a cooked texture that is already in memory, the data has to outlive the
+        // CookedTexture. The stamp is not checked, there is no source to compare against.
+        bool Open(
+            const unsigned char *data,
+            size_t size);
+
+        GLenum InternalFormat() const;
+
+        size_t LevelCount() const;
+
+        const CookedTextureLevel &Level(
+            size_t index) const;
+
+    private:
+        MappedFile _file;
+        GLenum _internalFormat = 0;
+        std::vector<CookedTextureLevel> _levels;
+
+        // An empty sourcePath skips the stamp check
+        bool Parse(
+            const unsigned char *data,
+            uint64_t size,
+            const std::string &sourcePath);
+    };
+
+} // namespace gamestart
+
+#endif // TEXTURECOOKER_H
@@ -0,0 +1,55 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gamestart
+{
+
+    class ThreadPool
+    {
+    public:
+        // threadCount 0 picks one worker less than the number of hardware threads, the
+        // thread calling ParallelFor does its share of the work as well
+        ThreadPool(
+            size_t threadCount = 0);
+
+        ThreadPool(
+            const ThreadPool &) = delete;
+
+        ThreadPool &operator=(
+            const ThreadPool &) = delete;
+
+        virtual ~ThreadPool();
+
+        size_t ThreadCount() const;
+
+        void Enqueue(
+            std::function<void()> task);
+
+        // Calls body for every index in [0, count) and returns when all calls are done. The
+        // calling thread keeps picking up indices itself, so this is safe to use from a task
+        // that is already running on the pool.
+        void ParallelFor(
+            size_t count,
+            const std::function<void(size_t)> &body);
+
+    private:
+        std::vector<std::thread> _threads;
+        std::deque<std::function<void()>> _tasks;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        bool _stopping = false;
+
+        void WorkerMain();
+    };
+
+} // namespace gamestart
+
+#endif // THREADPOOL_H
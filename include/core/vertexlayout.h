@@ -0,0 +1,59 @@
+#ifndef VERTEXLAYOUT_H
+#define VERTEXLAYOUT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace gamestart
+{
+
+    // How the vertices of a mesh are stored in the vertex buffer, the attributes are always
+    // bound to the same locations: 0 position, 1 normal, 2 color and 3 texcoords.
+    //
+    //   Float            44 bytes, every attribute as float (the layout of MeshData)
+    //   Packed           24 bytes, float3 position, 2_10_10_10 normal, ubyte4 color, half2 uv
+    //   PackedQuantized  20 bytes, like Packed but with a ushort4 position relative to the
+    //                    bounding box of the asset, see positionOffset/positionScale on LoadedMesh
+    enum class VertexLayout : uint32_t
+    {
+        Float = 0,
+        Packed = 1,
+        PackedQuantized = 2,
+    };
+
+    bool IsValidVertexLayout(
+        uint32_t layout);
+
+    size_t VertexStrideFor(
+        VertexLayout layout);
+
+    // Converts vertices in the MeshData layout (FloatsPerVertex floats each) to the given layout
+    void PackVertices(
+        VertexLayout layout,
+        const float *vertices,
+        size_t vertexCount,
+        const glm::vec3 &bbMin,
+        const glm::vec3 &bbMax,
+        std::vector<unsigned char> &packed);
+
+    // The values the vertex shader uses to turn a stored position back into model space
+    void PositionDequantization(
+        VertexLayout layout,
+        const glm::vec3 &bbMin,
+        const glm::vec3 &bbMax,
+        glm::vec3 &offset,
+        glm::vec3 &scale);
+
+    // Needs a current GL context, falls back to Float when the driver cannot fetch packed normals
+    VertexLayout SupportedVertexLayout(
+        VertexLayout layout);
+
+    // Sets the attribute pointers for the vertex buffer bound to GL_ARRAY_BUFFER
+    void SetupVertexAttributes(
+        VertexLayout layout);
+
+} // namespace gamestart
+
+#endif // VERTEXLAYOUT_H
@@ -1,17 +1,68 @@
 #ifndef TRANSFORMCOMPONENT_H
 #define TRANSFORMCOMPONENT_H
 
+#include <cmath>
+#include <core/meshdata.h>
 #include <glm/glm.hpp>
 
 namespace gamestart
 {
 
+    // The rotation is a quaternion (x, y, z, w), all zeros counts as no rotation
     struct TransformComponent
     {
         glm::vec3 position;
         glm::vec4 rotation;
     };
 
+    // Model space bounds moved into world space. The box is the one around the rotated box, so
+    // it can be looser than the box around the rotated vertices.
+    inline MeshBounds TransformBounds(
+        const MeshBounds &bounds,
+        const TransformComponent &transform)
+    {
+        auto q = glm::vec3(transform.rotation);
+        auto w = transform.rotation.w;
+
+        auto lengthSquared = glm::dot(q, q) + w * w;
+        if (lengthSquared > 0.0f)
+        {
+            auto invLength = 1.0f / std::sqrt(lengthSquared);
+            q *= invLength;
+            w *= invLength;
+        }
+        else
+        {
+            w = 1.0f;
+        }
+
+        auto rotate = [&](const glm::vec3 &v) {
+            auto t = 2.0f * glm::cross(q, v);
+
+            return v + w * t + glm::cross(q, t);
+        };
+
+        MeshBounds result = bounds;
+        result.center = rotate(bounds.center) + transform.position;
+
+        if (bounds.bbMin.x > bounds.bbMax.x || bounds.bbMin.y > bounds.bbMax.y || bounds.bbMin.z > bounds.bbMax.z)
+        {
+            return result;
+        }
+
+        auto boxCenter = rotate((bounds.bbMin + bounds.bbMax) * 0.5f) + transform.position;
+        auto extents = (bounds.bbMax - bounds.bbMin) * 0.5f;
+
+        auto worldExtents = glm::abs(rotate(glm::vec3(1.0f, 0.0f, 0.0f))) * extents.x +
+                            glm::abs(rotate(glm::vec3(0.0f, 1.0f, 0.0f))) * extents.y +
+                            glm::abs(rotate(glm::vec3(0.0f, 0.0f, 1.0f))) * extents.z;
+
+        result.bbMin = boxCenter - worldExtents;
+        result.bbMax = boxCenter + worldExtents;
+
+        return result;
+    }
+
 } // namespace gamestart
 
 #endif // TRANSFORMCOMPONENT_H
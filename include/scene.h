@@ -23,6 +23,11 @@ namespace gamestart
             entt::entity e,
             const std::string &assetName);
 
+        // World space bounds of the asset of the entity, false until the asset is resident
+        bool GetWorldBounds(
+            entt::entity e,
+            MeshBounds &bounds) const;
+
         virtual void Initialize(
             AssetsManager &assetsManager);
 
@@ -31,6 +36,7 @@ namespace gamestart
             int height);
 
         virtual void OnUpdate(
+            AssetsManager &assetsManager,
             uint32_t time);
 
         virtual void Cleanup(
@@ -38,6 +44,8 @@ namespace gamestart
 
     private:
         entt::registry m_Registry;
+        int m_Width = 0;
+        int m_Height = 0;
     };
 
 } // namespace gamestart
@@ -0,0 +1,545 @@
+#include <core/assetpack.h>
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <stb_image.h>
+
+using namespace gamestart;
+
+static const char AssetPackMagic[4] = {'G', 'S', 'P', 'K'};
+
+static_assert(sizeof(AssetPackHeader) == 40, "AssetPackHeader must not contain padding");
+static_assert(sizeof(AssetPackEntry) == 48, "AssetPackEntry must not contain padding");
+
+namespace // Local utility functions
+{
+    uint64_t AlignUp(
+        uint64_t value,
+        uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    uint64_t HashName(
+        const std::string &name)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (auto c : name)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    // Writes a zlib stream (RFC 1950) holding a single deflate block with the fixed Huffman
+    // codes, matches are found with hash chains. stb_image only inflates, this is the other half.
+    class Deflater
+    {
+    public:
+        std::vector<unsigned char> out;
+
+        void Compress(
+            const unsigned char *data,
+            size_t size)
+        {
+            const size_t WindowSize = 32768;
+            const size_t MinMatch = 3;
+            const size_t MaxMatch = 258;
+            const int MaxChainLength = 32;
+            const size_t HashSize = 1 << 15;
+
+            std::vector<int64_t> head(HashSize, -1);
+            std::vector<int64_t> previous(size, -1);
+
+            auto hashAt = [data](size_t i) {
+                return ((uint32_t(data[i]) << 10) ^ (uint32_t(data[i + 1]) << 5) ^ uint32_t(data[i + 2])) & (HashSize - 1);
+            };
+
+            auto insert = [&](size_t i) {
+                if (i + MinMatch <= size)
+                {
+                    auto h = hashAt(i);
+                    previous[i] = head[h];
+                    head[h] = static_cast<int64_t>(i);
+                }
+            };
+
+            // No preset dictionary, fastest compression level
+            out.push_back(0x78);
+            out.push_back(0x01);
+
+            // Final block with fixed codes
+            WriteBits(1, 1);
+            WriteBits(1, 2);
+
+            size_t i = 0;
+            while (i < size)
+            {
+                size_t bestLength = 0;
+                size_t bestDistance = 0;
+
+                if (i + MinMatch <= size)
+                {
+                    auto maxLength = std::min(MaxMatch, size - i);
+                    auto candidate = head[hashAt(i)];
+
+                    for (int chain = 0; candidate >= 0 && chain < MaxChainLength; chain++)
+                    {
+                        auto distance = i - static_cast<size_t>(candidate);
+                        if (distance > WindowSize)
+                        {
+                            break;
+                        }
+
+                        size_t length = 0;
+                        while (length < maxLength && data[static_cast<size_t>(candidate) + length] == data[i + length]) length++;
+
+                        if (length > bestLength)
+                        {
+                            bestLength = length;
+                            bestDistance = distance;
+
+                            if (length == maxLength)
+                            {
+                                break;
+                            }
+                        }
+
+                        candidate = previous[static_cast<size_t>(candidate)];
+                    }
+                }
+
+                if (bestLength >= MinMatch)
+                {
+                    WriteMatch(bestLength, bestDistance);
+
+                    for (size_t k = 0; k < bestLength; k++)
+                    {
+                        insert(i + k);
+                    }
+                    i += bestLength;
+                }
+                else
+                {
+                    WriteSymbol(data[i]);
+                    insert(i);
+                    i++;
+                }
+            }
+
+            WriteSymbol(256);
+
+            if (_bitCount > 0)
+            {
+                out.push_back(static_cast<unsigned char>(_bitBuffer));
+            }
+
+            uint32_t a = 1, b = 0;
+            for (size_t k = 0; k < size; k++)
+            {
+                a = (a + data[k]) % 65521;
+                b = (b + a) % 65521;
+            }
+
+            auto adler = (b << 16) | a;
+            for (int shift = 24; shift >= 0; shift -= 8)
+            {
+                out.push_back(static_cast<unsigned char>(adler >> shift));
+            }
+        }
+
+    private:
+        uint32_t _bitBuffer = 0;
+        int _bitCount = 0;
+
+        void WriteBits(
+            uint32_t value,
+            int count)
+        {
+            _bitBuffer |= value << _bitCount;
+            _bitCount += count;
+
+            while (_bitCount >= 8)
+            {
+                out.push_back(static_cast<unsigned char>(_bitBuffer));
+                _bitBuffer >>= 8;
+                _bitCount -= 8;
+            }
+        }
+
+        // Huffman codes are stored starting with their most significant bit
+        void WriteCode(
+            uint32_t code,
+            int length)
+        {
+            uint32_t reversed = 0;
+            for (int k = 0; k < length; k++)
+            {
+                reversed |= ((code >> k) & 1) << (length - 1 - k);
+            }
+
+            WriteBits(reversed, length);
+        }
+
+        void WriteSymbol(
+            uint32_t symbol)
+        {
+            if (symbol < 144)
+            {
+                WriteCode(0x30 + symbol, 8);
+            }
+            else if (symbol < 256)
+            {
+                WriteCode(0x190 + symbol - 144, 9);
+            }
+            else if (symbol < 280)
+            {
+                WriteCode(symbol - 256, 7);
+            }
+            else
+            {
+                WriteCode(0xc0 + symbol - 280, 8);
+            }
+        }
+
+        void WriteMatch(
+            size_t length,
+            size_t distance)
+        {
+            static const uint16_t lengthBase[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+            static const uint8_t lengthExtra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+            static const uint16_t distanceBase[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+            static const uint8_t distanceExtra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+            int code = 28;
+            while (lengthBase[code] > length) code--;
+
+            WriteSymbol(257 + static_cast<uint32_t>(code));
+            WriteBits(static_cast<uint32_t>(length - lengthBase[code]), lengthExtra[code]);
+
+            code = 29;
+            while (distanceBase[code] > distance) code--;
+
+            WriteCode(static_cast<uint32_t>(code), 5);
+            WriteBits(static_cast<uint32_t>(distance - distanceBase[code]), distanceExtra[code]);
+        }
+    };
+} // namespace
+
+AssetPack::AssetPack() = default;
+
+AssetPack::~AssetPack() = default;
+
+std::string AssetPack::PathFor(
+    const std::string &baseDirectory)
+{
+    // Next to the assets directory, so building a pack never packs the previous one
+    auto path = std::filesystem::path(baseDirectory);
+    if (!path.has_filename())
+    {
+        path = path.parent_path();
+    }
+
+    return path.string() + ".gspak";
+}
+
+std::string AssetPack::NormalizeName(
+    const std::string &name)
+{
+    auto normalized = std::filesystem::path(name).lexically_normal().generic_string();
+
+    while (normalized.compare(0, 2, "./") == 0)
+    {
+        normalized.erase(0, 2);
+    }
+
+    return normalized;
+}
+
+bool AssetPack::Build(
+    const std::string &packPath,
+    const std::string &baseDirectory,
+    const std::vector<std::string> &names,
+    const std::vector<std::string> &compressibleNames)
+{
+    std::vector<std::string> sortedNames;
+    for (auto &name : names)
+    {
+        sortedNames.push_back(NormalizeName(name));
+    }
+
+    std::vector<std::string> compressible;
+    for (auto &name : compressibleNames)
+    {
+        compressible.push_back(NormalizeName(name));
+        sortedNames.push_back(compressible.back());
+    }
+    std::sort(compressible.begin(), compressible.end());
+
+    std::sort(sortedNames.begin(), sortedNames.end());
+    sortedNames.erase(std::unique(sortedNames.begin(), sortedNames.end()), sortedNames.end());
+
+    uint32_t slotCount = 1;
+    while (slotCount < sortedNames.size() * 2) slotCount *= 2;
+
+    AssetPackHeader header = {};
+    std::memcpy(header.magic, AssetPackMagic, sizeof(header.magic));
+    header.version = AssetPackVersion;
+    header.entryCount = static_cast<uint32_t>(sortedNames.size());
+    header.slotCount = slotCount;
+    header.slotsOffset = sizeof(AssetPackHeader);
+    header.namesOffset = header.slotsOffset + sizeof(AssetPackEntry) * uint64_t(slotCount);
+
+    std::string strings;
+    for (auto &name : sortedNames)
+    {
+        strings += name;
+    }
+    header.namesSize = strings.size();
+
+    std::vector<AssetPackEntry> slots(slotCount, AssetPackEntry{});
+
+    auto tempPath = packPath + ".tmp";
+
+    {
+        std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+        if (!stream)
+        {
+            spdlog::error("unable to write asset pack {}", packPath);
+
+            return false;
+        }
+
+        // The tables are written again at the end, once the entry offsets are known
+        uint64_t offset = header.namesOffset + header.namesSize;
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        stream.write(reinterpret_cast<const char *>(slots.data()), static_cast<std::streamsize>(sizeof(AssetPackEntry) * slots.size()));
+        stream.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+        uint64_t totalSize = 0, totalStoredSize = 0;
+        uint32_t nameOffset = 0;
+
+        for (auto &name : sortedNames)
+        {
+            auto path = (std::filesystem::path(baseDirectory) / std::filesystem::path(name)).string();
+
+            AssetPackEntry entry = {};
+            entry.hash = HashName(name);
+            entry.nameOffset = nameOffset;
+            entry.nameSize = static_cast<uint32_t>(name.size());
+            nameOffset += entry.nameSize;
+
+            std::error_code ec;
+            auto fileSize = std::filesystem::file_size(path, ec);
+            if (ec)
+            {
+                spdlog::error("unable to pack {}: {}", path, ec.message());
+
+                std::filesystem::remove(tempPath, ec);
+
+                return false;
+            }
+
+            MappedFile file;
+            if (fileSize > 0 && !file.Open(path))
+            {
+                spdlog::error("unable to pack {}", path);
+
+                std::filesystem::remove(tempPath, ec);
+
+                return false;
+            }
+
+            static const char zeros[AssetPackAlignment] = {};
+            auto aligned = AlignUp(offset, AssetPackAlignment);
+            stream.write(zeros, static_cast<std::streamsize>(aligned - offset));
+            offset = aligned;
+
+            entry.offset = offset;
+            entry.size = fileSize;
+            entry.storedSize = fileSize;
+
+            const unsigned char *data = file.Data();
+
+            Deflater deflater;
+            bool compress = std::binary_search(compressible.begin(), compressible.end(), name);
+            if (compress && fileSize > 0 && fileSize < INT_MAX)
+            {
+                deflater.Compress(file.Data(), file.Size());
+
+                if (deflater.out.size() <= fileSize - fileSize / 8)
+                {
+                    entry.flags |= AssetPackCompressed;
+                    entry.storedSize = deflater.out.size();
+                    data = deflater.out.data();
+                }
+            }
+
+            stream.write(reinterpret_cast<const char *>(data), static_cast<std::streamsize>(entry.storedSize));
+            offset += entry.storedSize;
+
+            totalSize += entry.size;
+            totalStoredSize += entry.storedSize;
+
+            auto slot = entry.hash & (slotCount - 1);
+            while (slots[slot].nameSize != 0) slot = (slot + 1) & (slotCount - 1);
+            slots[slot] = entry;
+        }
+
+        stream.seekp(static_cast<std::streamoff>(header.slotsOffset));
+        stream.write(reinterpret_cast<const char *>(slots.data()), static_cast<std::streamsize>(sizeof(AssetPackEntry) * slots.size()));
+
+        if (!stream)
+        {
+            spdlog::error("unable to write asset pack {}", packPath);
+
+            return false;
+        }
+
+        spdlog::info("packed {} files, {} bytes stored as {}", sortedNames.size(), totalSize, totalStoredSize);
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, packPath, ec);
+    if (ec)
+    {
+        spdlog::error("unable to write asset pack {}: {}", packPath, ec.message());
+
+        std::filesystem::remove(tempPath, ec);
+
+        return false;
+    }
+
+    spdlog::info("written asset pack {}", packPath);
+
+    return true;
+}
+
+bool AssetPack::Open(
+    const std::string &packPath)
+{
+    _header = nullptr;
+    _slots = nullptr;
+    _names = nullptr;
+
+    if (!_file.Open(packPath))
+    {
+        return false;
+    }
+
+    auto size = static_cast<uint64_t>(_file.Size());
+    auto header = reinterpret_cast<const AssetPackHeader *>(_file.Data());
+
+    if (size < sizeof(AssetPackHeader) ||
+        std::memcmp(header->magic, AssetPackMagic, sizeof(header->magic)) != 0 ||
+        header->version != AssetPackVersion ||
+        header->slotCount == 0 ||
+        (header->slotCount & (header->slotCount - 1)) != 0 ||
+        header->entryCount >= header->slotCount ||
+        header->slotsOffset != sizeof(AssetPackHeader) ||
+        header->namesOffset != header->slotsOffset + sizeof(AssetPackEntry) * uint64_t(header->slotCount) ||
+        header->namesOffset + header->namesSize > size)
+    {
+        spdlog::error("{} is not a valid asset pack", packPath);
+
+        _file.Close();
+
+        return false;
+    }
+
+    _header = header;
+    _slots = reinterpret_cast<const AssetPackEntry *>(_file.Data() + header->slotsOffset);
+    _names = reinterpret_cast<const char *>(_file.Data() + header->namesOffset);
+
+    return true;
+}
+
+bool AssetPack::IsOpen() const
+{
+    return _header != nullptr;
+}
+
+const AssetPackEntry *AssetPack::Find(
+    const std::string &name) const
+{
+    if (_header == nullptr)
+    {
+        return nullptr;
+    }
+
+    auto normalized = NormalizeName(name);
+    auto hash = HashName(normalized);
+    auto mask = _header->slotCount - 1;
+
+    for (auto slot = hash & mask; _slots[slot].nameSize != 0; slot = (slot + 1) & mask)
+    {
+        auto &entry = _slots[slot];
+        if (entry.hash != hash || entry.nameSize != normalized.size())
+        {
+            continue;
+        }
+
+        if (uint64_t(entry.nameOffset) + entry.nameSize > _header->namesSize ||
+            std::memcmp(_names + entry.nameOffset, normalized.data(), normalized.size()) != 0)
+        {
+            continue;
+        }
+
+        if (entry.offset + entry.storedSize > _file.Size())
+        {
+            spdlog::error("asset pack entry {} is out of bounds", normalized);
+
+            return nullptr;
+        }
+
+        return &entry;
+    }
+
+    return nullptr;
+}
+
+bool AssetPack::Read(
+    const AssetPackEntry &entry,
+    const unsigned char *&data,
+    size_t &size,
+    std::vector<unsigned char> &storage) const
+{
+    if ((entry.flags & AssetPackCompressed) == 0)
+    {
+        data = _file.Data() + entry.offset;
+        size = entry.size;
+
+        return true;
+    }
+
+    if (entry.size >= INT_MAX || entry.storedSize >= INT_MAX)
+    {
+        return false;
+    }
+
+    storage.resize(entry.size);
+
+    auto inflated = stbi_zlib_decode_buffer(
+        reinterpret_cast<char *>(storage.data()),
+        static_cast<int>(storage.size()),
+        reinterpret_cast<const char *>(_file.Data() + entry.offset),
+        static_cast<int>(entry.storedSize));
+
+    if (inflated != static_cast<int>(entry.size))
+    {
+        spdlog::error("unable to inflate asset pack entry {}", std::string(_names + entry.nameOffset, entry.nameSize));
+
+        return false;
+    }
+
+    data = storage.data();
+    size = storage.size();
+
+    return true;
+}
@@ -1,6 +1,20 @@
 #include <core/assetsmanager.h>
 
+#include <core/meshcache.h>
+#include <core/meshdata.h>
+#include <core/objconverter.h>
+#include <core/objparser.h>
+#include <core/smoothingnormals.h>
+#include <core/texturecooker.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstring>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <glm/glm.hpp>
 #include <spdlog/spdlog.h>
 #include <stb_image.h>
@@ -8,765 +22,2218 @@
 
 using namespace gamestart;
 
+// Vertex and index data is uploaded through a ring of this size, a few stream chunks fit in it
+const size_t StagingRingSize = size_t(32) * 1024 * 1024;
+
+static std::string DefaultBaseDirectory()
+{
+    return (std::filesystem::current_path() / std::filesystem::path("assets")).string();
+}
+
+static ShaderSources MeshShaderSources()
+{
+    ShaderSources sources;
+
+    sources.vertex =
+        "#version 150\n"
+
+        "in vec3 vertex;\n"
+        "in vec3 normal;\n"
+        "in vec3 color;\n"
+        "in vec2 texcoords;\n"
+
+        "uniform mat4 u_projection;\n"
+        "uniform mat4 u_model;\n"
+        "uniform vec3 u_positionOffset;\n"
+        "uniform vec3 u_positionScale;\n"
+
+        "out vec3 f_color;\n"
+        "out vec2 f_uvs;\n"
+
+        "void main()\n"
+        "{\n"
+        "    gl_Position = u_projection * u_model * vec4(u_positionOffset + vertex.xyz * u_positionScale, 1.0);\n"
+        "    f_color = color;\n"
+        "    f_uvs = texcoords;\n"
+        "}\n";
+
+    sources.fragment =
+        "#version 150\n"
+
+        "#ifdef TEXTURED\n"
+        "uniform sampler2D u_texture;\n"
+        "#endif\n"
+
+        "in vec3 f_color;\n"
+        "in vec2 f_uvs;\n"
+        "out vec4 color;\n"
+
+        "void main()\n"
+        "{\n"
+        "#ifdef TEXTURED\n"
+        "    vec4 texel = texture(u_texture, f_uvs);\n"
+        "#ifdef ALPHA_TESTED\n"
+        "    if (texel.a < 0.5) discard;\n"
+        "#endif\n"
+        "    color = vec4(f_color.xyz * texel.rgb, 1.0);\n"
+        "#else\n"
+        "    color = vec4(f_color.xyz, 1.0);\n"
+        "#endif\n"
+        "}\n";
+
+    sources.attributes = {"vertex", "normal", "color", "texcoords"};
+
+    // Same order as MeshShaderFeature
+    sources.features = {"TEXTURED", "ALPHA_TESTED"};
+
+    return sources;
+}
+
 AssetsManager::AssetsManager()
+    : _meshShaders(_programCache, MeshShaderSources()),
+      _stagingRing(StagingRingSize)
 {
-    _baseDirectory = (std::filesystem::current_path() / std::filesystem::path("assets")).string();
+    _baseDirectory = DefaultBaseDirectory();
 
     spdlog::debug("setting base directory to {}", _baseDirectory);
+
+    _programCache.SetDirectory((std::filesystem::current_path() / std::filesystem::path("shadercache")).string());
+
+    // Without a pack, during development, everything is loaded from loose files
+    auto packPath = AssetPack::PathFor(_baseDirectory);
+    if (_pack.Open(packPath))
+    {
+        spdlog::info("loading assets from {}", packPath);
+    }
 }
 
 AssetsManager::~AssetsManager() = default;
 
+bool AssetsManager::BuildAssetPack()
+{
+    auto baseDirectory = DefaultBaseDirectory();
+
+    std::vector<std::string> names;
+    std::vector<std::string> sourceNames;
+
+    std::error_code ec;
+    for (auto it = std::filesystem::recursive_directory_iterator(baseDirectory, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+    {
+        if (!it->is_regular_file())
+        {
+            continue;
+        }
+
+        auto path = it->path();
+        auto extension = path.extension().string();
+
+        // Mesh caches and cooked textures are only packed along with their source, when current
+        if (extension == ".gsmesh" || extension == ".ktx" || extension == ".tmp")
+        {
+            continue;
+        }
+
+        auto name = path.lexically_relative(baseDirectory).generic_string();
+        sourceNames.push_back(name);
+
+        if (MeshCache::IsCurrent(MeshCache::PathFor(path.string()), path.string()))
+        {
+            names.push_back(MeshCache::PathFor(name));
+        }
+
+        CookedTexture cooked;
+        if (cooked.Open(CookedTexture::PathFor(path.string()), path.string()))
+        {
+            names.push_back(CookedTexture::PathFor(name));
+        }
+    }
+
+    if (ec)
+    {
+        spdlog::error("unable to read {}: {}", baseDirectory, ec.message());
+
+        return false;
+    }
+
+    return AssetPack::Build(AssetPack::PathFor(baseDirectory), baseDirectory, names, sourceNames);
+}
+
 typedef struct
 {
     GLuint va_id;
     GLuint vb_id;
+    GLuint ib_id;
     int numTriangles;
+    int numIndices;
+    GLenum index_type;
     int material_id;
+    size_t num_bytes;
+    MeshBounds bounds;
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshLod> lods;
 } DrawObject;
 
-static bool LoadObjAndConvert(
-    float bmin[3],
-    float bmax[3],
-    std::vector<DrawObject> *drawObjects,
-    std::vector<tinyobj::material_t> &materials,
-    std::map<std::string, GLuint> &textures,
-    const char *filename,
-    const char *base_dir);
+typedef struct
+{
+    std::shared_ptr<LoadedTexture> texture;
+    int w, h, comp;
+    unsigned char *image;
 
-GLuint AssetsManager::CompileShader(
-    const std::string &vertShaderStr,
-    const std::string &fragShaderStr)
+    // Set instead of image when the texture is uploaded from its cooked mip chain
+    std::shared_ptr<CookedTexture> cooked;
+} DecodedTexture;
+
+// The indices of the levels of detail follow the indexCount indices of the shape itself
+typedef struct
 {
-    const char *vertShaderSrc = vertShaderStr.c_str();
+    const void *vertices;
+    size_t vertexCount;
+    const void *indices;
+    size_t indexCount;
+    size_t lodIndexCount;
+    int materialId;
+    MeshBounds bounds;
+    std::vector<Meshlet> meshlets;
+    std::vector<MeshLod> lods;
+} PendingShape;
+
+// Textures with more levels than this keep only the levels up to this size resident until asked for
+const int TextureTailSize = 64;
+
+// Frames a texture stays at its requested resolution after the last request
+const uint64_t TextureRequestFrames = 120;
+
+// Triangles read back, converted and uploaded at a time when an OBJ is streamed, 8 MiB of Float vertices
+const size_t StreamChunkFaces = 64 * 1024;
+
+// Scratch memory grown larger than this by an unusually large import is freed instead of kept
+const size_t MaxKeptScratchBytes = size_t(256) * 1024 * 1024;
+
+namespace gamestart
+{
+    class StreamRead
+    {
+    public:
+        int level = -1;
+        std::vector<unsigned char> data;
+        std::atomic<bool> ready{false};
+    };
 
-    GLint result = GL_FALSE;
-    GLint logLength;
+    // Mip streaming state of a cooked texture, the cooked file stays mapped while it streams
+    class TextureStream
+    {
+    public:
+        std::shared_ptr<CookedTexture> cooked;
+        int tailLevel = 0;
+        int requestedLevel = 0;
+        uint64_t requestFrame = 0;
+
+        // The level the background reader is working on
+        std::shared_ptr<StreamRead> read;
+    };
 
-    // Compile vertex shader
-    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertShader, 1, &vertShaderSrc, NULL);
-    glCompileShader(vertShader);
+    class StreamChunk
+    {
+    public:
+        size_t shape = 0;
+        size_t firstTriangle = 0;
+        size_t triangleCount = 0;
+        bool isLast = false;
+        int materialId = -1;
+        glm::vec3 bbMin, bbMax;
+        std::vector<unsigned char> vertices;
+        std::vector<unsigned char> indices;
+        std::atomic<bool> ready{false};
+
+        // Time spent converting, added to the stats of the asset once the chunk is uploaded
+        ImportStats stats;
+    };
 
-    // Check vertex shader
-    glGetShaderiv(vertShader, GL_COMPILE_STATUS, &result);
-    if (result == GL_FALSE)
+    // An OBJ too large to convert in one go. Only the vertex attributes are parsed up front,
+    // the faces are read back from the file a chunk at a time on the thread pool, turned into
+    // vertices and written into buffers that are allocated up front. Neither the faces nor
+    // the converted mesh are ever in memory as a whole. The vertices are not welded and the
+    // triangle order is not optimized, both need the whole shape.
+    class StreamedObj
     {
-        glGetShaderiv(vertShader, GL_INFO_LOG_LENGTH, &logLength);
+    public:
+        ObjStream obj;
+        glm::vec3 bbMin, bbMax;
+
+        // Holds the file when it came compressed from the pack
+        std::vector<unsigned char> storage;
+
+        // Upload state of the current shape, the chunk is the one being converted
+        size_t shape = 0;
+        DrawObject drawObject;
+        std::shared_ptr<StreamChunk> chunk;
+
+        // The faces of the chunk being converted. The smoothing normals are summed up by the
+        // first chunk of a shape, read by the ones after it and cleared for the next shape.
+        tinyobj::shape_t part;
+        ImportScratch scratch;
+        bool hasSmoothVertexNormals = false;
+        int smoothVertexBegin = 0;
+        int smoothVertexEnd = 0;
+    };
 
-        std::vector<GLchar> vertShaderError(static_cast<size_t>((logLength > 1) ? logLength : 1));
+    // Everything an import produces on the thread pool, waiting to be uploaded on the GL thread
+    class PendingAsset
+    {
+    public:
+        ~PendingAsset()
+        {
+            for (auto &texture : textures)
+            {
+                stbi_image_free(texture.image);
+            }
+        }
 
-        glGetShaderInfoLog(vertShader, logLength, NULL, &vertShaderError[0]);
+        std::string assetName;
+        std::shared_ptr<LoadedAsset> asset;
+        VertexLayout vertexLayout = VertexLayout::Float;
+        std::promise<void> importDone;
+        bool result = false;
+        ImportStats stats;
+
+        // One of these two owns the vertices PendingShape points into
+        MeshCache meshCache;
+        MeshData meshData;
+
+        // Holds the mesh cache when it came compressed from the pack
+        std::vector<unsigned char> meshCacheStorage;
+
+        // Set instead of shapes for OBJ files over the streaming import threshold
+        std::shared_ptr<StreamedObj> stream;
+
+        // Set when the GL thread waits for the upload, chunks are converted right away then
+        bool isBlocking = false;
+
+        std::vector<PendingShape> shapes;
+        std::vector<std::vector<unsigned char>> packedVertices;
+        std::vector<std::vector<uint16_t>> packedIndices;
+        std::vector<std::vector<uint32_t>> joinedIndices;
+        std::vector<DecodedTexture> textures;
+        std::vector<LoadedMaterial> materials;
+        glm::vec3 bbMin, bbMax;
+
+        size_t nextTexture = 0;
+        size_t nextShape = 0;
+        std::vector<DrawObject> drawObjects;
+    };
+} // namespace gamestart
 
-        spdlog::error("error compiling vertex shader {}", vertShaderError.data());
+static bool LoadObjAndConvert(
+    MeshData &meshData,
+    ThreadPool &threadPool,
+    const AssetPack &pack,
+    const char *filename,
+    const char *base_dir,
+    bool buildMeshlets,
+    int lodLevelCount,
+    ImportScratch &scratch,
+    ImportStats &stats);
+
+static size_t ObjSize(
+    const AssetPack &pack,
+    const std::string &filename,
+    const std::string &fullPath);
+
+static bool LoadObjForStreaming(
+    StreamedObj &stream,
+    ThreadPool &threadPool,
+    const AssetPack &pack,
+    const char *filename,
+    const char *base_dir,
+    ImportStats &stats);
+
+static void ConvertChunk(
+    StreamedObj &stream,
+    StreamChunk &chunk,
+    VertexLayout vertexLayout);
+
+static bool ResolveTexturePath(
+    const std::string &texname,
+    const AssetPack &pack,
+    const char *base_dir,
+    std::string &canonicalPath);
+
+static bool DecodeTexture(
+    DecodedTexture &texture,
+    const AssetPack &pack);
+
+static GLuint UploadTexture(
+    DecodedTexture &texture);
+
+static GLuint CreateCompressedTexture(
+    const CookedTexture &cooked,
+    int firstLevel);
+
+static int TailLevel(
+    const CookedTexture &cooked);
+
+static size_t CompressedBytes(
+    const CookedTexture &cooked,
+    int firstLevel);
+
+static DrawObject UploadDrawObject(
+    StagingRing &stagingRing,
+    const void *vertices,
+    size_t vertexCount,
+    const void *indices,
+    size_t indexCount,
+    size_t lodIndexCount,
+    VertexLayout vertexLayout,
+    int materialId);
 
-        return 0;
-    }
+GLuint AssetsManager::GetMeshWithoutAnimationShader()
+{
+    auto program = _meshShaders.Get(0);
 
-    const char *fragShaderSrc = fragShaderStr.c_str();
+    return program != nullptr ? program->Id() : 0;
+}
+
+const ShaderProgram *AssetsManager::GetMeshShader(
+    uint32_t features)
+{
+    return _meshShaders.Get(features);
+}
 
-    // Compile fragment shader
-    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragShader, 1, &fragShaderSrc, NULL);
-    glCompileShader(fragShader);
+std::shared_ptr<LoadedAsset> AssetsManager::LoadAsset(
+    const std::string &assetName,
+    VertexLayout vertexLayout)
+{
+    std::shared_ptr<LoadedAsset> asset;
 
-    // Check fragment shader
-    glGetShaderiv(fragShader, GL_COMPILE_STATUS, &result);
-    if (result == GL_FALSE)
+    const auto &loadedAsset = _loadedAssets.find(assetName);
+    if (loadedAsset != _loadedAssets.end())
     {
-        glGetShaderiv(fragShader, GL_INFO_LOG_LENGTH, &logLength);
+        asset = loadedAsset->second;
+        asset->references++;
+        asset->lastUsedFrame = _frame;
 
-        std::vector<GLchar> fragShaderError(static_cast<size_t>((logLength > 1) ? logLength : 1));
+        // Still in flight from LoadAssetAsync, the caller expects it to be usable right away
+        auto pendingAsset = _pendingAssets.find(assetName);
+        if (pendingAsset != _pendingAssets.end())
+        {
+            FinishPendingAsset(pendingAsset->second);
 
-        glGetShaderInfoLog(fragShader, logLength, NULL, &fragShaderError[0]);
+            return asset;
+        }
 
-        spdlog::error("error compiling fragment shader {}", fragShaderError.data());
+        if (!asset->isFailed)
+        {
+            return asset;
+        }
 
-        return 0;
+        // The last import failed, try again for everyone holding the asset
+        asset->isFailed = false;
     }
-
-    auto shaderId = glCreateProgram();
-    glAttachShader(shaderId, vertShader);
-    glAttachShader(shaderId, fragShader);
-    glLinkProgram(shaderId);
-
-    glGetProgramiv(shaderId, GL_LINK_STATUS, &result);
-    if (result == GL_FALSE)
+    else
     {
-        glGetProgramiv(shaderId, GL_INFO_LOG_LENGTH, &logLength);
-
-        std::vector<GLchar> programError(static_cast<size_t>((logLength > 1) ? logLength : 1));
+        asset = std::make_shared<LoadedAsset>();
+        asset->references = 1;
+        asset->lastUsedFrame = _frame;
 
-        glGetProgramInfoLog(shaderId, logLength, NULL, &programError[0]);
+        _loadedAssets.insert(std::make_pair(assetName, asset));
+    }
 
-        spdlog::error("error linking shader {}", programError.data());
+    PendingAsset pending;
+    pending.assetName = assetName;
+    pending.asset = asset;
+    pending.vertexLayout = SupportedVertexLayout(vertexLayout);
 
-        return 0;
-    }
+    pending.isBlocking = true;
 
-    glDeleteShader(vertShader);
-    glDeleteShader(fragShader);
+    ImportAsset(pending);
 
-    //    _projectionUniformId = glGetUniformLocation(_shaderId, _projectionUniformName.c_str());
-    //    _viewUniformId = glGetUniformLocation(_shaderId, _viewUniformName.c_str());
-    //    _modelUniformId = glGetUniformLocation(_shaderId, _modelUniformName.c_str());
+    while (!UploadStep(pending))
+    {
+    }
 
-    //    _textureUniform1Id = glGetUniformLocation(_shaderId, _textureUniform1Name.c_str());
-    //    _textureUniform2Id = glGetUniformLocation(_shaderId, _textureUniform2Name.c_str());
-    //    _textureUniform3Id = glGetUniformLocation(_shaderId, _textureUniform3Name.c_str());
-    //    _textureUniformMaskId = glGetUniformLocation(_shaderId, _textureUniformMaskName.c_str());
+    FinishAsset(pending);
 
-    return shaderId;
+    return asset;
 }
 
-GLuint AssetsManager::GetMeshWithoutAnimationShader()
+std::shared_ptr<LoadedAsset> AssetsManager::LoadAssetAsync(
+    const std::string &assetName,
+    VertexLayout vertexLayout)
 {
-    if (_meshWithoutAnimationShaderId == 0)
+    std::shared_ptr<LoadedAsset> asset;
+
+    const auto &loadedAsset = _loadedAssets.find(assetName);
+    if (loadedAsset != _loadedAssets.end())
     {
-        std::string const vshader(
-            "#version 150\n"
+        asset = loadedAsset->second;
+        asset->references++;
+        asset->lastUsedFrame = _frame;
 
-            "in vec3 vertex;\n"
-            "in vec3 normal;\n"
-            "in vec3 color;\n"
-            "in vec2 texcoords;\n"
+        if (!asset->isFailed)
+        {
+            return asset;
+        }
 
-            "uniform mat4 u_projection;\n"
-            "uniform mat4 u_model;\n"
+        // The last import failed, try again for everyone holding the asset
+        asset->isFailed = false;
+    }
+    else
+    {
+        asset = std::make_shared<LoadedAsset>();
+        asset->references = 1;
+        asset->lastUsedFrame = _frame;
 
-            "out vec3 f_color;\n"
-            "out vec2 f_uvs;\n"
+        _loadedAssets.insert(std::make_pair(assetName, asset));
+    }
 
-            "void main()\n"
-            "{\n"
-            "    gl_Position = u_projection * u_model * vec4(vertex.xyz, 1.0);\n"
-            "    f_color = color;\n"
-            "    f_uvs = texcoords;\n"
-            "}\n");
+    auto pending = std::make_shared<PendingAsset>();
+    pending->assetName = assetName;
+    pending->asset = asset;
+    pending->vertexLayout = SupportedVertexLayout(vertexLayout);
 
-        std::string const fshader(
-            "#version 150\n"
+    _pendingAssets.insert(std::make_pair(assetName, pending));
 
-            //"uniform sampler2D u_texture;\n"
+    _threadPool.Enqueue([this, pending]() {
+        ImportAsset(*pending);
 
-            "in vec3 f_color;\n"
-            "in vec2 f_uvs;\n"
-            "out vec4 color;\n"
+        {
+            std::unique_lock<std::mutex> lock(_uploadQueueMutex);
 
-            "void main()\n"
-            "{\n"
-            "    color = vec4(f_color.xyz, 1.0);\n"
-            //"   color = texture(u_texture, f_uvs.uv);\n"
-            "}\n");
+            _uploadQueue.push_back(pending);
+        }
 
-        _meshWithoutAnimationShaderId = CompileShader(vshader, fshader);
-    }
+        pending->importDone.set_value();
+    });
 
-    return _meshWithoutAnimationShaderId;
+    return asset;
 }
 
-std::shared_ptr<LoadedAsset> AssetsManager::LoadAsset(
-    const std::string &assetName)
+std::vector<std::shared_ptr<LoadedAsset>> AssetsManager::LoadAssetsAsync(
+    const std::vector<std::string> &assetNames,
+    const std::vector<int> &references,
+    VertexLayout vertexLayout)
 {
-    const auto &loadedAsset = _loadedAssets.find(assetName);
-    if (loadedAsset != _loadedAssets.end())
+    std::vector<std::shared_ptr<LoadedAsset>> assets;
+    assets.reserve(assetNames.size());
+
+    for (size_t i = 0; i < assetNames.size(); i++)
     {
-        return loadedAsset->second;
+        assets.push_back(LoadAssetAsync(assetNames[i], vertexLayout));
+
+        // LoadAssetAsync took one of them
+        assets.back()->references += references[i] - 1;
     }
 
-    auto asset = std::make_shared<LoadedAsset>();
+    return assets;
+}
 
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::material_t> materials;
-    std::map<std::string, GLuint> textures;
-    float bmin[3], bmax[3];
+void AssetsManager::ProcessUploads()
+{
+    auto start = std::chrono::steady_clock::now();
+    auto budget = std::chrono::duration<float, std::milli>(_uploadBudget);
 
-    std::vector<DrawObject> drawObjects;
+    _frame++;
 
-    auto result = LoadObjAndConvert(
-        bmin,
-        bmax,
-        &drawObjects,
-        materials,
-        textures,
-        assetName.c_str(),
-        _baseDirectory.c_str());
+    // The copies of the last frame are done once this fence signals
+    _stagingRing.Fence();
 
-    if (result)
-    {
-        asset.get()->bbMax = glm::vec3(bmax[0], bmax[1], bmax[2]);
-        asset.get()->bbMin = glm::vec3(bmin[0], bmin[1], bmin[2]);
+    EvictAssets();
 
-        asset.get()->shaderId = GetMeshWithoutAnimationShader();
+    _meshShaders.Update();
+
+    // At least one step is taken every frame, so a tiny budget still makes progress. New assets
+    // go first, mip levels of textures already in use stream in with the time that is left.
+    do
+    {
+        std::shared_ptr<PendingAsset> pending;
 
-        if (asset.get()->shaderId > 0)
         {
-            for (auto obj : drawObjects)
+            std::unique_lock<std::mutex> lock(_uploadQueueMutex);
+
+            if (!_uploadQueue.empty())
             {
-                LoadedMesh mesh;
-                mesh.materialId = obj.material_id;
-                mesh.triangleCount = obj.numTriangles;
-                mesh.vbo = obj.vb_id;
+                pending = _uploadQueue.front();
+            }
+        }
 
-                asset.get()->loadedMeshes.push_back(mesh);
+        if (pending == nullptr)
+        {
+            if (!StreamTextures())
+            {
+                return;
             }
+
+            continue;
         }
-        else
+
+        if (UploadStep(*pending))
         {
-            spdlog::error("failed to 'mesh-without-animation' shader for {}", assetName);
+            {
+                std::unique_lock<std::mutex> lock(_uploadQueueMutex);
+
+                _uploadQueue.pop_front();
+            }
+
+            FinishAsset(*pending);
         }
-    }
-    else
-    {
-        spdlog::error("failed to load {}", assetName);
-    }
+    } while (std::chrono::steady_clock::now() - start < budget);
+}
 
-    _loadedAssets.insert(std::make_pair(assetName, asset));
+void AssetsManager::SetUploadBudget(
+    float milliseconds)
+{
+    _uploadBudget = milliseconds;
+}
 
-    return _loadedAssets
-        .find(assetName)
-        ->second;
+void AssetsManager::SetStreamingImportThreshold(
+    size_t bytes)
+{
+    _streamingImportThreshold = bytes;
 }
 
-void AssetsManager::UnloadAsset(
-    std::shared_ptr<LoadedAsset> asset)
+void AssetsManager::SetBuildMeshlets(
+    bool buildMeshlets)
 {
-    (void)asset;
+    _buildMeshlets = buildMeshlets;
 }
 
-namespace // Local utility functions
+void AssetsManager::SetLodLevelCount(
+    int lodLevelCount)
 {
-    static bool FileExists(
-        const std::string &abs_filename)
-    {
-        if (!std::filesystem::exists(std::filesystem::path(abs_filename)))
-        {
-            spdlog::error("{} does not exist", abs_filename);
+    _lodLevelCount = lodLevelCount;
+}
 
-            return false;
-        }
+void AssetsManager::SetGpuMemoryBudget(
+    size_t bytes)
+{
+    _gpuMemoryBudget = bytes;
+}
 
-        return true;
-    }
+GpuMemoryStats AssetsManager::GetGpuMemoryStats()
+{
+    GpuMemoryStats stats;
 
-    struct vec3
-    {
-        float v[3];
-        vec3()
-        {
-            v[0] = 0.0f;
-            v[1] = 0.0f;
-            v[2] = 0.0f;
-        }
-    };
+    // A texture is only freed by evicting when all its material records belong to evictable assets
+    std::map<const LoadedTexture *, int> evictableReferences;
 
-    void normalizeVector(vec3 &v)
+    for (auto &entry : _loadedAssets)
     {
-        float len2 = v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2];
-        if (len2 > 0.0f)
+        auto &asset = *entry.second;
+        if (!asset.isResident)
         {
-            float len = sqrtf(len2);
-
-            v.v[0] /= len;
-            v.v[1] /= len;
-            v.v[2] /= len;
+            continue;
         }
-    }
 
-    // Check if `mesh_t` contains smoothing group id.
-    bool hasSmoothingGroup(const tinyobj::shape_t &shape)
-    {
-        for (size_t i = 0; i < shape.mesh.smoothing_group_ids.size(); i++)
+        stats.residentBytes += asset.gpuBytes;
+
+        if (asset.references <= 0)
         {
-            if (shape.mesh.smoothing_group_ids[i] > 0)
+            stats.evictableBytes += asset.gpuBytes;
+
+            for (auto &material : asset.materials)
             {
-                return true;
+                if (material.diffuseTexture != nullptr)
+                {
+                    evictableReferences[material.diffuseTexture.get()]++;
+                }
             }
         }
-        return false;
     }
 
-    static void CalcNormal(float N[3], float v0[3], float v1[3], float v2[3])
-    {
-        float v10[3];
-        v10[0] = v1[0] - v0[0];
-        v10[1] = v1[1] - v0[1];
-        v10[2] = v1[2] - v0[2];
+    std::unique_lock<std::mutex> lock(_texturesMutex);
 
-        float v20[3];
-        v20[0] = v2[0] - v0[0];
-        v20[1] = v2[1] - v0[1];
-        v20[2] = v2[2] - v0[2];
+    for (auto &entry : _textures)
+    {
+        auto &texture = *entry.second.texture;
 
-        N[0] = v10[1] * v20[2] - v10[2] * v20[1];
-        N[1] = v10[2] * v20[0] - v10[0] * v20[2];
-        N[2] = v10[0] * v20[1] - v10[1] * v20[0];
+        stats.residentBytes += texture.gpuBytes;
 
-        float len2 = N[0] * N[0] + N[1] * N[1] + N[2] * N[2];
-        if (len2 > 0.0f)
+        auto evictable = evictableReferences.find(&texture);
+        if (evictable != evictableReferences.end() && evictable->second >= entry.second.references)
         {
-            float len = sqrtf(len2);
-
-            N[0] /= len;
-            N[1] /= len;
-            N[2] /= len;
+            stats.evictableBytes += texture.gpuBytes;
         }
     }
 
-    void computeSmoothingNormals(
-        const tinyobj::attrib_t &attrib,
-        const tinyobj::shape_t &shape,
-        std::map<int, vec3> &smoothVertexNormals)
+    return stats;
+}
+
+std::unique_ptr<ImportScratch> AssetsManager::AcquireScratch()
+{
+    std::unique_lock<std::mutex> lock(_scratchMutex);
+
+    if (_scratch.empty())
     {
-        smoothVertexNormals.clear();
-        std::map<int, vec3>::iterator iter;
+        return std::make_unique<ImportScratch>();
+    }
 
-        for (size_t f = 0; f < shape.mesh.indices.size() / 3; f++)
-        {
-            // Get the three indexes of the face (all faces are triangular)
-            tinyobj::index_t idx0 = shape.mesh.indices[3 * f + 0];
-            tinyobj::index_t idx1 = shape.mesh.indices[3 * f + 1];
-            tinyobj::index_t idx2 = shape.mesh.indices[3 * f + 2];
+    auto scratch = std::move(_scratch.back());
+    _scratch.pop_back();
 
-            // Get the three vertex indexes and coordinates
-            int vi[3];     // indexes
-            float v[3][3]; // coordinates
+    return scratch;
+}
 
-            for (int k = 0; k < 3; k++)
-            {
-                vi[0] = idx0.vertex_index;
-                vi[1] = idx1.vertex_index;
-                vi[2] = idx2.vertex_index;
-                assert(vi[0] >= 0);
-                assert(vi[1] >= 0);
-                assert(vi[2] >= 0);
-
-                v[0][k] = attrib.vertices[3 * vi[0] + k];
-                v[1][k] = attrib.vertices[3 * vi[1] + k];
-                v[2][k] = attrib.vertices[3 * vi[2] + k];
-            }
+void AssetsManager::ReleaseScratch(
+    std::unique_ptr<ImportScratch> scratch)
+{
+    if (scratch->Bytes() > MaxKeptScratchBytes)
+    {
+        return;
+    }
 
-            // Compute the normal of the face
-            float normal[3];
-            CalcNormal(normal, v[0], v[1], v[2]);
+    std::unique_lock<std::mutex> lock(_scratchMutex);
 
-            // Add the normal to the three vertexes
-            for (size_t i = 0; i < 3; ++i)
-            {
-                iter = smoothVertexNormals.find(vi[i]);
-                if (iter != smoothVertexNormals.end())
-                {
-                    // add
-                    iter->second.v[0] += normal[0];
-                    iter->second.v[1] += normal[1];
-                    iter->second.v[2] += normal[2];
-                }
-                else
-                {
-                    smoothVertexNormals[vi[i]].v[0] = normal[0];
-                    smoothVertexNormals[vi[i]].v[1] = normal[1];
-                    smoothVertexNormals[vi[i]].v[2] = normal[2];
-                }
-            }
+    _scratch.push_back(std::move(scratch));
+}
 
-        } // f
+ImportStats AssetsManager::GetImportStats() const
+{
+    return _importStats;
+}
 
-        // Normalize the normals, that is, make them unit vectors
-        for (iter = smoothVertexNormals.begin(); iter != smoothVertexNormals.end(); iter++)
+bool AssetsManager::WriteImportStats(
+    const std::string &path) const
+{
+    std::map<std::string, ImportStats> assets;
+    for (auto &entry : _loadedAssets)
+    {
+        if (entry.second->isResident)
         {
-            normalizeVector(iter->second);
+            assets[entry.first] = entry.second->importStats;
         }
-    } // computeSmoothingNormals
+    }
 
-} // namespace
+    return gamestart::WriteImportStats(path, _importStats, assets);
+}
 
-static bool LoadObjAndConvert(
-    float bmin[3],
-    float bmax[3],
-    std::vector<DrawObject> *drawObjects,
-    std::vector<tinyobj::material_t> &materials,
-    std::map<std::string, GLuint> &textures,
-    const char *filename,
-    const char *base_dir)
+void AssetsManager::EvictAssets()
 {
-    auto fullPath = std::filesystem::path(base_dir) / std::filesystem::path(filename);
-
-    if (!FileExists(fullPath.string()))
+    auto stats = GetGpuMemoryStats();
+    if (stats.residentBytes <= _gpuMemoryBudget || stats.evictableBytes == 0)
     {
-        return false;
+        return;
     }
 
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
+    std::vector<std::map<std::string, std::shared_ptr<LoadedAsset>>::iterator> candidates;
+    for (auto entry = _loadedAssets.begin(); entry != _loadedAssets.end(); ++entry)
+    {
+        if (entry->second->isResident && entry->second->references <= 0)
+        {
+            candidates.push_back(entry);
+        }
+    }
 
-    std::string warn;
-    std::string err;
-    bool ret = tinyobj::LoadObj(
-        &attrib,
-        &shapes,
-        &materials,
-        &warn,
-        &err,
-        fullPath.string().c_str(),
-        base_dir);
+    std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) {
+        return a->second->lastUsedFrame < b->second->lastUsedFrame;
+    });
 
-    if (!warn.empty())
+    for (auto &candidate : candidates)
     {
-        spdlog::warn(warn);
+        spdlog::info("evicting {}, {} bytes resident over a budget of {}", candidate->first, stats.residentBytes, _gpuMemoryBudget);
+
+        FreeAsset(*candidate->second);
+        _loadedAssets.erase(candidate);
+
+        stats = GetGpuMemoryStats();
+        if (stats.residentBytes <= _gpuMemoryBudget)
+        {
+            break;
+        }
     }
+}
 
-    if (!err.empty())
+void AssetsManager::FreeAsset(
+    LoadedAsset &asset)
+{
+    for (auto &mesh : asset.loadedMeshes)
     {
-        spdlog::error(err);
+        glDeleteVertexArrays(1, &mesh.vao);
+        glDeleteBuffers(1, &mesh.vbo);
+        glDeleteBuffers(1, &mesh.ibo);
     }
 
-    if (!ret)
+    for (auto &material : asset.materials)
     {
-        return false;
+        if (material.diffuseTexture != nullptr)
+        {
+            ReleaseTexture(material.diffuseTexture);
+        }
     }
 
-    spdlog::info("# of vertices  = {}", (int)(attrib.vertices.size()) / 3);
-    spdlog::info("# of normals   = {}", (int)(attrib.normals.size()) / 3);
-    spdlog::info("# of texcoords = {}", (int)(attrib.texcoords.size()) / 2);
-    spdlog::info("# of materials = {}", (int)materials.size());
-    spdlog::info("# of shapes    = {}", (int)shapes.size());
-
-    // Append `default` material
-    materials.push_back(tinyobj::material_t());
+    asset.loadedMeshes.clear();
+    asset.materials.clear();
+    asset.gpuBytes = 0;
+    asset.isResident = false;
+}
 
-    for (size_t i = 0; i < materials.size(); i++)
-    {
-        spdlog::info("material[{}].diffuse_texname = {}", int(i), materials[i].diffuse_texname.c_str());
-    }
+void AssetsManager::RequestTextureResolution(
+    const std::shared_ptr<LoadedAsset> &asset,
+    float screenSize)
+{
+    asset->lastUsedFrame = _frame;
 
-    // Load diffuse textures
+    // Called for every drawn asset every frame, the stream hangs off the texture so this needs
+    // neither the lock nor a lookup in the texture cache
+    for (auto &material : asset->materials)
     {
-        for (size_t m = 0; m < materials.size(); m++)
+        if (material.diffuseTexture == nullptr || material.diffuseTexture->stream == nullptr)
         {
-            tinyobj::material_t *mp = &materials[m];
+            continue;
+        }
 
-            if (mp->diffuse_texname.length() > 0)
-            {
-                // Only load the texture if it is not already loaded
-                if (textures.find(mp->diffuse_texname) == textures.end())
-                {
-                    GLuint texture_id;
-                    int w, h;
-                    int comp;
-
-                    std::string texture_filename = mp->diffuse_texname;
-                    if (!FileExists(texture_filename))
-                    {
-                        // Append base dir.
-                        texture_filename = base_dir + mp->diffuse_texname;
-                        if (!FileExists(texture_filename))
-                        {
-                            spdlog::error("Unable to find file: {}", mp->diffuse_texname);
-
-                            exit(1);
-                        }
-                    }
-
-                    unsigned char *image = stbi_load(texture_filename.c_str(), &w, &h, &comp, STBI_default);
-                    if (!image)
-                    {
-                        spdlog::error("Unable to load texture: {}", texture_filename);
-
-                        exit(1);
-                    }
-
-                    spdlog::info("Loaded texture: {}, w = {}, h = {}, comp = {}", texture_filename, w, h, comp);
-
-                    glGenTextures(1, &texture_id);
-                    glBindTexture(GL_TEXTURE_2D, texture_id);
-                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-                    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-                    if (comp == 3)
-                    {
-                        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-                    }
-                    else if (comp == 4)
-                    {
-                        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-                    }
-                    else
-                    {
-                        assert(0); // TODO
-                    }
-                    glBindTexture(GL_TEXTURE_2D, 0);
-                    stbi_image_free(image);
-                    textures.insert(std::make_pair(mp->diffuse_texname, texture_id));
-                }
-            }
+        auto &texture = *material.diffuseTexture;
+        auto &stream = *texture.stream;
+
+        // One texel per pixel, the level that is at most twice the screen size
+        auto texels = float(std::max(texture.width, texture.height));
+        auto level = screenSize > 0.0f ? static_cast<int>(std::floor(std::log2(texels / screenSize))) : stream.tailLevel;
+        level = std::clamp(level, 0, stream.tailLevel);
+
+        // Several assets can share the texture, the largest request wins
+        if (stream.requestFrame != _frame)
+        {
+            stream.requestedLevel = level;
+            stream.requestFrame = _frame;
+        }
+        else
+        {
+            stream.requestedLevel = std::min(stream.requestedLevel, level);
         }
     }
+}
 
-    bmin[0] = bmin[1] = bmin[2] = std::numeric_limits<float>::max();
-    bmax[0] = bmax[1] = bmax[2] = -std::numeric_limits<float>::max();
+bool AssetsManager::StreamTextures()
+{
+    std::unique_lock<std::mutex> lock(_texturesMutex);
 
+    for (auto &entry : _textures)
     {
-        for (size_t s = 0; s < shapes.size(); s++)
+        auto &texture = *entry.second.texture;
+        if (texture.stream == nullptr || texture.textureId == 0)
         {
-            DrawObject o;
-            std::vector<float> buffer; // pos(3float), normal(3float), color(3float)
+            continue;
+        }
 
-            // Check for smoothing group and compute smoothing normals
-            std::map<int, vec3> smoothVertexNormals;
-            if (hasSmoothingGroup(shapes[s]))
-            {
-                spdlog::info("Compute smoothingNormal for shape [{}]", s);
+        auto &stream = *texture.stream;
 
-                computeSmoothingNormals(attrib, shapes[s], smoothVertexNormals);
-            }
+        auto desiredLevel = _frame - stream.requestFrame <= TextureRequestFrames
+                                ? stream.requestedLevel
+                                : stream.tailLevel;
+
+        if (desiredLevel < texture.residentLevel)
+        {
+            auto level = texture.residentLevel - 1;
 
-            for (size_t f = 0; f < shapes[s].mesh.indices.size() / 3; f++)
+            // The mapped level is read on the thread pool first, so a page fault on a cold file
+            // never stalls the GL thread
+            if (stream.read == nullptr || stream.read->level != level)
             {
-                tinyobj::index_t idx0 = shapes[s].mesh.indices[3 * f + 0];
-                tinyobj::index_t idx1 = shapes[s].mesh.indices[3 * f + 1];
-                tinyobj::index_t idx2 = shapes[s].mesh.indices[3 * f + 2];
+                auto read = std::make_shared<StreamRead>();
+                read->level = level;
 
-                int current_material_id = shapes[s].mesh.material_ids[f];
+                stream.read = read;
 
-                if ((current_material_id < 0) || (current_material_id >= static_cast<int>(materials.size())))
-                {
-                    // Invaid material ID. Use default material.
-                    // Default material is added to the last item in `materials`.
-                    current_material_id = static_cast<int>(materials.size()) - 1;
-                }
+                _threadPool.Enqueue([read, cooked = stream.cooked]() {
+                    auto &source = cooked->Level(static_cast<size_t>(read->level));
 
-                // if (current_material_id >= materials.size()) {
-                //    std::cerr << "Invalid material index: " << current_material_id <<
-                //    std::endl;
-                //}
-                //
-                float diffuse[3];
-                for (size_t i = 0; i < 3; i++)
-                {
-                    diffuse[i] = materials[current_material_id].diffuse[i];
-                }
+                    read->data.assign(source.data, source.data + source.size);
+                    read->ready = true;
+                });
 
-                float tc[3][2];
+                continue;
+            }
 
-                if (attrib.texcoords.size() > 0)
-                {
-                    if ((idx0.texcoord_index < 0) || (idx1.texcoord_index < 0) || (idx2.texcoord_index < 0))
-                    {
-                        // face does not contain valid uv index.
-                        tc[0][0] = 0.0f;
-                        tc[0][1] = 0.0f;
-                        tc[1][0] = 0.0f;
-                        tc[1][1] = 0.0f;
-                        tc[2][0] = 0.0f;
-                        tc[2][1] = 0.0f;
-                    }
-                    else
-                    {
-                        assert(attrib.texcoords.size() > size_t(2 * idx0.texcoord_index + 1));
-                        assert(attrib.texcoords.size() > size_t(2 * idx1.texcoord_index + 1));
-                        assert(attrib.texcoords.size() > size_t(2 * idx2.texcoord_index + 1));
-
-                        // Flip Y coord.
-                        tc[0][0] = attrib.texcoords[2 * idx0.texcoord_index];
-                        tc[0][1] = 1.0f - attrib.texcoords[2 * idx0.texcoord_index + 1];
-                        tc[1][0] = attrib.texcoords[2 * idx1.texcoord_index];
-                        tc[1][1] = 1.0f - attrib.texcoords[2 * idx1.texcoord_index + 1];
-                        tc[2][0] = attrib.texcoords[2 * idx2.texcoord_index];
-                        tc[2][1] = 1.0f - attrib.texcoords[2 * idx2.texcoord_index + 1];
-                    }
-                }
-                else
+            if (!stream.read->ready)
+            {
+                continue;
+            }
+
+            auto &source = stream.cooked->Level(static_cast<size_t>(level));
+
+            glBindTexture(GL_TEXTURE_2D, texture.textureId);
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, stream.cooked->InternalFormat(), source.width, source.height, 0, static_cast<GLsizei>(source.size), stream.read->data.data());
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            texture.residentLevel = level;
+            texture.gpuBytes += source.size;
+            stream.read = nullptr;
+
+            return true;
+        }
+
+        if (desiredLevel > texture.residentLevel)
+        {
+            // Raising the base level does not free anything, the texture is created again
+            // with only the levels still wanted
+            auto textureId = CreateCompressedTexture(*stream.cooked, desiredLevel);
+
+            glDeleteTextures(1, &texture.textureId);
+
+            texture.textureId = textureId;
+            texture.residentLevel = desiredLevel;
+            texture.gpuBytes = CompressedBytes(*stream.cooked, desiredLevel);
+            stream.read = nullptr;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void AssetsManager::FinishPendingAsset(
+    std::shared_ptr<PendingAsset> pending)
+{
+    pending->importDone.get_future().wait();
+
+    {
+        std::unique_lock<std::mutex> lock(_uploadQueueMutex);
+
+        _uploadQueue.erase(std::remove(_uploadQueue.begin(), _uploadQueue.end(), pending), _uploadQueue.end());
+    }
+
+    pending->isBlocking = true;
+
+    while (!UploadStep(*pending))
+    {
+    }
+
+    FinishAsset(*pending);
+}
+
+void AssetsManager::ImportAsset(
+    PendingAsset &pending)
+{
+    auto fullPath = (std::filesystem::path(_baseDirectory) / std::filesystem::path(pending.assetName)).string();
+    auto cachePath = MeshCache::PathFor(fullPath);
+
+    pending.stats.importCount = 1;
+
+    // Packed caches were checked against their source when the pack was built
+    bool isPacked = _pack.Find(pending.assetName) != nullptr;
+    bool isCached = false;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (isPacked)
+    {
+        auto entry = _pack.Find(MeshCache::PathFor(pending.assetName));
+
+        const unsigned char *data = nullptr;
+        size_t size = 0;
+        isCached = entry != nullptr &&
+                   _pack.Read(*entry, data, size, pending.meshCacheStorage) &&
+                   pending.meshCache.Open(data, size, pending.vertexLayout);
+    }
+    else
+    {
+        isCached = pending.meshCache.Open(cachePath, fullPath, pending.vertexLayout);
+    }
+
+    pending.stats.Record(ImportStage::FileRead, start, isCached ? pending.meshCache.Size() : 0);
+
+    if (isCached && _buildMeshlets && !pending.meshCache.HasMeshlets())
+    {
+        spdlog::info("mesh cache {} has no meshlets", cachePath);
+
+        pending.meshCache.Close();
+        isCached = false;
+    }
+
+    if (isCached && pending.meshCache.Header().lodLevelCount != static_cast<uint32_t>(_lodLevelCount))
+    {
+        spdlog::info("mesh cache {} has {} levels of detail instead of {}", cachePath, pending.meshCache.Header().lodLevelCount, _lodLevelCount);
+
+        pending.meshCache.Close();
+        isCached = false;
+    }
+
+    std::vector<MeshDataMaterial> materials;
+
+    // Unless set, files that could take a good part of the GPU memory budget once converted are streamed
+    auto streamingThreshold = _streamingImportThreshold > 0 ? _streamingImportThreshold : _gpuMemoryBudget / 4;
+    bool isStreamed = false;
+
+    if (isCached)
+    {
+        spdlog::info("loading {} from mesh cache {}", pending.assetName, cachePath);
+
+        pending.stats.meshCacheCount = 1;
+
+        auto &header = pending.meshCache.Header();
+
+        materials.resize(header.materialCount);
+        for (size_t m = 0; m < materials.size(); m++)
+        {
+            auto &material = pending.meshCache.Material(m);
+            materials[m].diffuse = glm::vec3(material.diffuse[0], material.diffuse[1], material.diffuse[2]);
+            materials[m].diffuseTexname = pending.meshCache.MaterialDiffuseTexname(m);
+        }
+
+        // The blobs are uploaded straight from the mapping, without any intermediate copy
+        for (size_t s = 0; s < header.shapeCount; s++)
+        {
+            auto &shape = pending.meshCache.Shape(s);
+
+            MeshBounds bounds;
+            bounds.bbMin = glm::vec3(shape.bbMin[0], shape.bbMin[1], shape.bbMin[2]);
+            bounds.bbMax = glm::vec3(shape.bbMax[0], shape.bbMax[1], shape.bbMax[2]);
+            bounds.center = glm::vec3(shape.center[0], shape.center[1], shape.center[2]);
+            bounds.radius = shape.radius;
+
+            pending.shapes.push_back({pending.meshCache.ShapeVertices(s), shape.vertexCount, pending.meshCache.ShapeIndices(s), shape.indexCount, shape.lodIndexCount, shape.materialId, bounds, {}, {}});
+
+            pending.stats.vertexCount += shape.vertexCount;
+            pending.stats.triangleCount += shape.indexCount / 3;
+
+            auto meshlets = pending.meshCache.ShapeMeshlets(s);
+            for (uint32_t m = 0; m < shape.meshletCount; m++)
+            {
+                Meshlet meshlet;
+                meshlet.firstIndex = meshlets[m].firstIndex;
+                meshlet.indexCount = meshlets[m].indexCount;
+                meshlet.center = glm::vec3(meshlets[m].center[0], meshlets[m].center[1], meshlets[m].center[2]);
+                meshlet.radius = meshlets[m].radius;
+                meshlet.coneAxis = glm::vec3(meshlets[m].coneAxis[0], meshlets[m].coneAxis[1], meshlets[m].coneAxis[2]);
+                meshlet.coneCutoff = meshlets[m].coneCutoff;
+
+                pending.shapes.back().meshlets.push_back(meshlet);
+            }
+
+            auto lods = pending.meshCache.ShapeLods(s);
+            for (uint32_t l = 0; l < shape.lodCount; l++)
+            {
+                pending.shapes.back().lods.push_back({lods[l].firstIndex, lods[l].indexCount, lods[l].error});
+            }
+        }
+
+        pending.bbMin = glm::vec3(header.bbMin[0], header.bbMin[1], header.bbMin[2]);
+        pending.bbMax = glm::vec3(header.bbMax[0], header.bbMax[1], header.bbMax[2]);
+
+        pending.result = true;
+    }
+    else if (ObjSize(_pack, pending.assetName, fullPath) > streamingThreshold)
+    {
+        spdlog::info("streaming {}, it is too large to convert in one go", pending.assetName);
+
+        auto stream = std::make_shared<StreamedObj>();
+
+        isStreamed = LoadObjForStreaming(
+            *stream,
+            _threadPool,
+            _pack,
+            pending.assetName.c_str(),
+            _baseDirectory.c_str(),
+            pending.stats);
+
+        if (isStreamed)
+        {
+            ConvertMaterials(stream->obj.materials, materials);
+
+            pending.stats.streamedCount = 1;
+
+            pending.bbMin = stream->bbMin;
+            pending.bbMax = stream->bbMax;
+            pending.stream = stream;
+            pending.result = true;
+        }
+        else
+        {
+            spdlog::warn("unable to stream {}, converting it in one go", pending.assetName);
+        }
+    }
+
+    if (!isCached && !isStreamed)
+    {
+        auto scratch = AcquireScratch();
+
+        pending.result = LoadObjAndConvert(
+            pending.meshData,
+            _threadPool,
+            _pack,
+            pending.assetName.c_str(),
+            _baseDirectory.c_str(),
+            _buildMeshlets,
+            _lodLevelCount,
+            *scratch,
+            pending.stats);
+
+        ReleaseScratch(std::move(scratch));
+
+        if (pending.result)
+        {
+            if (!isPacked)
+            {
+                start = std::chrono::steady_clock::now();
+
+                uint64_t cacheBytes = 0;
+                if (MeshCache::Write(cachePath, fullPath, pending.meshData, pending.vertexLayout))
                 {
-                    tc[0][0] = 0.0f;
-                    tc[0][1] = 0.0f;
-                    tc[1][0] = 0.0f;
-                    tc[1][1] = 0.0f;
-                    tc[2][0] = 0.0f;
-                    tc[2][1] = 0.0f;
+                    std::error_code ec;
+                    auto size = std::filesystem::file_size(cachePath, ec);
+                    cacheBytes = ec ? 0 : static_cast<uint64_t>(size);
                 }
 
-                float v[3][3];
-                for (int k = 0; k < 3; k++)
+                pending.stats.Record(ImportStage::CacheWrite, start, cacheBytes);
+            }
+
+            materials = pending.meshData.materials;
+
+            start = std::chrono::steady_clock::now();
+            size_t packedBytes = 0;
+
+            pending.shapes.reserve(pending.meshData.shapes.size());
+
+            for (auto &shape : pending.meshData.shapes)
+            {
+                auto vertexCount = shape.vertices.size() / FloatsPerVertex;
+                const void *vertices = shape.vertices.data();
+                const void *indices = shape.indices.data();
+
+                if (pending.vertexLayout != VertexLayout::Float)
                 {
-                    int f0 = idx0.vertex_index;
-                    int f1 = idx1.vertex_index;
-                    int f2 = idx2.vertex_index;
-                    assert(f0 >= 0);
-                    assert(f1 >= 0);
-                    assert(f2 >= 0);
-
-                    v[0][k] = attrib.vertices[3 * f0 + k];
-                    v[1][k] = attrib.vertices[3 * f1 + k];
-                    v[2][k] = attrib.vertices[3 * f2 + k];
-                    bmin[k] = std::min(v[0][k], bmin[k]);
-                    bmin[k] = std::min(v[1][k], bmin[k]);
-                    bmin[k] = std::min(v[2][k], bmin[k]);
-                    bmax[k] = std::max(v[0][k], bmax[k]);
-                    bmax[k] = std::max(v[1][k], bmax[k]);
-                    bmax[k] = std::max(v[2][k], bmax[k]);
+                    pending.packedVertices.emplace_back();
+                    PackVertices(pending.vertexLayout, shape.vertices.data(), vertexCount, pending.meshData.bbMin, pending.meshData.bbMax, pending.packedVertices.back());
+                    vertices = pending.packedVertices.back().data();
                 }
 
-                float n[3][3];
+                // One index buffer for the shape and its levels of detail
+                if (IndexSizeFor(vertexCount) == sizeof(uint16_t))
                 {
-                    bool invalid_normal_index = false;
-                    if (attrib.normals.size() > 0)
-                    {
-                        int nf0 = idx0.normal_index;
-                        int nf1 = idx1.normal_index;
-                        int nf2 = idx2.normal_index;
-
-                        if ((nf0 < 0) || (nf1 < 0) || (nf2 < 0))
-                        {
-                            // normal index is missing from this face.
-                            invalid_normal_index = true;
-                        }
-                        else
-                        {
-                            for (int k = 0; k < 3; k++)
-                            {
-                                assert(size_t(3 * nf0 + k) < attrib.normals.size());
-                                assert(size_t(3 * nf1 + k) < attrib.normals.size());
-                                assert(size_t(3 * nf2 + k) < attrib.normals.size());
-                                n[0][k] = attrib.normals[3 * nf0 + k];
-                                n[1][k] = attrib.normals[3 * nf1 + k];
-                                n[2][k] = attrib.normals[3 * nf2 + k];
-                            }
-                        }
-                    }
-                    else
-                    {
-                        invalid_normal_index = true;
-                    }
-
-                    if (invalid_normal_index && !smoothVertexNormals.empty())
-                    {
-                        // Use smoothing normals
-                        int f0 = idx0.vertex_index;
-                        int f1 = idx1.vertex_index;
-                        int f2 = idx2.vertex_index;
-
-                        if (f0 >= 0 && f1 >= 0 && f2 >= 0)
-                        {
-                            n[0][0] = smoothVertexNormals[f0].v[0];
-                            n[0][1] = smoothVertexNormals[f0].v[1];
-                            n[0][2] = smoothVertexNormals[f0].v[2];
-
-                            n[1][0] = smoothVertexNormals[f1].v[0];
-                            n[1][1] = smoothVertexNormals[f1].v[1];
-                            n[1][2] = smoothVertexNormals[f1].v[2];
-
-                            n[2][0] = smoothVertexNormals[f2].v[0];
-                            n[2][1] = smoothVertexNormals[f2].v[1];
-                            n[2][2] = smoothVertexNormals[f2].v[2];
-
-                            invalid_normal_index = false;
-                        }
-                    }
-
-                    if (invalid_normal_index)
-                    {
-                        // compute geometric normal
-                        CalcNormal(n[0], v[0], v[1], v[2]);
-                        n[1][0] = n[0][0];
-                        n[1][1] = n[0][1];
-                        n[1][2] = n[0][2];
-                        n[2][0] = n[0][0];
-                        n[2][1] = n[0][1];
-                        n[2][2] = n[0][2];
-                    }
+                    pending.packedIndices.emplace_back(shape.indices.begin(), shape.indices.end());
+                    pending.packedIndices.back().insert(pending.packedIndices.back().end(), shape.lodIndices.begin(), shape.lodIndices.end());
+                    indices = pending.packedIndices.back().data();
                 }
-
-                for (int k = 0; k < 3; k++)
+                else if (!shape.lodIndices.empty())
                 {
-                    buffer.push_back(v[k][0]);
-                    buffer.push_back(v[k][1]);
-                    buffer.push_back(v[k][2]);
-                    buffer.push_back(n[k][0]);
-                    buffer.push_back(n[k][1]);
-                    buffer.push_back(n[k][2]);
-                    // Combine normal and diffuse to get color.
-                    float normal_factor = 0.2f;
-                    float diffuse_factor = 1 - normal_factor;
-                    float c[3] = {
-                        n[k][0] * normal_factor + diffuse[0] * diffuse_factor,
-                        n[k][1] * normal_factor + diffuse[1] * diffuse_factor,
-                        n[k][2] * normal_factor + diffuse[2] * diffuse_factor,
-                    };
-                    float len2 = c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
-                    if (len2 > 0.0f)
-                    {
-                        float len = sqrtf(len2);
-
-                        c[0] /= len;
-                        c[1] /= len;
-                        c[2] /= len;
-                    }
-                    buffer.push_back(c[0] * 0.5f + 0.5f);
-                    buffer.push_back(c[1] * 0.5f + 0.5f);
-                    buffer.push_back(c[2] * 0.5f + 0.5f);
-
-                    buffer.push_back(tc[k][0]);
-                    buffer.push_back(tc[k][1]);
+                    pending.joinedIndices.emplace_back(shape.indices);
+                    pending.joinedIndices.back().insert(pending.joinedIndices.back().end(), shape.lodIndices.begin(), shape.lodIndices.end());
+                    indices = pending.joinedIndices.back().data();
                 }
+
+                pending.shapes.push_back({vertices, vertexCount, indices, shape.indices.size(), shape.lodIndices.size(), shape.materialId, shape.bounds, std::move(shape.meshlets), std::move(shape.lods)});
+
+                packedBytes += vertexCount * VertexStrideFor(pending.vertexLayout) + (shape.indices.size() + shape.lodIndices.size()) * IndexSizeFor(vertexCount);
+
+                pending.stats.vertexCount += vertexCount;
+                pending.stats.triangleCount += shape.indices.size() / 3;
             }
 
-            o.vb_id = 0;
-            o.numTriangles = 0;
+            pending.stats.Record(ImportStage::BufferBuild, start, packedBytes);
+
+            pending.bbMin = pending.meshData.bbMin;
+            pending.bbMax = pending.meshData.bbMax;
+        }
+    }
+
+    if (!pending.result)
+    {
+        return;
+    }
+
+    pending.drawObjects.reserve(pending.stream != nullptr ? pending.stream->obj.shapes.size() : pending.shapes.size());
 
-            // OpenGL viewer does not support texturing with per-face material.
-            if (shapes[s].mesh.material_ids.size() > 0 && shapes[s].mesh.material_ids.size() > s)
+    pending.materials.resize(materials.size());
+    for (size_t m = 0; m < materials.size(); m++)
+    {
+        pending.materials[m].diffuse = materials[m].diffuse;
+
+        std::string texturePath;
+        if (materials[m].diffuseTexname.empty() || !ResolveTexturePath(materials[m].diffuseTexname, _pack, _baseDirectory.c_str(), texturePath))
+        {
+            continue;
+        }
+
+        bool isNew = false;
+        pending.materials[m].diffuseTexture = AcquireTexture(texturePath, isNew);
+
+        // Only the first asset to use a texture decodes it, the others share the upload
+        if (isNew)
+        {
+            DecodedTexture texture = {};
+            texture.texture = pending.materials[m].diffuseTexture;
+
+            // Includes cooking the texture the first time it is decoded
+            start = std::chrono::steady_clock::now();
+
+            if (DecodeTexture(texture, _pack))
             {
-                o.material_id = shapes[s].mesh.material_ids[0]; // use the material ID
-                                                                // of the first face.
+                auto bytes = texture.cooked != nullptr ? CompressedBytes(*texture.cooked, 0) : size_t(texture.w) * size_t(texture.h) * size_t(texture.comp);
+                pending.stats.Record(ImportStage::TextureDecode, start, bytes);
+                pending.stats.textureCount++;
+
+                pending.textures.push_back(texture);
             }
             else
             {
-                o.material_id = static_cast<int>(materials.size()) - 1; // = ID for default material.
+                pending.stats.Record(ImportStage::TextureDecode, start, 0);
+            }
+        }
+    }
+}
+
+std::shared_ptr<LoadedTexture> AssetsManager::AcquireTexture(
+    const std::string &canonicalPath,
+    bool &isNew)
+{
+    std::unique_lock<std::mutex> lock(_texturesMutex);
+
+    auto &cached = _textures[canonicalPath];
+
+    isNew = cached.texture == nullptr;
+    if (isNew)
+    {
+        cached.texture = std::make_shared<LoadedTexture>();
+        cached.texture->path = canonicalPath;
+    }
+
+    cached.references++;
+
+    return cached.texture;
+}
+
+void AssetsManager::ReleaseTexture(
+    const std::shared_ptr<LoadedTexture> &texture)
+{
+    std::unique_lock<std::mutex> lock(_texturesMutex);
+
+    auto cached = _textures.find(texture->path);
+    if (cached == _textures.end() || --cached->second.references > 0)
+    {
+        return;
+    }
+
+    if (texture->textureId != 0)
+    {
+        glDeleteTextures(1, &texture->textureId);
+        texture->textureId = 0;
+    }
+
+    // Unmaps the cooked file
+    texture->stream = nullptr;
+
+    spdlog::debug("evicted texture {}", texture->path);
+
+    _textures.erase(cached);
+}
+
+bool AssetsManager::UploadStep(
+    PendingAsset &pending)
+{
+    if (!pending.result)
+    {
+        return true;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (pending.nextTexture < pending.textures.size())
+    {
+        auto &texture = pending.textures[pending.nextTexture++];
+
+        texture.texture->width = texture.w;
+        texture.texture->height = texture.h;
+
+        if (texture.cooked != nullptr)
+        {
+            // Only the tail is uploaded now, the larger levels are streamed in when asked for
+            auto tailLevel = TailLevel(*texture.cooked);
+
+            texture.texture->textureId = CreateCompressedTexture(*texture.cooked, tailLevel);
+            texture.texture->levelCount = static_cast<int>(texture.cooked->LevelCount());
+            texture.texture->residentLevel = tailLevel;
+            texture.texture->gpuBytes = CompressedBytes(*texture.cooked, tailLevel);
+            texture.texture->hasAlpha = texture.cooked->InternalFormat() == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+
+            if (tailLevel > 0)
+            {
+                texture.texture->stream = std::make_shared<TextureStream>();
+                texture.texture->stream->cooked = texture.cooked;
+                texture.texture->stream->tailLevel = tailLevel;
+                texture.texture->stream->requestedLevel = tailLevel;
             }
 
-            spdlog::info("shape[{}] material_id {}", int(s), int(o.material_id));
+            texture.cooked = nullptr;
+        }
+        else
+        {
+            // Estimate, the driver may pad RGB to RGBA
+            texture.texture->gpuBytes = size_t(texture.w) * size_t(texture.h) * size_t(texture.comp) * 4 / 3;
+            texture.texture->hasAlpha = texture.comp == 4;
+            texture.texture->textureId = UploadTexture(texture);
+        }
+
+        pending.stats.Record(ImportStage::Upload, start, texture.texture->gpuBytes);
+    }
+    else if (pending.stream != nullptr)
+    {
+        StreamShapes(pending);
+    }
+    else if (pending.nextShape < pending.shapes.size())
+    {
+        auto &shape = pending.shapes[pending.nextShape++];
+
+        pending.drawObjects.push_back(UploadDrawObject(_stagingRing, shape.vertices, shape.vertexCount, shape.indices, shape.indexCount, shape.lodIndexCount, pending.vertexLayout, shape.materialId));
+        pending.drawObjects.back().bounds = shape.bounds;
+        pending.drawObjects.back().meshlets = std::move(shape.meshlets);
+        pending.drawObjects.back().lods = std::move(shape.lods);
+
+        pending.stats.Record(ImportStage::Upload, start, pending.drawObjects.back().num_bytes);
+    }
+
+    return pending.nextTexture >= pending.textures.size() &&
+           pending.nextShape >= pending.shapes.size() &&
+           pending.stream == nullptr;
+}
+
+void AssetsManager::StreamShapes(
+    PendingAsset &pending)
+{
+    auto &stream = *pending.stream;
+
+    if (stream.chunk == nullptr)
+    {
+        if (stream.shape >= stream.obj.shapes.size())
+        {
+            // Frees the parsed file
+            pending.stream = nullptr;
+
+            return;
+        }
+
+        stream.chunk = StartChunk(pending, stream.shape, 0);
+    }
+
+    if (!stream.chunk->ready)
+    {
+        return;
+    }
+
+    auto chunk = stream.chunk;
+    auto nextTriangle = chunk->firstTriangle + chunk->triangleCount;
+
+    // The next chunk converts while this one uploads, at most two are in memory
+    stream.chunk = chunk->isLast ? nullptr : StartChunk(pending, chunk->shape, nextTriangle);
+
+    // Blocking imports convert the next chunk in StartChunk, that is not part of the upload
+    auto start = std::chrono::steady_clock::now();
+
+    // Sized for all triangles the shape can have, a few polygons may end up with fewer
+    auto triangleCount = stream.obj.shapes[chunk->shape].triangleCount;
+    auto stride = VertexStrideFor(pending.vertexLayout);
+    auto indexSize = IndexSizeFor(3 * triangleCount);
+
+    if (chunk->firstTriangle == 0)
+    {
+        // Storage for the whole shape, filled in by this chunk and the ones after it
+        stream.drawObject = UploadDrawObject(_stagingRing, nullptr, 3 * triangleCount, nullptr, 3 * triangleCount, 0, pending.vertexLayout, chunk->materialId);
+        stream.drawObject.bounds.bbMin = glm::vec3(std::numeric_limits<float>::max());
+        stream.drawObject.bounds.bbMax = glm::vec3(-std::numeric_limits<float>::max());
+    }
+
+    auto &bounds = stream.drawObject.bounds;
+
+    if (chunk->triangleCount > 0)
+    {
+        if (_stagingRing.IsAvailable())
+        {
+            _stagingRing.Upload(stream.drawObject.vb_id, 3 * chunk->firstTriangle * stride, chunk->vertices.data(), chunk->vertices.size());
+            _stagingRing.Upload(stream.drawObject.ib_id, 3 * chunk->firstTriangle * indexSize, chunk->indices.data(), chunk->indices.size());
+        }
+        else
+        {
+            glBindVertexArray(stream.drawObject.va_id);
+            glBindBuffer(GL_ARRAY_BUFFER, stream.drawObject.vb_id);
+            glBufferSubData(GL_ARRAY_BUFFER, 3 * chunk->firstTriangle * stride, chunk->vertices.size(), chunk->vertices.data());
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 3 * chunk->firstTriangle * indexSize, chunk->indices.size(), chunk->indices.data());
+            glBindVertexArray(0);
+        }
+
+        bounds.bbMin = glm::min(bounds.bbMin, chunk->bbMin);
+        bounds.bbMax = glm::max(bounds.bbMax, chunk->bbMax);
+    }
+
+    pending.stats.Add(chunk->stats);
+    pending.stats.Record(ImportStage::Upload, start, chunk->vertices.size() + chunk->indices.size());
+
+    if (chunk->isLast)
+    {
+        stream.drawObject.numIndices = static_cast<int>(3 * nextTriangle);
+        stream.drawObject.numTriangles = static_cast<int>(nextTriangle);
+
+        // The vertices are gone by now, the sphere is the one around the box
+        if (nextTriangle == 0)
+        {
+            bounds.bbMin = bounds.bbMax = glm::vec3(0.0f);
+        }
+
+        bounds.center = (bounds.bbMin + bounds.bbMax) * 0.5f;
+        bounds.radius = glm::length(bounds.bbMax - bounds.bbMin) * 0.5f;
+
+        pending.drawObjects.push_back(std::move(stream.drawObject));
+        stream.shape++;
+    }
+}
+
+std::shared_ptr<StreamChunk> AssetsManager::StartChunk(
+    PendingAsset &pending,
+    size_t shape,
+    size_t firstTriangle)
+{
+    auto chunk = std::make_shared<StreamChunk>();
+    chunk->shape = shape;
+    chunk->firstTriangle = firstTriangle;
+
+    auto convert = [stream = pending.stream, chunk, vertexLayout = pending.vertexLayout]() {
+        ConvertChunk(*stream, *chunk, vertexLayout);
+        chunk->ready = true;
+    };
+
+    if (pending.isBlocking)
+    {
+        convert();
+    }
+    else
+    {
+        _threadPool.Enqueue(convert);
+    }
 
-            auto vertexAttribSize = 3 / sizeof(float);
-            auto normalAttribSize = 3 / sizeof(float);
-            auto colorAttribSize = 3 / sizeof(float);
-            auto texcoordsAttribSize = 2 / sizeof(float);
+    return chunk;
+}
 
-            auto stride = vertexAttribSize + normalAttribSize + colorAttribSize + texcoordsAttribSize;
+void AssetsManager::FinishAsset(
+    PendingAsset &pending)
+{
+    auto asset = pending.asset;
 
-            if (buffer.size() > 0)
+    if (pending.result)
+    {
+        asset.get()->bbMax = pending.bbMax;
+        asset.get()->bbMin = pending.bbMin;
+        asset.get()->center = (pending.bbMin + pending.bbMax) * 0.5f;
+        asset.get()->radius = 0.0f;
+        for (auto &obj : pending.drawObjects)
+        {
+            if (obj.numIndices > 0)
             {
-                glGenVertexArrays(1, &o.va_id);
-                glGenBuffers(1, &o.vb_id);
-
-                glBindVertexArray(o.va_id);
-                glBindBuffer(GL_ARRAY_BUFFER, o.vb_id);
-
-                glBufferData(GL_ARRAY_BUFFER, buffer.size() * sizeof(float), &buffer.at(0), GL_STATIC_DRAW);
-                o.numTriangles = static_cast<int>(buffer.size()) / (3 + 3 + 3 + 2) / 3; // 3:vtx, 3:normal, 3:col, 2:texcoord
-
-                // vertex positions
-                glEnableVertexAttribArray(0);
-                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-                // vertex normals
-                glEnableVertexAttribArray(1);
-                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)vertexAttribSize);
-                // vertex colors
-                glEnableVertexAttribArray(2);
-                glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void*)(vertexAttribSize + normalAttribSize));
-                // vertex texture coords
-                glEnableVertexAttribArray(3);
-                glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void*)(vertexAttribSize + normalAttribSize + colorAttribSize));
-
-                glBindVertexArray(0);
-
-                spdlog::info("shape[{}] # of triangles = {}", static_cast<int>(s), o.numTriangles);
+                asset.get()->radius = std::max(asset.get()->radius, glm::length(obj.bounds.center - asset.get()->center) + obj.bounds.radius);
             }
+        }
+
+        asset.get()->materials = std::move(pending.materials);
+
+        asset.get()->shaderId = GetMeshWithoutAnimationShader();
+
+        asset.get()->loadedMeshes.reserve(pending.drawObjects.size());
+
+        for (auto &obj : pending.drawObjects)
+        {
+            LoadedMesh mesh;
+            mesh.materialId = obj.material_id;
+            mesh.triangleCount = obj.numTriangles;
+            mesh.indexCount = obj.numIndices;
+            mesh.indexType = obj.index_type;
+            mesh.vao = obj.va_id;
+            mesh.vbo = obj.vb_id;
+            mesh.ibo = obj.ib_id;
+            mesh.vertexLayout = pending.vertexLayout;
+            mesh.bounds = obj.bounds;
+            mesh.meshlets = std::move(obj.meshlets);
+            mesh.lods = std::move(obj.lods);
+            PositionDequantization(pending.vertexLayout, pending.bbMin, pending.bbMax, mesh.positionOffset, mesh.positionScale);
+
+            asset.get()->loadedMeshes.push_back(std::move(mesh));
+            asset.get()->gpuBytes += obj.num_bytes;
+        }
+
+        if (asset.get()->shaderId > 0)
+        {
+            asset.get()->importStats = pending.stats;
+            asset.get()->isResident = true;
+
+            _importStats.Add(pending.stats);
 
-            drawObjects->push_back(o);
+            spdlog::info("imported {} in {:.1f} ms", pending.assetName, pending.stats.TotalMilliseconds());
+        }
+        else
+        {
+            spdlog::error("failed to load {}, there is no 'mesh-without-animation' shader", pending.assetName);
+
+            // Nothing draws it, the uploaded buffers and textures are freed until the next try
+            FreeAsset(*asset);
+            asset.get()->isFailed = true;
         }
     }
+    else
+    {
+        spdlog::error("failed to load {}", pending.assetName);
 
-    spdlog::info("bmin = {}, {}, {}", bmin[0], bmin[1], bmin[2]);
-    spdlog::info("bmax = {}, {}, {}", bmax[0], bmax[1], bmax[2]);
+        asset.get()->isFailed = true;
+    }
 
-    return true;
+    _pendingAssets.erase(pending.assetName);
+}
+
+void AssetsManager::UnloadAsset(
+    std::shared_ptr<LoadedAsset> asset,
+    int references)
+{
+    if (asset->references < references)
+    {
+        spdlog::warn("unloading an asset that is not loaded");
+
+        references = std::max(asset->references, 0);
+    }
+
+    asset->references -= references;
+    asset->lastUsedFrame = _frame;
+}
+
+namespace // Local utility functions
+{
+    static bool FileExists(
+        const std::string &abs_filename)
+    {
+        if (!std::filesystem::exists(std::filesystem::path(abs_filename)))
+        {
+            spdlog::error("{} does not exist", abs_filename);
+
+            return false;
+        }
+
+        return true;
+    }
+
+    // Reads .mtl files from the pack, and from the assets directory when the pack does not have them
+    class PackMaterialReader : public tinyobj::MaterialReader
+    {
+    public:
+        PackMaterialReader(
+            const AssetPack &pack,
+            const std::string &baseDirectory)
+            : _pack(pack),
+              _fileReader(baseDirectory + "/")
+        {}
+
+        virtual ~PackMaterialReader() {}
+
+        virtual bool operator()(
+            const std::string &matId,
+            std::vector<tinyobj::material_t> *materials,
+            std::map<std::string, int> *matMap,
+            std::string *warn,
+            std::string *err) override
+        {
+            auto entry = _pack.Find(matId);
+            if (entry == nullptr)
+            {
+                return _fileReader(matId, materials, matMap, warn, err);
+            }
+
+            const unsigned char *data = nullptr;
+            size_t size = 0;
+            std::vector<unsigned char> storage;
+            if (!_pack.Read(*entry, data, size, storage))
+            {
+                if (err)
+                {
+                    (*err) += "Unable to read material file [ " + matId + " ] from the asset pack\n";
+                }
+
+                return false;
+            }
+
+            MemoryStream stream(reinterpret_cast<const char *>(data), size);
+            tinyobj::LoadMtl(matMap, materials, &stream, warn, err);
+
+            return true;
+        }
+
+    private:
+        const AssetPack &_pack;
+        MappedMaterialReader _fileReader;
+    };
+
+} // namespace
+
+// Parses the OBJ file, from the pack when it is in there, and appends the default material.
+// materialLibraries gets the paths of the .mtl files the OBJ asked for, found or not.
+static bool ParseObj(
+    tinyobj::attrib_t &attrib,
+    std::vector<tinyobj::shape_t> &shapes,
+    std::vector<tinyobj::material_t> &materials,
+    std::vector<std::string> &materialLibraries,
+    ThreadPool &threadPool,
+    const AssetPack &pack,
+    const char *filename,
+    const char *base_dir,
+    ImportStats &stats)
+{
+    auto fullPath = std::filesystem::path(base_dir) / std::filesystem::path(filename);
+
+    std::string warn;
+    std::string err;
+    ObjParser parser(threadPool);
+    bool ret = false;
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto entry = pack.Find(filename);
+    if (entry != nullptr)
+    {
+        const unsigned char *data = nullptr;
+        size_t size = 0;
+        std::vector<unsigned char> storage;
+        if (!pack.Read(*entry, data, size, storage))
+        {
+            return false;
+        }
+
+        stats.Record(ImportStage::FileRead, start, size);
+        start = std::chrono::steady_clock::now();
+
+        PackMaterialReader materialReader(pack, base_dir);
+        ret = parser.LoadObj(
+            &attrib,
+            &shapes,
+            &materials,
+            &warn,
+            &err,
+            reinterpret_cast<const char *>(data),
+            size,
+            &materialReader);
+
+        stats.Record(ImportStage::Parse, start, size);
+    }
+    else
+    {
+        // The file is mapped, it is read while it is parsed
+        auto size = ObjSize(pack, filename, fullPath.string());
+
+        stats.Record(ImportStage::FileRead, start, size);
+        start = std::chrono::steady_clock::now();
+
+        // Opening the file reports a missing file, no need to look for it first
+        ret = parser.LoadObj(
+            &attrib,
+            &shapes,
+            &materials,
+            &warn,
+            &err,
+            fullPath.string().c_str(),
+            base_dir);
+
+        stats.Record(ImportStage::Parse, start, size);
+    }
+
+    if (!warn.empty())
+    {
+        spdlog::warn(warn);
+    }
+
+    if (!err.empty())
+    {
+        spdlog::error(err);
+    }
+
+    if (!ret)
+    {
+        return false;
+    }
+
+    for (auto &library : parser.MaterialLibraries())
+    {
+        materialLibraries.push_back((std::filesystem::path(base_dir) / std::filesystem::path(library)).string());
+    }
+
+    spdlog::info("# of vertices  = {}", (int)(attrib.vertices.size()) / 3);
+    spdlog::info("# of normals   = {}", (int)(attrib.normals.size()) / 3);
+    spdlog::info("# of texcoords = {}", (int)(attrib.texcoords.size()) / 2);
+    spdlog::info("# of materials = {}", (int)materials.size());
+    spdlog::info("# of shapes    = {}", (int)shapes.size());
+
+    // Append `default` material
+    materials.push_back(tinyobj::material_t());
+
+    for (size_t i = 0; i < materials.size(); i++)
+    {
+        spdlog::info("material[{}].diffuse_texname = {}", int(i), materials[i].diffuse_texname.c_str());
+    }
+
+    return true;
+}
+
+static bool LoadObjAndConvert(
+    MeshData &meshData,
+    ThreadPool &threadPool,
+    const AssetPack &pack,
+    const char *filename,
+    const char *base_dir,
+    bool buildMeshlets,
+    int lodLevelCount,
+    ImportScratch &scratch,
+    ImportStats &stats)
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+
+    if (!ParseObj(attrib, shapes, materials, meshData.materialLibraries, threadPool, pack, filename, base_dir, stats))
+    {
+        return false;
+    }
+
+    ConvertObj(meshData, attrib, shapes, materials, threadPool, buildMeshlets, lodLevelCount, scratch, stats);
+
+    return true;
+}
+
+static size_t ObjSize(
+    const AssetPack &pack,
+    const std::string &filename,
+    const std::string &fullPath)
+{
+    auto entry = pack.Find(filename);
+    if (entry != nullptr)
+    {
+        return static_cast<size_t>(entry->size);
+    }
+
+    // A missing file is reported by the import
+    std::error_code ec;
+    auto size = std::filesystem::file_size(fullPath, ec);
+
+    return ec ? 0 : static_cast<size_t>(size);
+}
+
+static bool LoadObjForStreaming(
+    StreamedObj &stream,
+    ThreadPool &threadPool,
+    const AssetPack &pack,
+    const char *filename,
+    const char *base_dir,
+    ImportStats &stats)
+{
+    auto fullPath = std::filesystem::path(base_dir) / std::filesystem::path(filename);
+
+    std::string warn;
+    std::string err;
+    ObjParser parser(threadPool);
+    bool ret = false;
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto entry = pack.Find(filename);
+    if (entry != nullptr)
+    {
+        const unsigned char *data = nullptr;
+        size_t size = 0;
+        if (!pack.Read(*entry, data, size, stream.storage))
+        {
+            return false;
+        }
+
+        stats.Record(ImportStage::FileRead, start, size);
+        start = std::chrono::steady_clock::now();
+
+        // The faces are read back from the pack mapping, or from the storage when it was compressed
+        PackMaterialReader materialReader(pack, base_dir);
+        ret = parser.LoadObjForStreaming(
+            stream.obj,
+            &warn,
+            &err,
+            reinterpret_cast<const char *>(data),
+            size,
+            &materialReader);
+
+        stats.Record(ImportStage::Parse, start, size);
+    }
+    else
+    {
+        auto size = ObjSize(pack, filename, fullPath.string());
+
+        stats.Record(ImportStage::FileRead, start, size);
+        start = std::chrono::steady_clock::now();
+
+        ret = parser.LoadObjForStreaming(
+            stream.obj,
+            &warn,
+            &err,
+            fullPath.string().c_str(),
+            base_dir);
+
+        stats.Record(ImportStage::Parse, start, size);
+    }
+
+    if (!warn.empty())
+    {
+        spdlog::warn(warn);
+    }
+
+    if (!err.empty())
+    {
+        spdlog::error(err);
+    }
+
+    if (!ret)
+    {
+        return false;
+    }
+
+    auto &attrib = stream.obj.attrib;
+
+    spdlog::info("# of vertices  = {}", (int)(attrib.vertices.size()) / 3);
+    spdlog::info("# of normals   = {}", (int)(attrib.normals.size()) / 3);
+    spdlog::info("# of texcoords = {}", (int)(attrib.texcoords.size()) / 2);
+    spdlog::info("# of materials = {}", (int)stream.obj.materials.size());
+    spdlog::info("# of shapes    = {}", (int)stream.obj.shapes.size());
+
+    // Append `default` material
+    stream.obj.materials.push_back(tinyobj::material_t());
+
+    start = std::chrono::steady_clock::now();
+
+    // Packed layouts are quantized to the box around all positions, the faces are not known yet
+    float bmin[3], bmax[3];
+    bmin[0] = bmin[1] = bmin[2] = std::numeric_limits<float>::max();
+    bmax[0] = bmax[1] = bmax[2] = -std::numeric_limits<float>::max();
+
+    for (size_t v = 0; v < attrib.vertices.size() / 3; v++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            bmin[k] = std::min(attrib.vertices[3 * v + k], bmin[k]);
+            bmax[k] = std::max(attrib.vertices[3 * v + k], bmax[k]);
+        }
+    }
+
+    size_t triangleCount = 0;
+    for (auto &shape : stream.obj.shapes)
+    {
+        triangleCount += shape.triangleCount;
+    }
+
+    spdlog::info("streaming at most {} triangles in chunks of {}", triangleCount, StreamChunkFaces);
+
+    stats.Record(ImportStage::BufferBuild, start, 0);
+
+    stream.bbMin = glm::vec3(bmin[0], bmin[1], bmin[2]);
+    stream.bbMax = glm::vec3(bmax[0], bmax[1], bmax[2]);
+
+    return true;
+}
+
+static void ConvertChunk(
+    StreamedObj &stream,
+    StreamChunk &chunk,
+    VertexLayout vertexLayout)
+{
+    auto &shape = stream.obj.shapes[chunk.shape];
+    auto &normals = stream.scratch.smoothVertexNormals;
+
+    // Chunks of a shape are converted one after the other, the first one reads all faces of the
+    // shape once to sum up the smoothing normals for the rest
+    if (chunk.firstTriangle == 0)
+    {
+        if (stream.hasSmoothVertexNormals)
+        {
+            std::fill(normals.begin() + 3 * stream.smoothVertexBegin, normals.begin() + 3 * stream.smoothVertexEnd, 0.0f);
+            stream.hasSmoothVertexNormals = false;
+        }
+
+        if (shape.hasSmoothingGroup)
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            normals.resize(stream.obj.attrib.vertices.size());
+            stream.smoothVertexBegin = std::numeric_limits<int>::max();
+            stream.smoothVertexEnd = 0;
+
+            stream.obj.Rewind(chunk.shape);
+            while (stream.obj.ReadTriangles(StreamChunkFaces, stream.part))
+            {
+                AccumulateSmoothingNormals(stream.obj.attrib, stream.part, normals, stream.smoothVertexBegin, stream.smoothVertexEnd);
+            }
+
+            NormalizeSmoothingNormals(normals, stream.smoothVertexBegin, stream.smoothVertexEnd);
+
+            chunk.stats.Record(ImportStage::NormalGeneration, start, normals.size() * sizeof(float));
+
+            stream.hasSmoothVertexNormals = true;
+        }
+
+        stream.obj.Rewind(chunk.shape);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto &part = stream.part;
+    stream.obj.ReadTriangles(StreamChunkFaces, part);
+
+    chunk.triangleCount = part.mesh.indices.size() / 3;
+    chunk.isLast = stream.obj.AtEnd();
+
+    if (chunk.firstTriangle == 0)
+    {
+        chunk.materialId = ShapeMaterialId(part, 0, stream.obj.materials.size());
+    }
+
+    std::vector<unsigned char> &vertices = chunk.vertices;
+
+    // Packed layouts are converted in the scratch first, no two chunks of a stream convert at the same time
+    MeshVertex *out = nullptr;
+    if (vertexLayout == VertexLayout::Float)
+    {
+        vertices.resize(chunk.triangleCount * 3 * sizeof(MeshVertex));
+        out = reinterpret_cast<MeshVertex *>(vertices.data());
+    }
+    else
+    {
+        stream.scratch.soup.resize(chunk.triangleCount * 3);
+        out = stream.scratch.soup.data();
+    }
+
+    chunk.bbMin = glm::vec3(std::numeric_limits<float>::max());
+    chunk.bbMax = glm::vec3(-std::numeric_limits<float>::max());
+
+    for (size_t f = 0; f < chunk.triangleCount; f++)
+    {
+        ConvertFace(
+            stream.obj.attrib,
+            part,
+            stream.obj.materials,
+            stream.hasSmoothVertexNormals ? normals.data() : nullptr,
+            f,
+            out + f * 3);
+
+        for (int c = 0; c < 3; c++)
+        {
+            auto position = glm::vec3(out[f * 3 + c].position[0], out[f * 3 + c].position[1], out[f * 3 + c].position[2]);
+
+            chunk.bbMin = glm::min(chunk.bbMin, position);
+            chunk.bbMax = glm::max(chunk.bbMax, position);
+        }
+    }
+
+    if (vertexLayout != VertexLayout::Float)
+    {
+        PackVertices(vertexLayout, reinterpret_cast<const float *>(out), chunk.triangleCount * 3, stream.bbMin, stream.bbMax, vertices);
+    }
+
+    // Vertices are not shared between faces, the indices just count up. The index size is the
+    // one of the whole shape, its buffers are allocated before the triangle count is exact.
+    auto firstIndex = chunk.firstTriangle * 3;
+    auto indexCount = chunk.triangleCount * 3;
+    if (IndexSizeFor(3 * shape.triangleCount) == sizeof(uint16_t))
+    {
+        chunk.indices.resize(indexCount * sizeof(uint16_t));
+        auto indices = reinterpret_cast<uint16_t *>(chunk.indices.data());
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            indices[i] = static_cast<uint16_t>(firstIndex + i);
+        }
+    }
+    else
+    {
+        chunk.indices.resize(indexCount * sizeof(uint32_t));
+        auto indices = reinterpret_cast<uint32_t *>(chunk.indices.data());
+        for (size_t i = 0; i < indexCount; i++)
+        {
+            indices[i] = static_cast<uint32_t>(firstIndex + i);
+        }
+    }
+
+    chunk.stats.vertexCount += indexCount;
+    chunk.stats.triangleCount += chunk.triangleCount;
+    chunk.stats.Record(ImportStage::BufferBuild, start, chunk.vertices.size() + chunk.indices.size());
+}
+
+static bool ResolveTexturePath(
+    const std::string &texname,
+    const AssetPack &pack,
+    const char *base_dir,
+    std::string &canonicalPath)
+{
+    // Packed textures are keyed by their name in the pack, loose ones by an absolute path
+    if (pack.Find(texname) != nullptr)
+    {
+        canonicalPath = AssetPack::NormalizeName(texname);
+
+        return true;
+    }
+
+    std::string texture_filename = texname;
+    if (!FileExists(texture_filename))
+    {
+        // Append base dir.
+        texture_filename = (std::filesystem::path(base_dir) / std::filesystem::path(texname)).string();
+        if (!FileExists(texture_filename))
+        {
+            spdlog::error("Unable to find file: {}", texname);
+
+            return false;
+        }
+    }
+
+    // The same file reached through different relative paths must end up in the same cache entry
+    std::error_code ec;
+    auto canonical = std::filesystem::weakly_canonical(std::filesystem::path(texture_filename), ec);
+
+    canonicalPath = ec ? texture_filename : canonical.string();
+
+    return true;
+}
+
+static bool DecodePackedTexture(
+    DecodedTexture &texture,
+    const AssetPack &pack,
+    const AssetPackEntry &entry)
+{
+    auto &path = texture.texture->path;
+
+    // Cooked textures stream from the mapping, so they are only used when stored as is
+    auto cookedEntry = pack.Find(CookedTexture::PathFor(path));
+    if (cookedEntry != nullptr && (cookedEntry->flags & AssetPackCompressed) == 0)
+    {
+        const unsigned char *data = nullptr;
+        size_t size = 0;
+        std::vector<unsigned char> storage;
+
+        auto cooked = std::make_shared<CookedTexture>();
+        if (pack.Read(*cookedEntry, data, size, storage) &&
+            cooked->Open(data, size) &&
+            CookedTexture::IsFormatSupported(cooked->InternalFormat()))
+        {
+            texture.w = cooked->Level(0).width;
+            texture.h = cooked->Level(0).height;
+            texture.cooked = cooked;
+
+            spdlog::info("Loaded packed cooked texture: {}, w = {}, h = {}, levels = {}", path, texture.w, texture.h, cooked->LevelCount());
+
+            return true;
+        }
+    }
+
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    std::vector<unsigned char> storage;
+    if (!pack.Read(entry, data, size, storage) || size > INT_MAX)
+    {
+        spdlog::error("Unable to read texture from pack: {}", path);
+
+        return false;
+    }
+
+    texture.image = stbi_load_from_memory(data, static_cast<int>(size), &texture.w, &texture.h, &texture.comp, STBI_default);
+    if (!texture.image)
+    {
+        spdlog::error("Unable to load texture: {}", path);
+
+        return false;
+    }
+
+    spdlog::info("Loaded packed texture: {}, w = {}, h = {}, comp = {}", path, texture.w, texture.h, texture.comp);
+
+    return true;
+}
+
+static bool DecodeTexture(
+    DecodedTexture &texture,
+    const AssetPack &pack)
+{
+    auto &path = texture.texture->path;
+
+    auto entry = pack.Find(path);
+    if (entry != nullptr)
+    {
+        return DecodePackedTexture(texture, pack, *entry);
+    }
+
+    auto cookedPath = CookedTexture::PathFor(path);
+
+    // An up to date cooked texture skips the image decode completely
+    auto cooked = std::make_shared<CookedTexture>();
+    if (cooked->Open(cookedPath, path) && CookedTexture::IsFormatSupported(cooked->InternalFormat()))
+    {
+        texture.w = cooked->Level(0).width;
+        texture.h = cooked->Level(0).height;
+        texture.cooked = cooked;
+
+        spdlog::info("Loaded cooked texture: {}, w = {}, h = {}, levels = {}", cookedPath, texture.w, texture.h, cooked->LevelCount());
+
+        return true;
+    }
+
+    texture.image = stbi_load(path.c_str(), &texture.w, &texture.h, &texture.comp, STBI_default);
+    if (!texture.image)
+    {
+        spdlog::error("Unable to load texture: {}", path);
+
+        return false;
+    }
+
+    spdlog::info("Loaded texture: {}, w = {}, h = {}, comp = {}", path, texture.w, texture.h, texture.comp);
+
+    // Without driver support for the format the raw pixels are uploaded instead
+    if (CookedTexture::IsFormatSupported(CookedTexture::FormatFor(texture.image, texture.w, texture.h, texture.comp)) &&
+        CookedTexture::Cook(cookedPath, path, texture.image, texture.w, texture.h, texture.comp) &&
+        cooked->Open(cookedPath, path))
+    {
+        stbi_image_free(texture.image);
+        texture.image = nullptr;
+        texture.cooked = cooked;
+    }
+
+    return true;
+}
+
+static GLuint UploadTexture(
+    DecodedTexture &texture)
+{
+    GLuint texture_id;
+
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    static const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+
+    auto format = formats[std::clamp(texture.comp, 1, 4) - 1];
+
+    // Rows of RGB images are not 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, texture.w, texture.h, 0, format, GL_UNSIGNED_BYTE, texture.image);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // The decoded pixels are not needed anymore once the driver has its copy
+    stbi_image_free(texture.image);
+    texture.image = nullptr;
+
+    return texture_id;
+}
+
+static GLuint CreateCompressedTexture(
+    const CookedTexture &cooked,
+    int firstLevel)
+{
+    GLuint texture_id;
+
+    glGenTextures(1, &texture_id);
+    glBindTexture(GL_TEXTURE_2D, texture_id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    for (size_t i = static_cast<size_t>(firstLevel); i < cooked.LevelCount(); i++)
+    {
+        auto &level = cooked.Level(i);
+
+        glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i), cooked.InternalFormat(), level.width, level.height, 0, static_cast<GLsizei>(level.size), level.data);
+    }
+
+    // Levels below the base level are left undefined until they are streamed in
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, firstLevel);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(cooked.LevelCount() - 1));
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return texture_id;
+}
+
+static size_t CompressedBytes(
+    const CookedTexture &cooked,
+    int firstLevel)
+{
+    size_t bytes = 0;
+    for (size_t i = static_cast<size_t>(firstLevel); i < cooked.LevelCount(); i++)
+    {
+        bytes += cooked.Level(i).size;
+    }
+
+    return bytes;
+}
+
+static int TailLevel(
+    const CookedTexture &cooked)
+{
+    int level = 0;
+    while (level + 1 < static_cast<int>(cooked.LevelCount()) &&
+           std::max(cooked.Level(level).width, cooked.Level(level).height) > TextureTailSize)
+    {
+        level++;
+    }
+
+    return level;
+}
+
+static DrawObject UploadDrawObject(
+    StagingRing &stagingRing,
+    const void *vertices,
+    size_t vertexCount,
+    const void *indices,
+    size_t indexCount,
+    size_t lodIndexCount,
+    VertexLayout vertexLayout,
+    int materialId)
+{
+    DrawObject o;
+    o.va_id = 0;
+    o.vb_id = 0;
+    o.ib_id = 0;
+    o.numTriangles = 0;
+    o.numIndices = 0;
+    o.index_type = GL_UNSIGNED_INT;
+    o.material_id = materialId;
+    o.num_bytes = 0;
+
+    auto stride = VertexStrideFor(vertexLayout);
+
+    if (vertexCount > 0 && indexCount > 0)
+    {
+        auto indexSize = IndexSizeFor(vertexCount);
+        auto vertexBytes = vertexCount * stride;
+        auto indexBytes = (indexCount + lodIndexCount) * indexSize;
+
+        // Through the ring the buffers are only allocated here and filled with copies on the GPU
+        auto isStaged = stagingRing.IsAvailable();
+
+        glGenVertexArrays(1, &o.va_id);
+        glGenBuffers(1, &o.vb_id);
+        glGenBuffers(1, &o.ib_id);
+
+        glBindVertexArray(o.va_id);
+        glBindBuffer(GL_ARRAY_BUFFER, o.vb_id);
+
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, isStaged ? nullptr : vertices, GL_STATIC_DRAW);
+
+        // The element buffer binding is part of the vertex array state
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, o.ib_id);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, isStaged ? nullptr : indices, GL_STATIC_DRAW);
+
+        o.numIndices = static_cast<int>(indexCount);
+        o.numTriangles = static_cast<int>(indexCount) / 3;
+        o.index_type = indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        o.num_bytes = vertexBytes + indexBytes;
+
+        SetupVertexAttributes(vertexLayout);
+
+        glBindVertexArray(0);
+
+        if (isStaged && vertices != nullptr)
+        {
+            stagingRing.Upload(o.vb_id, 0, vertices, vertexBytes);
+        }
+
+        if (isStaged && indices != nullptr)
+        {
+            stagingRing.Upload(o.ib_id, 0, indices, indexBytes);
+        }
+    }
+
+    return o;
 }
@@ -39,6 +39,11 @@ void GameLayer::OnAttach(
     if (_scene != nullptr)
     {
         _scene->Initialize(_assetsManager);
+
+        // Resize events only come in when the size changes, the scene needs the initial size too
+        int width, height;
+        SDL_GL_GetDrawableSize(window, &width, &height);
+        _scene->OnResizeEvent(width, height);
     }
 
     _isAttached = true;
@@ -63,9 +68,11 @@ bool GameLayer::OnEvent(
 void GameLayer::OnUpdate(
     uint32_t time)
 {
+    _assetsManager.ProcessUploads();
+
     if (_scene != nullptr)
     {
-        _scene->OnUpdate(time);
+        _scene->OnUpdate(_assetsManager, time);
     }
 }
 
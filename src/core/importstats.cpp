@@ -0,0 +1,173 @@
+#include <core/importstats.h>
+
+#include <cstdio>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+using namespace gamestart;
+
+// Same order as ImportStage
+static const char *ImportStageNames[] = {
+    "fileRead",
+    "parse",
+    "normalGeneration",
+    "bufferBuild",
+    "optimize",
+    "cacheWrite",
+    "textureDecode",
+    "upload",
+};
+
+static_assert(sizeof(ImportStageNames) / sizeof(ImportStageNames[0]) == static_cast<size_t>(ImportStage::Count), "every ImportStage needs a name");
+
+namespace // Local utility functions
+{
+    std::string JsonString(
+        const std::string &text)
+    {
+        std::string result = "\"";
+        for (auto c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                result += '\\';
+                result += c;
+            }
+            else if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+                result += escaped;
+            }
+            else
+            {
+                result += c;
+            }
+        }
+
+        return result + "\"";
+    }
+} // namespace
+
+const char *gamestart::ImportStageName(
+    ImportStage stage)
+{
+    return ImportStageNames[static_cast<size_t>(stage)];
+}
+
+ImportStageStats &ImportStats::Stage(
+    ImportStage stage)
+{
+    return stages[static_cast<size_t>(stage)];
+}
+
+const ImportStageStats &ImportStats::Stage(
+    ImportStage stage) const
+{
+    return stages[static_cast<size_t>(stage)];
+}
+
+void ImportStats::Record(
+    ImportStage stage,
+    std::chrono::steady_clock::time_point start,
+    uint64_t bytes)
+{
+    auto &stats = Stage(stage);
+    stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.bytes += bytes;
+}
+
+void ImportStats::Add(
+    const ImportStats &other)
+{
+    for (size_t i = 0; i < static_cast<size_t>(ImportStage::Count); i++)
+    {
+        stages[i].milliseconds += other.stages[i].milliseconds;
+        stages[i].bytes += other.stages[i].bytes;
+    }
+
+    importCount += other.importCount;
+    meshCacheCount += other.meshCacheCount;
+    streamedCount += other.streamedCount;
+    textureCount += other.textureCount;
+    vertexCount += other.vertexCount;
+    triangleCount += other.triangleCount;
+}
+
+double ImportStats::TotalMilliseconds() const
+{
+    double total = 0.0;
+    for (auto &stage : stages)
+    {
+        total += stage.milliseconds;
+    }
+
+    return total;
+}
+
+std::string ImportStats::ToJson() const
+{
+    char buffer[256];
+    std::snprintf(
+        buffer,
+        sizeof(buffer),
+        "{\"importCount\": %d, \"meshCacheCount\": %d, \"streamedCount\": %d, \"textureCount\": %d, \"vertexCount\": %llu, \"triangleCount\": %llu, \"milliseconds\": %.3f, \"stages\": {",
+        importCount,
+        meshCacheCount,
+        streamedCount,
+        textureCount,
+        static_cast<unsigned long long>(vertexCount),
+        static_cast<unsigned long long>(triangleCount),
+        TotalMilliseconds());
+
+    std::string result = buffer;
+    for (size_t i = 0; i < static_cast<size_t>(ImportStage::Count); i++)
+    {
+        std::snprintf(
+            buffer,
+            sizeof(buffer),
+            "%s\"%s\": {\"milliseconds\": %.3f, \"bytes\": %llu}",
+            i > 0 ? ", " : "",
+            ImportStageNames[i],
+            stages[i].milliseconds,
+            static_cast<unsigned long long>(stages[i].bytes));
+
+        result += buffer;
+    }
+
+    return result + "}}";
+}
+
+bool gamestart::WriteImportStats(
+    const std::string &path,
+    const ImportStats &total,
+    const std::map<std::string, ImportStats> &assets)
+{
+    std::ofstream stream(path, std::ios::trunc);
+    if (!stream)
+    {
+        spdlog::warn("unable to write import stats {}", path);
+
+        return false;
+    }
+
+    stream << "{\n  \"total\": " << total.ToJson() << ",\n  \"assets\": {";
+
+    bool first = true;
+    for (auto &asset : assets)
+    {
+        stream << (first ? "\n    " : ",\n    ") << JsonString(asset.first) << ": " << asset.second.ToJson();
+        first = false;
+    }
+
+    stream << (first ? "}\n}\n" : "\n  }\n}\n");
+
+    if (!stream)
+    {
+        spdlog::warn("unable to write import stats {}", path);
+
+        return false;
+    }
+
+    return true;
+}
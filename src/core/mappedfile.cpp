@@ -0,0 +1,183 @@
+#include <core/mappedfile.h>
+
+#include <filesystem>
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace gamestart;
+
+MappedFile::MappedFile() = default;
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(
+    const std::string &filename)
+{
+    Close();
+
+#ifdef _WIN32
+    auto file = CreateFileA(
+        filename.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+
+        return false;
+    }
+
+    auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        CloseHandle(file);
+
+        return false;
+    }
+
+    auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == nullptr)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+
+        return false;
+    }
+
+    _file = file;
+    _mapping = mapping;
+    _data = static_cast<const unsigned char *>(data);
+    _size = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+
+        return false;
+    }
+
+    auto data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        spdlog::error("failed to map {}", filename);
+
+        close(fd);
+
+        return false;
+    }
+
+    _fd = fd;
+    _data = static_cast<const unsigned char *>(data);
+    _size = static_cast<size_t>(st.st_size);
+#endif
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (_data == nullptr)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(_data);
+    CloseHandle(static_cast<HANDLE>(_mapping));
+    CloseHandle(static_cast<HANDLE>(_file));
+
+    _mapping = nullptr;
+    _file = nullptr;
+#else
+    munmap(const_cast<unsigned char *>(_data), _size);
+    close(_fd);
+
+    _fd = -1;
+#endif
+
+    _data = nullptr;
+    _size = 0;
+}
+
+bool MappedFile::IsOpen() const
+{
+    return _data != nullptr;
+}
+
+void MappedFile::AdviseSequential() const
+{
+    if (_data == nullptr)
+    {
+        return;
+    }
+
+#ifndef _WIN32
+    // Only a hint, the mapping works the same when it is ignored
+    madvise(const_cast<unsigned char *>(_data), _size, MADV_SEQUENTIAL);
+#endif
+}
+
+const unsigned char *MappedFile::Data() const
+{
+    return _data;
+}
+
+size_t MappedFile::Size() const
+{
+    return _size;
+}
+
+bool gamestart::GetFileStamp(
+    const std::string &filename,
+    uint64_t &size,
+    int64_t &time)
+{
+    std::error_code ec;
+
+    auto fileSize = std::filesystem::file_size(filename, ec);
+    if (ec)
+    {
+        return false;
+    }
+
+    auto writeTime = std::filesystem::last_write_time(filename, ec);
+    if (ec)
+    {
+        return false;
+    }
+
+    size = static_cast<uint64_t>(fileSize);
+    time = static_cast<int64_t>(writeTime.time_since_epoch().count());
+
+    return true;
+}
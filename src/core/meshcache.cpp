@@ -0,0 +1,558 @@
+#include <core/meshcache.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+using namespace gamestart;
+
+static const char MeshCacheMagic[4] = {'G', 'S', 'M', 'C'};
+
+static_assert(sizeof(MeshCacheHeader) == 88, "MeshCacheHeader must not contain padding");
+static_assert(sizeof(MeshCacheShape) == 120, "MeshCacheShape must not contain padding");
+static_assert(sizeof(MeshCacheMeshlet) == 40, "MeshCacheMeshlet must not contain padding");
+static_assert(sizeof(MeshCacheLod) == 16, "MeshCacheLod must not contain padding");
+static_assert(sizeof(MeshCacheMaterial) == 24, "MeshCacheMaterial must not contain padding");
+static_assert(sizeof(MeshCacheDependency) == 24, "MeshCacheDependency must not contain padding");
+
+namespace // Local utility functions
+{
+    uint64_t AlignUp(
+        uint64_t value,
+        uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    void WritePadding(
+        std::ofstream &stream,
+        uint64_t &offset,
+        uint64_t alignment)
+    {
+        static const char zeros[MeshCacheAlignment] = {};
+
+        auto aligned = AlignUp(offset, alignment);
+        stream.write(zeros, static_cast<std::streamsize>(aligned - offset));
+        offset = aligned;
+    }
+
+    // A missing file gets size and time 0, creating it later changes the stamp as well
+    void GetDependencyStamp(
+        const std::filesystem::path &path,
+        uint64_t &size,
+        int64_t &time)
+    {
+        if (!GetFileStamp(path.string(), size, time))
+        {
+            size = 0;
+            time = 0;
+        }
+    }
+} // namespace
+
+MeshCache::MeshCache() = default;
+
+MeshCache::~MeshCache() = default;
+
+std::string MeshCache::PathFor(
+    const std::string &sourcePath)
+{
+    return std::filesystem::path(sourcePath).replace_extension(".gsmesh").string();
+}
+
+bool MeshCache::Write(
+    const std::string &cachePath,
+    const std::string &sourcePath,
+    const MeshData &meshData,
+    VertexLayout vertexLayout)
+{
+    MeshCacheHeader header = {};
+    std::memcpy(header.magic, MeshCacheMagic, sizeof(header.magic));
+    header.version = MeshCacheVersion;
+    header.shapeCount = static_cast<uint32_t>(meshData.shapes.size());
+    header.materialCount = static_cast<uint32_t>(meshData.materials.size());
+    header.floatsPerVertex = FloatsPerVertex;
+    header.vertexLayout = static_cast<uint32_t>(vertexLayout);
+    header.vertexStride = static_cast<uint32_t>(VertexStrideFor(vertexLayout));
+    header.lodLevelCount = static_cast<uint32_t>(meshData.lodLevelCount);
+    header.dependencyCount = static_cast<uint32_t>(meshData.materialLibraries.size());
+
+    if (!GetFileStamp(sourcePath, header.sourceSize, header.sourceTime))
+    {
+        return false;
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        header.bbMin[k] = meshData.bbMin[k];
+        header.bbMax[k] = meshData.bbMax[k];
+    }
+
+    std::string strings;
+    std::vector<MeshCacheMaterial> materials;
+    materials.reserve(meshData.materials.size());
+
+    for (auto &material : meshData.materials)
+    {
+        MeshCacheMaterial record = {};
+        for (int k = 0; k < 3; k++)
+        {
+            record.diffuse[k] = material.diffuse[k];
+        }
+        record.diffuseTexnameOffset = static_cast<uint32_t>(strings.size());
+        record.diffuseTexnameSize = static_cast<uint32_t>(material.diffuseTexname.size());
+        strings += material.diffuseTexname;
+
+        materials.push_back(record);
+    }
+
+    auto sourceDirectory = std::filesystem::path(sourcePath).parent_path();
+
+    std::vector<MeshCacheDependency> dependencies;
+    dependencies.reserve(meshData.materialLibraries.size());
+
+    for (auto &library : meshData.materialLibraries)
+    {
+        MeshCacheDependency record = {};
+        GetDependencyStamp(library, record.size, record.time);
+
+        // Relative, so the cache stays valid when the assets move together
+        auto path = std::filesystem::path(library).lexically_relative(sourceDirectory);
+        if (path.empty())
+        {
+            path = library;
+        }
+
+        auto pathString = path.generic_string();
+        record.pathOffset = static_cast<uint32_t>(strings.size());
+        record.pathSize = static_cast<uint32_t>(pathString.size());
+        strings += pathString;
+
+        dependencies.push_back(record);
+    }
+
+    header.stringsOffset = sizeof(MeshCacheHeader) +
+                           sizeof(MeshCacheShape) * meshData.shapes.size() +
+                           sizeof(MeshCacheMaterial) * meshData.materials.size() +
+                           sizeof(MeshCacheDependency) * dependencies.size();
+    header.stringsSize = static_cast<uint32_t>(strings.size());
+
+    std::vector<MeshCacheShape> shapes;
+    shapes.reserve(meshData.shapes.size());
+
+    auto blobOffset = AlignUp(header.stringsOffset + header.stringsSize, MeshCacheAlignment);
+    for (auto &shape : meshData.shapes)
+    {
+        MeshCacheShape record = {};
+        record.materialId = shape.materialId;
+        record.vertexCount = static_cast<uint32_t>(shape.vertices.size() / FloatsPerVertex);
+        record.vertexOffset = blobOffset;
+        record.vertexSize = uint64_t(record.vertexCount) * header.vertexStride;
+        record.indexCount = static_cast<uint32_t>(shape.indices.size());
+        record.indexStride = static_cast<uint32_t>(IndexSizeFor(record.vertexCount));
+        record.lodIndexCount = static_cast<uint32_t>(shape.lodIndices.size());
+        record.indexSize = (uint64_t(record.indexCount) + record.lodIndexCount) * record.indexStride;
+        record.meshletCount = static_cast<uint32_t>(shape.meshlets.size());
+        record.lodCount = static_cast<uint32_t>(shape.lods.size());
+        for (int k = 0; k < 3; k++)
+        {
+            record.bbMin[k] = shape.bounds.bbMin[k];
+            record.bbMax[k] = shape.bounds.bbMax[k];
+            record.center[k] = shape.bounds.center[k];
+        }
+        record.radius = shape.bounds.radius;
+
+        blobOffset = AlignUp(blobOffset + record.vertexSize, MeshCacheAlignment);
+        record.indexOffset = blobOffset;
+        blobOffset = AlignUp(blobOffset + record.indexSize, MeshCacheAlignment);
+        record.meshletOffset = blobOffset;
+        blobOffset = AlignUp(blobOffset + sizeof(MeshCacheMeshlet) * uint64_t(record.meshletCount), MeshCacheAlignment);
+        record.lodOffset = blobOffset;
+        blobOffset = AlignUp(blobOffset + sizeof(MeshCacheLod) * uint64_t(record.lodCount), MeshCacheAlignment);
+
+        shapes.push_back(record);
+    }
+
+    // Write to a temporary file first, a half written cache must never be picked up by a later load
+    auto tempPath = cachePath + ".tmp";
+
+    {
+        std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+        if (!stream)
+        {
+            spdlog::warn("unable to write mesh cache {}", cachePath);
+
+            return false;
+        }
+
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        stream.write(reinterpret_cast<const char *>(shapes.data()), static_cast<std::streamsize>(sizeof(MeshCacheShape) * shapes.size()));
+        stream.write(reinterpret_cast<const char *>(materials.data()), static_cast<std::streamsize>(sizeof(MeshCacheMaterial) * materials.size()));
+        stream.write(reinterpret_cast<const char *>(dependencies.data()), static_cast<std::streamsize>(sizeof(MeshCacheDependency) * dependencies.size()));
+        stream.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+        std::vector<unsigned char> packed;
+
+        uint64_t offset = header.stringsOffset + header.stringsSize;
+        for (size_t s = 0; s < shapes.size(); s++)
+        {
+            WritePadding(stream, offset, MeshCacheAlignment);
+
+            auto &vertices = meshData.shapes[s].vertices;
+            PackVertices(vertexLayout, vertices.data(), shapes[s].vertexCount, meshData.bbMin, meshData.bbMax, packed);
+            stream.write(reinterpret_cast<const char *>(packed.data()), static_cast<std::streamsize>(shapes[s].vertexSize));
+            offset += shapes[s].vertexSize;
+
+            WritePadding(stream, offset, MeshCacheAlignment);
+
+            for (auto indices : {&meshData.shapes[s].indices, &meshData.shapes[s].lodIndices})
+            {
+                auto indexSize = static_cast<std::streamsize>(indices->size() * shapes[s].indexStride);
+                if (shapes[s].indexStride == sizeof(uint16_t))
+                {
+                    std::vector<uint16_t> halfs(indices->begin(), indices->end());
+                    stream.write(reinterpret_cast<const char *>(halfs.data()), indexSize);
+                }
+                else
+                {
+                    stream.write(reinterpret_cast<const char *>(indices->data()), indexSize);
+                }
+            }
+            offset += shapes[s].indexSize;
+
+            WritePadding(stream, offset, MeshCacheAlignment);
+
+            for (auto &meshlet : meshData.shapes[s].meshlets)
+            {
+                MeshCacheMeshlet record = {};
+                record.firstIndex = meshlet.firstIndex;
+                record.indexCount = meshlet.indexCount;
+                record.radius = meshlet.radius;
+                record.coneCutoff = meshlet.coneCutoff;
+                for (int k = 0; k < 3; k++)
+                {
+                    record.center[k] = meshlet.center[k];
+                    record.coneAxis[k] = meshlet.coneAxis[k];
+                }
+
+                stream.write(reinterpret_cast<const char *>(&record), sizeof(record));
+            }
+            offset += sizeof(MeshCacheMeshlet) * uint64_t(shapes[s].meshletCount);
+
+            WritePadding(stream, offset, MeshCacheAlignment);
+
+            for (auto &lod : meshData.shapes[s].lods)
+            {
+                MeshCacheLod record = {};
+                record.firstIndex = lod.firstIndex;
+                record.indexCount = lod.indexCount;
+                record.error = lod.error;
+
+                stream.write(reinterpret_cast<const char *>(&record), sizeof(record));
+            }
+            offset += sizeof(MeshCacheLod) * uint64_t(shapes[s].lodCount);
+        }
+
+        if (!stream)
+        {
+            spdlog::warn("unable to write mesh cache {}", cachePath);
+
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cachePath, ec);
+    if (ec)
+    {
+        spdlog::warn("unable to write mesh cache {}: {}", cachePath, ec.message());
+
+        std::filesystem::remove(tempPath, ec);
+
+        return false;
+    }
+
+    spdlog::info("written mesh cache {}", cachePath);
+
+    return true;
+}
+
+bool MeshCache::IsCurrent(
+    const std::string &cachePath,
+    const std::string &sourcePath)
+{
+    MeshCache cache;
+    if (!cache._file.Open(cachePath) || cache._file.Size() < sizeof(MeshCacheHeader))
+    {
+        return false;
+    }
+
+    cache._data = cache._file.Data();
+    cache._size = cache._file.Size();
+
+    auto layout = reinterpret_cast<const MeshCacheHeader *>(cache._data)->vertexLayout;
+
+    return IsValidVertexLayout(layout) && cache.Validate(sourcePath, static_cast<VertexLayout>(layout));
+}
+
+bool MeshCache::Open(
+    const std::string &cachePath,
+    const std::string &sourcePath,
+    VertexLayout vertexLayout)
+{
+    _header = nullptr;
+    _shapes = nullptr;
+    _materials = nullptr;
+    _strings = nullptr;
+
+    if (!_file.Open(cachePath))
+    {
+        return false;
+    }
+
+    _data = _file.Data();
+    _size = _file.Size();
+
+    if (!Validate(sourcePath, vertexLayout))
+    {
+        spdlog::info("mesh cache {} is out of date", cachePath);
+
+        _file.Close();
+        _data = nullptr;
+        _size = 0;
+
+        return false;
+    }
+
+    SetPointers();
+
+    return true;
+}
+
+bool MeshCache::Open(
+    const unsigned char *data,
+    size_t size,
+    VertexLayout vertexLayout)
+{
+    _header = nullptr;
+    _shapes = nullptr;
+    _materials = nullptr;
+    _strings = nullptr;
+
+    _file.Close();
+    _data = data;
+    _size = size;
+
+    if (!Validate(std::string(), vertexLayout))
+    {
+        _data = nullptr;
+        _size = 0;
+
+        return false;
+    }
+
+    SetPointers();
+
+    return true;
+}
+
+void MeshCache::SetPointers()
+{
+    _header = reinterpret_cast<const MeshCacheHeader *>(_data);
+    _shapes = reinterpret_cast<const MeshCacheShape *>(_data + sizeof(MeshCacheHeader));
+    _materials = reinterpret_cast<const MeshCacheMaterial *>(_shapes + _header->shapeCount);
+    _strings = reinterpret_cast<const char *>(_data + _header->stringsOffset);
+}
+
+bool MeshCache::Validate(
+    const std::string &sourcePath,
+    VertexLayout vertexLayout) const
+{
+    auto size = static_cast<uint64_t>(_size);
+    if (size < sizeof(MeshCacheHeader))
+    {
+        return false;
+    }
+
+    auto header = reinterpret_cast<const MeshCacheHeader *>(_data);
+    if (std::memcmp(header->magic, MeshCacheMagic, sizeof(header->magic)) != 0 ||
+        header->version != MeshCacheVersion ||
+        header->floatsPerVertex != FloatsPerVertex ||
+        header->vertexLayout != static_cast<uint32_t>(vertexLayout) ||
+        header->vertexStride != VertexStrideFor(static_cast<VertexLayout>(header->vertexLayout)))
+    {
+        return false;
+    }
+
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (!sourcePath.empty() &&
+        (!GetFileStamp(sourcePath, sourceSize, sourceTime) ||
+         sourceSize != header->sourceSize ||
+         sourceTime != header->sourceTime))
+    {
+        return false;
+    }
+
+    auto tablesEnd = sizeof(MeshCacheHeader) +
+                     sizeof(MeshCacheShape) * uint64_t(header->shapeCount) +
+                     sizeof(MeshCacheMaterial) * uint64_t(header->materialCount) +
+                     sizeof(MeshCacheDependency) * uint64_t(header->dependencyCount);
+    if (tablesEnd != header->stringsOffset || header->stringsOffset + header->stringsSize > size)
+    {
+        return false;
+    }
+
+    if (!sourcePath.empty())
+    {
+        auto sourceDirectory = std::filesystem::path(sourcePath).parent_path();
+        auto strings = reinterpret_cast<const char *>(_data + header->stringsOffset);
+        auto dependencies = reinterpret_cast<const MeshCacheDependency *>(_data + tablesEnd - sizeof(MeshCacheDependency) * uint64_t(header->dependencyCount));
+        for (uint32_t d = 0; d < header->dependencyCount; d++)
+        {
+            if (uint64_t(dependencies[d].pathOffset) + dependencies[d].pathSize > header->stringsSize)
+            {
+                return false;
+            }
+
+            auto path = sourceDirectory / std::string(strings + dependencies[d].pathOffset, dependencies[d].pathSize);
+
+            uint64_t dependencySize;
+            int64_t dependencyTime;
+            GetDependencyStamp(path, dependencySize, dependencyTime);
+            if (dependencySize != dependencies[d].size || dependencyTime != dependencies[d].time)
+            {
+                return false;
+            }
+        }
+    }
+
+    auto shapes = reinterpret_cast<const MeshCacheShape *>(_data + sizeof(MeshCacheHeader));
+    for (uint32_t s = 0; s < header->shapeCount; s++)
+    {
+        if (shapes[s].vertexOffset % MeshCacheAlignment != 0 ||
+            shapes[s].vertexOffset + shapes[s].vertexSize > size ||
+            shapes[s].vertexSize != uint64_t(shapes[s].vertexCount) * header->vertexStride ||
+            shapes[s].indexStride != IndexSizeFor(shapes[s].vertexCount) ||
+            shapes[s].indexOffset % MeshCacheAlignment != 0 ||
+            shapes[s].indexOffset + shapes[s].indexSize > size ||
+            shapes[s].indexSize != (uint64_t(shapes[s].indexCount) + shapes[s].lodIndexCount) * shapes[s].indexStride ||
+            shapes[s].meshletOffset % MeshCacheAlignment != 0 ||
+            shapes[s].meshletOffset + sizeof(MeshCacheMeshlet) * uint64_t(shapes[s].meshletCount) > size ||
+            shapes[s].lodOffset % MeshCacheAlignment != 0 ||
+            shapes[s].lodOffset + sizeof(MeshCacheLod) * uint64_t(shapes[s].lodCount) > size)
+        {
+            return false;
+        }
+
+        auto lods = reinterpret_cast<const MeshCacheLod *>(_data + shapes[s].lodOffset);
+        for (uint32_t l = 0; l < shapes[s].lodCount; l++)
+        {
+            if (lods[l].firstIndex < shapes[s].indexCount ||
+                uint64_t(lods[l].firstIndex) + lods[l].indexCount > uint64_t(shapes[s].indexCount) + shapes[s].lodIndexCount)
+            {
+                return false;
+            }
+        }
+
+        auto meshlets = reinterpret_cast<const MeshCacheMeshlet *>(_data + shapes[s].meshletOffset);
+        for (uint32_t m = 0; m < shapes[s].meshletCount; m++)
+        {
+            if (uint64_t(meshlets[m].firstIndex) + meshlets[m].indexCount > shapes[s].indexCount)
+            {
+                return false;
+            }
+        }
+    }
+
+    auto materials = reinterpret_cast<const MeshCacheMaterial *>(shapes + header->shapeCount);
+    for (uint32_t m = 0; m < header->materialCount; m++)
+    {
+        if (uint64_t(materials[m].diffuseTexnameOffset) + materials[m].diffuseTexnameSize > header->stringsSize)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void MeshCache::Close()
+{
+    _header = nullptr;
+    _shapes = nullptr;
+    _materials = nullptr;
+    _strings = nullptr;
+
+    _file.Close();
+    _data = nullptr;
+    _size = 0;
+}
+
+bool MeshCache::HasMeshlets() const
+{
+    for (uint32_t s = 0; s < _header->shapeCount; s++)
+    {
+        if (_shapes[s].indexCount > 0 && _shapes[s].meshletCount == 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const MeshCacheHeader &MeshCache::Header() const
+{
+    return *_header;
+}
+
+size_t MeshCache::Size() const
+{
+    return _size;
+}
+
+const MeshCacheShape &MeshCache::Shape(
+    size_t index) const
+{
+    return _shapes[index];
+}
+
+const void *MeshCache::ShapeVertices(
+    size_t index) const
+{
+    return _data + _shapes[index].vertexOffset;
+}
+
+const void *MeshCache::ShapeIndices(
+    size_t index) const
+{
+    return _data + _shapes[index].indexOffset;
+}
+
+const MeshCacheMeshlet *MeshCache::ShapeMeshlets(
+    size_t index) const
+{
+    return reinterpret_cast<const MeshCacheMeshlet *>(_data + _shapes[index].meshletOffset);
+}
+
+const MeshCacheLod *MeshCache::ShapeLods(
+    size_t index) const
+{
+    return reinterpret_cast<const MeshCacheLod *>(_data + _shapes[index].lodOffset);
+}
+
+const MeshCacheMaterial &MeshCache::Material(
+    size_t index) const
+{
+    return _materials[index];
+}
+
+std::string MeshCache::MaterialDiffuseTexname(
+    size_t index) const
+{
+    return std::string(
+        _strings + _materials[index].diffuseTexnameOffset,
+        _materials[index].diffuseTexnameSize);
+}
@@ -0,0 +1,1220 @@
+#include <core/meshoptimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <core/meshdata.h>
+#include <cstring>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHOPTIMIZER_SSE
+#endif
+
+using namespace gamestart;
+
+namespace // Local utility functions
+{
+    // Forsyth scoring, the cache simulated while ordering is larger than the one we
+    // measure against so vertices are not forgotten too early
+    const int ForsythCacheSize = 32;
+    const int ForsythMaxValence = 64;
+
+    struct ForsythScores
+    {
+        float cache[ForsythCacheSize];
+        float valence[ForsythMaxValence];
+
+        ForsythScores()
+        {
+            for (int i = 0; i < ForsythCacheSize; i++)
+            {
+                // The three vertices of the last triangle get a fixed score, they are
+                // used no matter which of the triangles sharing them comes next
+                cache[i] = i < 3
+                               ? 0.75f
+                               : std::pow(1.0f - float(i - 3) / float(ForsythCacheSize - 3), 1.5f);
+            }
+
+            valence[0] = 0.0f;
+            for (int i = 1; i < ForsythMaxValence; i++)
+            {
+                valence[i] = 2.0f / std::sqrt(float(i));
+            }
+        }
+    };
+
+    float VertexScore(
+        const ForsythScores &scores,
+        int cachePosition,
+        uint32_t remaining)
+    {
+        if (remaining == 0)
+        {
+            return -1.0f;
+        }
+
+        auto score = cachePosition >= 0 ? scores.cache[cachePosition] : 0.0f;
+
+        return score + (remaining < ForsythMaxValence ? scores.valence[remaining] : 2.0f / std::sqrt(float(remaining)));
+    }
+
+    // Misses of a FIFO cache, the timestamps are shared so a restart only has to move time ahead
+    uint32_t TriangleMisses(
+        const uint32_t *triangle,
+        std::vector<uint32_t> &timestamps,
+        uint32_t &time)
+    {
+        uint32_t misses = 0;
+
+        for (int k = 0; k < 3; k++)
+        {
+            if (time - timestamps[triangle[k]] > VertexCacheSize)
+            {
+                timestamps[triangle[k]] = time++;
+                misses++;
+            }
+        }
+
+        return misses;
+    }
+
+    void ResetCache(
+        uint32_t &time)
+    {
+        time += VertexCacheSize + 1;
+    }
+
+    // Bounding sphere around the center of the bounding box, and the normal cone of the triangles
+    void ComputeMeshletBounds(
+        const std::vector<uint32_t> &indices,
+        const std::vector<float> &vertices,
+        Meshlet &meshlet,
+        std::vector<glm::vec3> &normals)
+    {
+        const uint32_t *first = &indices[meshlet.firstIndex];
+        const uint32_t *last = first + meshlet.indexCount;
+
+        glm::vec3 bbMin(std::numeric_limits<float>::max());
+        glm::vec3 bbMax(-std::numeric_limits<float>::max());
+        for (auto index = first; index != last; ++index)
+        {
+            const float *p = &vertices[*index * FloatsPerVertex];
+
+            bbMin = glm::min(bbMin, glm::vec3(p[0], p[1], p[2]));
+            bbMax = glm::max(bbMax, glm::vec3(p[0], p[1], p[2]));
+        }
+
+        meshlet.center = (bbMin + bbMax) * 0.5f;
+        meshlet.radius = 0.0f;
+
+        glm::vec3 normalSum(0.0f);
+        normals.clear();
+
+        for (auto index = first; index != last; index += 3)
+        {
+            const float *p0 = &vertices[index[0] * FloatsPerVertex];
+            const float *p1 = &vertices[index[1] * FloatsPerVertex];
+            const float *p2 = &vertices[index[2] * FloatsPerVertex];
+
+            glm::vec3 v0(p0[0], p0[1], p0[2]), v1(p1[0], p1[1], p1[2]), v2(p2[0], p2[1], p2[2]);
+
+            meshlet.radius = std::max(meshlet.radius, glm::length(v0 - meshlet.center));
+            meshlet.radius = std::max(meshlet.radius, glm::length(v1 - meshlet.center));
+            meshlet.radius = std::max(meshlet.radius, glm::length(v2 - meshlet.center));
+
+            // Degenerate triangles face nowhere, they never limit the cone
+            auto normal = glm::cross(v1 - v0, v2 - v0);
+            auto length = glm::length(normal);
+            if (length > 0.0f)
+            {
+                normals.push_back(normal / length);
+                normalSum += normals.back();
+            }
+        }
+
+        meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = 1.0f;
+
+        auto sumLength = glm::length(normalSum);
+        if (sumLength <= 0.0f)
+        {
+            return;
+        }
+
+        meshlet.coneAxis = normalSum / sumLength;
+
+        auto minDot = 1.0f;
+        for (auto &normal : normals)
+        {
+            minDot = std::min(minDot, glm::dot(normal, meshlet.coneAxis));
+        }
+
+        // Wider than a half sphere, some triangle always faces the camera
+        if (minDot <= 0.0f)
+        {
+            return;
+        }
+
+        // Sine of the angle between the axis and the normal furthest from it
+        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+    }
+
+    using VertexKind = MeshOptimizerScratch::VertexKind;
+    using Quadric = MeshOptimizerScratch::Quadric;
+    using Collapse = MeshOptimizerScratch::Collapse;
+
+    glm::dvec3 Position(
+        const std::vector<float> &vertices,
+        uint32_t vertex)
+    {
+        const float *p = &vertices[vertex * FloatsPerVertex];
+
+        return glm::dvec3(p[0], p[1], p[2]);
+    }
+
+    uint64_t EdgeKey(
+        uint32_t from,
+        uint32_t to)
+    {
+        return (uint64_t(from) << 32) | to;
+    }
+
+    // Vertices with the same position share the lowest vertex number as their position id
+    void PositionIds(
+        const std::vector<float> &vertices,
+        std::vector<uint32_t> &table,
+        std::vector<uint32_t> &ids)
+    {
+        const size_t vertexCount = vertices.size() / FloatsPerVertex;
+
+        size_t tableSize = 1;
+        while (tableSize < vertexCount * 2)
+        {
+            tableSize <<= 1;
+        }
+
+        table.assign(tableSize, ~0u);
+        ids.resize(vertexCount);
+
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            const float *position = &vertices[v * FloatsPerVertex];
+
+            uint32_t bits[3];
+            std::memcpy(bits, position, sizeof(bits));
+
+            uint64_t hash = 14695981039346656037ull;
+            for (int k = 0; k < 3; k++)
+            {
+                hash = (hash ^ bits[k]) * 1099511628211ull;
+            }
+
+            auto slot = static_cast<size_t>(hash ^ (hash >> 32)) & (tableSize - 1);
+            while (table[slot] != ~0u &&
+                   std::memcmp(&vertices[table[slot] * FloatsPerVertex], position, sizeof(bits)) != 0)
+            {
+                slot = (slot + 1) & (tableSize - 1);
+            }
+
+            if (table[slot] == ~0u)
+            {
+                table[slot] = static_cast<uint32_t>(v);
+            }
+
+            ids[v] = table[slot];
+        }
+    }
+
+    // Edges are looked at by position, so an edge along a seam is not taken for a border. An edge
+    // used once is on a border, one used more than once in the same direction is not a manifold.
+    // Border edges go into borderNext and borderPrev, by position id, ~0u where there is none.
+    void ClassifyVertices(
+        const std::vector<uint32_t> &indices,
+        MeshOptimizerScratch &scratch)
+    {
+        const auto &positionIds = scratch.positionIds;
+        const size_t vertexCount = positionIds.size();
+
+        auto &edges = scratch.edges;
+        auto &kinds = scratch.kinds;
+        auto &borderNext = scratch.borderNext;
+        auto &borderPrev = scratch.borderPrev;
+
+        edges.resize(indices.size());
+        for (size_t i = 0; i < indices.size(); i += 3)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                edges[i + e] = EdgeKey(positionIds[indices[i + e]], positionIds[indices[i + (e + 1) % 3]]);
+            }
+        }
+
+        std::sort(edges.begin(), edges.end());
+
+        auto &positionUses = scratch.positionUses;
+        positionUses.assign(vertexCount, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            positionUses[positionIds[v]]++;
+        }
+
+        kinds.assign(vertexCount, VertexKind::Manifold);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            if (positionUses[positionIds[v]] > 1)
+            {
+                kinds[v] = VertexKind::Locked;
+            }
+        }
+
+        borderNext.assign(vertexCount, ~0u);
+        borderPrev.assign(vertexCount, ~0u);
+
+        for (auto edge = edges.begin(); edge != edges.end();)
+        {
+            auto last = std::upper_bound(edge, edges.end(), *edge);
+            auto uses = last - edge;
+
+            auto from = static_cast<uint32_t>(*edge >> 32);
+            auto to = static_cast<uint32_t>(*edge & 0xffffffffu);
+
+            auto opposite = std::equal_range(edges.begin(), edges.end(), EdgeKey(to, from));
+            auto oppositeUses = opposite.second - opposite.first;
+
+            edge = last;
+
+            if (uses > 1 || oppositeUses > 1)
+            {
+                kinds[from] = kinds[to] = VertexKind::Locked;
+
+                continue;
+            }
+
+            if (oppositeUses != 0)
+            {
+                continue;
+            }
+
+            // Only unique positions get here as Manifold, their position id is the vertex itself
+            for (auto v : {from, to})
+            {
+                if (kinds[v] == VertexKind::Manifold)
+                {
+                    kinds[v] = VertexKind::Border;
+                }
+            }
+
+            // Where borders meet there is no single direction to slide along
+            if (borderNext[from] != ~0u)
+            {
+                kinds[from] = VertexKind::Locked;
+            }
+
+            if (borderPrev[to] != ~0u)
+            {
+                kinds[to] = VertexKind::Locked;
+            }
+
+            borderNext[from] = to;
+            borderPrev[to] = from;
+        }
+    }
+
+    glm::dvec3 TriangleNormal(
+        const glm::dvec3 &p0,
+        const glm::dvec3 &p1,
+        const glm::dvec3 &p2)
+    {
+        return glm::cross(p1 - p0, p2 - p0);
+    }
+} // namespace
+
+void MeshOptimizerScratch::Quadric::AddPlane(
+    const glm::dvec3 &normal,
+    double distance,
+    double planeWeight)
+{
+    xx += planeWeight * normal.x * normal.x;
+    xy += planeWeight * normal.x * normal.y;
+    xz += planeWeight * normal.x * normal.z;
+    yy += planeWeight * normal.y * normal.y;
+    yz += planeWeight * normal.y * normal.z;
+    zz += planeWeight * normal.z * normal.z;
+    dx += planeWeight * normal.x * distance;
+    dy += planeWeight * normal.y * distance;
+    dz += planeWeight * normal.z * distance;
+    dd += planeWeight * distance * distance;
+    weight += planeWeight;
+}
+
+void MeshOptimizerScratch::Quadric::Add(
+    const Quadric &other)
+{
+    xx += other.xx;
+    xy += other.xy;
+    xz += other.xz;
+    yy += other.yy;
+    yz += other.yz;
+    zz += other.zz;
+    dx += other.dx;
+    dy += other.dy;
+    dz += other.dz;
+    dd += other.dd;
+    weight += other.weight;
+}
+
+double MeshOptimizerScratch::Quadric::Error(
+    const glm::dvec3 &p) const
+{
+    auto error = xx * p.x * p.x + yy * p.y * p.y + zz * p.z * p.z +
+                 2.0 * (xy * p.x * p.y + xz * p.x * p.z + yz * p.y * p.z) +
+                 2.0 * (dx * p.x + dy * p.y + dz * p.z) +
+                 dd;
+
+    return std::max(error, 0.0);
+}
+
+size_t MeshOptimizerScratch::Bytes() const
+{
+    return (timestamps.capacity() + remaining.capacity() + offsets.capacity() + adjacency.capacity() + fill.capacity() +
+            cache.capacity() + newCache.capacity() + reordered.capacity() + remap.capacity() + owners.capacity() +
+            positionIds.capacity() + positionTable.capacity() + positionUses.capacity() +
+            borderNext.capacity() + borderPrev.capacity() + lodLevel.capacity() + lodIndices.capacity()) *
+               sizeof(uint32_t) +
+           (vertexScores.capacity() + triangleScores.capacity() + clusterData.capacity() + sortKeys.capacity() + fetched.capacity()) * sizeof(float) +
+           (hardBoundaries.capacity() + clusters.capacity() + clusterOrder.capacity()) * sizeof(size_t) +
+           (emitted.capacity() + touched.capacity()) / 8 +
+           cachePositions.capacity() * sizeof(int) +
+           meshlets.capacity() * sizeof(Meshlet) +
+           triangleNormals.capacity() * sizeof(glm::vec3) +
+           edges.capacity() * sizeof(uint64_t) +
+           kinds.capacity() * sizeof(VertexKind) +
+           quadrics.capacity() * sizeof(Quadric) +
+           collapses.capacity() * sizeof(Collapse) +
+           lods.capacity() * sizeof(MeshLod);
+}
+
+VertexCacheStatistics gamestart::AnalyzeVertexCache(
+    const std::vector<uint32_t> &indices,
+    size_t vertexCount,
+    MeshOptimizerScratch &scratch)
+{
+    VertexCacheStatistics result = {0.0f, 0.0f};
+
+    if (indices.empty() || vertexCount == 0)
+    {
+        return result;
+    }
+
+    auto &timestamps = scratch.timestamps;
+    timestamps.assign(vertexCount, 0);
+    uint32_t time = VertexCacheSize + 1;
+    size_t misses = 0;
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        misses += TriangleMisses(&indices[i], timestamps, time);
+    }
+
+    result.acmr = float(misses) / float(indices.size() / 3);
+    result.atvr = float(misses) / float(vertexCount);
+
+    return result;
+}
+
+void gamestart::OptimizeVertexCache(
+    std::vector<uint32_t> &indices,
+    size_t vertexCount,
+    MeshOptimizerScratch &scratch)
+{
+    static const ForsythScores scores;
+
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Triangles per vertex, the live triangles of v are the first remaining[v] entries of its range
+    auto &remaining = scratch.remaining;
+    remaining.assign(vertexCount, 0);
+    for (auto index : indices)
+    {
+        remaining[index]++;
+    }
+
+    auto &offsets = scratch.offsets;
+    offsets.assign(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        offsets[v + 1] = offsets[v] + remaining[v];
+    }
+
+    auto &adjacency = scratch.adjacency;
+    adjacency.resize(indices.size());
+    {
+        auto &fill = scratch.fill;
+        fill.assign(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    auto &cachePositions = scratch.cachePositions;
+    cachePositions.assign(vertexCount, -1);
+
+    auto &vertexScores = scratch.vertexScores;
+    vertexScores.resize(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        vertexScores[v] = VertexScore(scores, -1, remaining[v]);
+    }
+
+    auto &triangleScores = scratch.triangleScores;
+    triangleScores.resize(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScores[t] = vertexScores[indices[t * 3 + 0]] +
+                            vertexScores[indices[t * 3 + 1]] +
+                            vertexScores[indices[t * 3 + 2]];
+    }
+
+    auto &emitted = scratch.emitted;
+    emitted.assign(triangleCount, false);
+
+    auto &result = scratch.reordered;
+    result.resize(indices.size());
+
+    auto &cache = scratch.cache;
+    auto &newCache = scratch.newCache;
+    cache.clear();
+    newCache.clear();
+    cache.reserve(ForsythCacheSize + 3);
+    newCache.reserve(ForsythCacheSize + 3);
+
+    size_t cursor = 0;
+    int64_t best = -1;
+
+    for (size_t output = 0; output < triangleCount; output++)
+    {
+        // Nothing left around the cache, continue with the first triangle not emitted yet
+        if (best < 0)
+        {
+            while (emitted[cursor])
+            {
+                cursor++;
+            }
+
+            best = static_cast<int64_t>(cursor);
+        }
+
+        auto triangle = &indices[static_cast<size_t>(best) * 3];
+
+        emitted[static_cast<size_t>(best)] = true;
+        std::copy(triangle, triangle + 3, &result[output * 3]);
+
+        newCache.clear();
+        for (int k = 0; k < 3; k++)
+        {
+            auto v = triangle[k];
+
+            auto begin = adjacency.begin() + offsets[v];
+            auto end = begin + remaining[v];
+            auto found = std::find(begin, end, static_cast<uint32_t>(best));
+            std::iter_swap(found, end - 1);
+            remaining[v]--;
+
+            if (std::find(newCache.begin(), newCache.end(), v) == newCache.end())
+            {
+                newCache.push_back(v);
+            }
+        }
+
+        for (auto v : cache)
+        {
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+            {
+                newCache.push_back(v);
+            }
+        }
+
+        // Vertices pushed out of the cache are updated as well, they lose their cache score
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            auto v = newCache[i];
+
+            cachePositions[v] = i < ForsythCacheSize ? static_cast<int>(i) : -1;
+            vertexScores[v] = VertexScore(scores, cachePositions[v], remaining[v]);
+        }
+
+        best = -1;
+        float bestScore = -1.0f;
+
+        for (auto v : newCache)
+        {
+            for (uint32_t a = 0; a < remaining[v]; a++)
+            {
+                auto t = adjacency[offsets[v] + a];
+
+                triangleScores[t] = vertexScores[indices[t * 3 + 0]] +
+                                    vertexScores[indices[t * 3 + 1]] +
+                                    vertexScores[indices[t * 3 + 2]];
+
+                if (triangleScores[t] > bestScore)
+                {
+                    best = t;
+                    bestScore = triangleScores[t];
+                }
+            }
+        }
+
+        cache.assign(newCache.begin(), newCache.begin() + std::min(newCache.size(), size_t(ForsythCacheSize)));
+    }
+
+    std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void gamestart::OptimizeOverdraw(
+    std::vector<uint32_t> &indices,
+    const std::vector<float> &vertices,
+    MeshOptimizerScratch &scratch,
+    float threshold)
+{
+    const size_t triangleCount = indices.size() / 3;
+    const size_t vertexCount = vertices.size() / FloatsPerVertex;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    auto &timestamps = scratch.timestamps;
+    timestamps.assign(vertexCount, 0);
+    uint32_t time = VertexCacheSize + 1;
+
+    // Hard boundaries are the triangles where the cache has to start over anyway. The first
+    // triangle always starts a cluster, even when it is degenerate and misses less than three.
+    auto &hardBoundaries = scratch.hardBoundaries;
+    hardBoundaries.assign(1, 0);
+    TriangleMisses(&indices[0], timestamps, time);
+    for (size_t t = 1; t < triangleCount; t++)
+    {
+        if (TriangleMisses(&indices[t * 3], timestamps, time) == 3)
+        {
+            hardBoundaries.push_back(t);
+        }
+    }
+    hardBoundaries.push_back(triangleCount);
+
+    // Within a hard cluster split as soon as the part so far is about as cache friendly as the whole
+    auto &clusters = scratch.clusters;
+    clusters.clear();
+    for (size_t h = 0; h + 1 < hardBoundaries.size(); h++)
+    {
+        auto start = hardBoundaries[h];
+        auto end = hardBoundaries[h + 1];
+
+        ResetCache(time);
+
+        size_t clusterMisses = 0;
+        for (size_t t = start; t < end; t++)
+        {
+            clusterMisses += TriangleMisses(&indices[t * 3], timestamps, time);
+        }
+
+        auto clusterThreshold = threshold * float(clusterMisses) / float(end - start);
+
+        ResetCache(time);
+
+        size_t softStart = start;
+        size_t softMisses = 0;
+
+        clusters.push_back(start);
+        for (size_t t = start; t < end; t++)
+        {
+            softMisses += TriangleMisses(&indices[t * 3], timestamps, time);
+
+            if (t + 1 < end && float(softMisses) / float(t + 1 - softStart) <= clusterThreshold)
+            {
+                clusters.push_back(t + 1);
+
+                ResetCache(time);
+
+                softStart = t + 1;
+                softMisses = 0;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    const size_t clusterCount = clusters.size() - 1;
+
+    // Area weighted centroid and normal per cluster
+    auto &clusterData = scratch.clusterData;
+    clusterData.assign(clusterCount * 6, 0.0f);
+    float meshCentroid[3] = {0.0f, 0.0f, 0.0f};
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        float *centroid = &clusterData[c * 6];
+        float *normal = &clusterData[c * 6 + 3];
+        float clusterArea = 0.0f;
+
+        for (size_t t = clusters[c]; t < clusters[c + 1]; t++)
+        {
+            const float *p0 = &vertices[indices[t * 3 + 0] * FloatsPerVertex];
+            const float *p1 = &vertices[indices[t * 3 + 1] * FloatsPerVertex];
+            const float *p2 = &vertices[indices[t * 3 + 2] * FloatsPerVertex];
+
+            float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            float n[3] = {
+                e1[1] * e2[2] - e1[2] * e2[1],
+                e1[2] * e2[0] - e1[0] * e2[2],
+                e1[0] * e2[1] - e1[1] * e2[0],
+            };
+
+            auto area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+            for (int k = 0; k < 3; k++)
+            {
+                centroid[k] += (p0[k] + p1[k] + p2[k]) / 3.0f * area;
+                normal[k] += n[k];
+            }
+
+            clusterArea += area;
+        }
+
+        for (int k = 0; k < 3; k++)
+        {
+            meshCentroid[k] += centroid[k];
+            centroid[k] = clusterArea > 0.0f ? centroid[k] / clusterArea : 0.0f;
+        }
+
+        meshArea += clusterArea;
+
+        auto length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        for (int k = 0; k < 3; k++)
+        {
+            normal[k] = length > 0.0f ? normal[k] / length : 0.0f;
+        }
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        meshCentroid[k] = meshArea > 0.0f ? meshCentroid[k] / meshArea : 0.0f;
+    }
+
+    // Clusters on the outside facing away from the center occlude the rest, draw them first
+    auto &sortKeys = scratch.sortKeys;
+    sortKeys.resize(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        const float *centroid = &clusterData[c * 6];
+        const float *normal = &clusterData[c * 6 + 3];
+
+        sortKeys[c] = (centroid[0] - meshCentroid[0]) * normal[0] +
+                      (centroid[1] - meshCentroid[1]) * normal[1] +
+                      (centroid[2] - meshCentroid[2]) * normal[2];
+    }
+
+    auto &order = scratch.clusterOrder;
+    order.resize(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+    {
+        order[c] = c;
+    }
+
+    // Ties keep their order, like a stable sort without its temporary buffer
+    std::sort(order.begin(), order.end(), [&sortKeys](size_t a, size_t b) {
+        return sortKeys[a] > sortKeys[b] || (sortKeys[a] == sortKeys[b] && a < b);
+    });
+
+    auto &result = scratch.reordered;
+    result.clear();
+    result.reserve(indices.size());
+
+    for (auto c : order)
+    {
+        result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+
+    std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void gamestart::OptimizeVertexFetch(
+    std::vector<float> &vertices,
+    std::vector<uint32_t> &indices,
+    MeshOptimizerScratch &scratch)
+{
+    const size_t vertexCount = vertices.size() / FloatsPerVertex;
+
+    auto &remap = scratch.remap;
+    remap.assign(vertexCount, ~0u);
+
+    auto &result = scratch.fetched;
+    result.clear();
+    result.reserve(vertices.size());
+
+    for (auto &index : indices)
+    {
+        if (remap[index] == ~0u)
+        {
+            remap[index] = static_cast<uint32_t>(result.size() / FloatsPerVertex);
+            result.insert(result.end(), &vertices[index * FloatsPerVertex], &vertices[index * FloatsPerVertex] + FloatsPerVertex);
+        }
+
+        index = remap[index];
+    }
+
+    // Unused vertices are dropped, so this only ever shrinks the vertices
+    vertices.assign(result.begin(), result.end());
+}
+
+void gamestart::BuildMeshlets(
+    const std::vector<uint32_t> &indices,
+    const std::vector<float> &vertices,
+    std::vector<Meshlet> &meshlets,
+    MeshOptimizerScratch &scratch)
+{
+    meshlets.clear();
+
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // Collected in the scratch, so the result is allocated once at its exact size
+    auto &built = scratch.meshlets;
+    built.clear();
+
+    // The meshlet that last used the vertex, so each vertex is counted once per meshlet
+    auto &owners = scratch.owners;
+    owners.assign(vertices.size() / FloatsPerVertex, ~0u);
+
+    Meshlet meshlet = {};
+    size_t vertexCount = 0;
+
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const uint32_t *triangle = &indices[t * 3];
+        auto owner = static_cast<uint32_t>(built.size());
+
+        size_t newVertices = (owners[triangle[0]] != owner) +
+                             (triangle[1] != triangle[0] && owners[triangle[1]] != owner) +
+                             (triangle[2] != triangle[0] && triangle[2] != triangle[1] && owners[triangle[2]] != owner);
+
+        if (meshlet.indexCount > 0 &&
+            (vertexCount + newVertices > MaxMeshletVertices || meshlet.indexCount / 3 >= MaxMeshletTriangles))
+        {
+            ComputeMeshletBounds(indices, vertices, meshlet, scratch.triangleNormals);
+            built.push_back(meshlet);
+
+            meshlet = {};
+            meshlet.firstIndex = static_cast<uint32_t>(t * 3);
+            vertexCount = 0;
+
+            owner = static_cast<uint32_t>(built.size());
+            newVertices = 1 + (triangle[1] != triangle[0]) + (triangle[2] != triangle[0] && triangle[2] != triangle[1]);
+        }
+
+        owners[triangle[0]] = owners[triangle[1]] = owners[triangle[2]] = owner;
+
+        vertexCount += newVertices;
+        meshlet.indexCount += 3;
+    }
+
+    ComputeMeshletBounds(indices, vertices, meshlet, scratch.triangleNormals);
+    built.push_back(meshlet);
+
+    meshlets.assign(built.begin(), built.end());
+}
+
+float gamestart::SimplifyMesh(
+    const std::vector<uint32_t> &indices,
+    const std::vector<float> &vertices,
+    size_t targetIndexCount,
+    std::vector<uint32_t> &result,
+    MeshOptimizerScratch &scratch)
+{
+    // Border planes weigh more than the surface, so borders keep their shape
+    const double BorderWeight = 10.0;
+
+    // Cosine of the largest angle a triangle may turn by in a single collapse
+    const double MaxTriangleTurn = 0.2;
+
+    // A pass has to remove at least one in this many triangles to try another one
+    const size_t MinPassProgress = 100;
+
+    const size_t vertexCount = vertices.size() / FloatsPerVertex;
+
+    result = indices;
+
+    if (indices.size() <= targetIndexCount)
+    {
+        return 0.0f;
+    }
+
+    PositionIds(vertices, scratch.positionTable, scratch.positionIds);
+    ClassifyVertices(indices, scratch);
+
+    const auto &positionIds = scratch.positionIds;
+    const auto &kinds = scratch.kinds;
+    const auto &borderNext = scratch.borderNext;
+    const auto &borderPrev = scratch.borderPrev;
+
+    // Plane of every triangle weighted by its area, and a plane through every border edge
+    // standing up straight from its triangle
+    auto &quadrics = scratch.quadrics;
+    quadrics.assign(vertexCount, Quadric{});
+    for (size_t i = 0; i < indices.size(); i += 3)
+    {
+        glm::dvec3 p[3] = {Position(vertices, indices[i]), Position(vertices, indices[i + 1]), Position(vertices, indices[i + 2])};
+
+        auto normal = TriangleNormal(p[0], p[1], p[2]);
+        auto length = glm::length(normal);
+        if (length <= 0.0)
+        {
+            continue;
+        }
+
+        normal /= length;
+
+        for (int k = 0; k < 3; k++)
+        {
+            quadrics[indices[i + k]].AddPlane(normal, -glm::dot(normal, p[0]), length * 0.5);
+        }
+
+        for (int e = 0; e < 3; e++)
+        {
+            auto from = positionIds[indices[i + e]];
+            auto to = positionIds[indices[i + (e + 1) % 3]];
+            if (borderNext[from] != to && borderPrev[to] != from)
+            {
+                continue;
+            }
+
+            auto edge = p[(e + 1) % 3] - p[e];
+            auto edgeLength = glm::length(edge);
+            if (edgeLength <= 0.0)
+            {
+                continue;
+            }
+
+            auto borderNormal = glm::normalize(glm::cross(edge, normal));
+            auto distance = -glm::dot(borderNormal, p[e]);
+
+            quadrics[indices[i + e]].AddPlane(borderNormal, distance, edgeLength * edgeLength * BorderWeight);
+            quadrics[indices[i + (e + 1) % 3]].AddPlane(borderNormal, distance, edgeLength * edgeLength * BorderWeight);
+        }
+    }
+
+    double maxError = 0.0;
+
+    auto &collapses = scratch.collapses;
+    auto &remap = scratch.remap;
+    auto &touched = scratch.touched;
+    auto &offsets = scratch.offsets;
+    auto &adjacency = scratch.adjacency;
+
+    remap.resize(vertexCount);
+    touched.resize(vertexCount);
+    offsets.resize(vertexCount + 1);
+
+    while (result.size() > targetIndexCount)
+    {
+        // Triangles per vertex
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (auto index : result)
+        {
+            offsets[index + 1]++;
+        }
+
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            offsets[v + 1] += offsets[v];
+        }
+
+        adjacency.resize(result.size());
+        {
+            auto &fill = scratch.fill;
+            fill.assign(offsets.begin(), offsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++)
+            {
+                adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+            }
+        }
+
+        // The cheapest edge every vertex may collapse along, the vertex it collapses into stays in place
+        collapses.assign(vertexCount, Collapse{0, ~0u, std::numeric_limits<double>::max()});
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (int e = 0; e < 3; e++)
+            {
+                for (int direction = 0; direction < 2; direction++)
+                {
+                    auto from = result[i + (direction == 0 ? e : (e + 1) % 3)];
+                    auto to = result[i + (direction == 0 ? (e + 1) % 3 : e)];
+
+                    if (kinds[from] == VertexKind::Locked ||
+                        (kinds[from] == VertexKind::Border && borderNext[from] != positionIds[to] && borderPrev[from] != positionIds[to]))
+                    {
+                        continue;
+                    }
+
+                    Quadric quadric = quadrics[from];
+                    quadric.Add(quadrics[to]);
+
+                    auto error = quadric.Error(Position(vertices, to)) / std::max(quadric.weight, 1e-12);
+                    if (error < collapses[from].error)
+                    {
+                        collapses[from] = {from, to, error};
+                    }
+                }
+            }
+        }
+
+        collapses.erase(std::remove_if(collapses.begin(), collapses.end(), [](const Collapse &collapse) {
+                            return collapse.to == ~0u;
+                        }),
+                        collapses.end());
+
+        if (collapses.empty())
+        {
+            break;
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse &a, const Collapse &b) {
+            return a.error < b.error;
+        });
+
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            remap[v] = static_cast<uint32_t>(v);
+        }
+
+        std::fill(touched.begin(), touched.end(), false);
+
+        auto triangleCount = result.size() / 3;
+        auto targetTriangleCount = targetIndexCount / 3;
+        size_t collapseCount = 0;
+
+        for (auto &collapse : collapses)
+        {
+            if (triangleCount <= targetTriangleCount)
+            {
+                break;
+            }
+
+            if (touched[collapse.from] || touched[collapse.to])
+            {
+                continue;
+            }
+
+            // Triangles around the vertex must not turn over when it moves
+            auto to = Position(vertices, collapse.to);
+            bool flips = false;
+            size_t removed = 0;
+
+            for (auto t = offsets[collapse.from]; t < offsets[collapse.from + 1] && !flips; t++)
+            {
+                const uint32_t *triangle = &result[adjacency[t] * 3];
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+                {
+                    removed++;
+
+                    continue;
+                }
+
+                glm::dvec3 before[3], after[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    before[k] = Position(vertices, triangle[k]);
+                    after[k] = triangle[k] == collapse.from ? to : before[k];
+                }
+
+                auto normalBefore = TriangleNormal(before[0], before[1], before[2]);
+                auto normalAfter = TriangleNormal(after[0], after[1], after[2]);
+
+                // Turning close to a right angle leaves a sliver standing on its edge
+                flips = glm::dot(normalBefore, normalAfter) <= MaxTriangleTurn * glm::length(normalBefore) * glm::length(normalAfter);
+            }
+
+            if (flips)
+            {
+                continue;
+            }
+
+            // The ring around the vertex changes, nothing in it moves again this pass
+            for (auto t = offsets[collapse.from]; t < offsets[collapse.from + 1]; t++)
+            {
+                const uint32_t *triangle = &result[adjacency[t] * 3];
+
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to].Add(quadrics[collapse.from]);
+            maxError = std::max(maxError, collapse.error);
+
+            triangleCount -= std::min(triangleCount, removed);
+            collapseCount++;
+        }
+
+        if (collapseCount == 0)
+        {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            auto a = remap[result[i + 0]];
+            auto b = remap[result[i + 1]];
+            auto c = remap[result[i + 2]];
+
+            if (a != b && b != c && a != c)
+            {
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+        }
+
+        // Tangled or non-manifold meshes can go on for a long time losing a few triangles a pass
+        auto removed = result.size() - write;
+        result.resize(write);
+
+        if (removed * MinPassProgress < write)
+        {
+            break;
+        }
+    }
+
+    return static_cast<float>(std::sqrt(maxError));
+}
+
+void gamestart::BuildLodChain(
+    const std::vector<uint32_t> &indices,
+    const std::vector<float> &vertices,
+    int levelCount,
+    std::vector<uint32_t> &lodIndices,
+    std::vector<MeshLod> &lods,
+    MeshOptimizerScratch &scratch)
+{
+    // Shapes this small are cheap enough as they are
+    const size_t MinTriangles = 64;
+
+    // A level has to lose at least a fifth of the triangles of the one before to be worth it
+    const float MaxKeptTriangles = 0.8f;
+
+    const size_t vertexCount = vertices.size() / FloatsPerVertex;
+
+    auto previousCount = indices.size();
+    auto &level = scratch.lodLevel;
+
+    // The levels are collected in the scratch, so the results grow once
+    auto &levelIndices = scratch.lodIndices;
+    auto &levels = scratch.lods;
+    levelIndices.clear();
+    levels.clear();
+
+    for (int l = 0; l < levelCount && previousCount / 3 >= MinTriangles; l++)
+    {
+        auto targetIndexCount = (indices.size() >> (l + 1)) / 3 * 3;
+        auto error = SimplifyMesh(indices, vertices, targetIndexCount, level, scratch);
+
+        if (float(level.size()) > MaxKeptTriangles * float(previousCount))
+        {
+            break;
+        }
+
+        OptimizeVertexCache(level, vertexCount, scratch);
+
+        levels.push_back({static_cast<uint32_t>(indices.size() + lodIndices.size() + levelIndices.size()), static_cast<uint32_t>(level.size()), error});
+        levelIndices.insert(levelIndices.end(), level.begin(), level.end());
+
+        previousCount = level.size();
+    }
+
+    lodIndices.insert(lodIndices.end(), levelIndices.begin(), levelIndices.end());
+    lods.insert(lods.end(), levels.begin(), levels.end());
+}
+
+MeshBounds gamestart::ComputeBounds(
+    const std::vector<float> &vertices)
+{
+    const size_t vertexCount = vertices.size() / FloatsPerVertex;
+
+    MeshBounds bounds;
+    bounds.bbMin = glm::vec3(std::numeric_limits<float>::max());
+    bounds.bbMax = glm::vec3(-std::numeric_limits<float>::max());
+    bounds.center = glm::vec3(0.0f);
+    bounds.radius = 0.0f;
+
+    if (vertexCount == 0)
+    {
+        return bounds;
+    }
+
+    const float *v = vertices.data();
+
+#ifdef MESHOPTIMIZER_SSE
+    // The position and the first normal component fill a register, the fourth lane is ignored
+    __m128 bbMin = _mm_loadu_ps(v);
+    __m128 bbMax = bbMin;
+    for (size_t i = 1; i < vertexCount; i++)
+    {
+        auto p = _mm_loadu_ps(v + i * FloatsPerVertex);
+        bbMin = _mm_min_ps(bbMin, p);
+        bbMax = _mm_max_ps(bbMax, p);
+    }
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, bbMin);
+    bounds.bbMin = glm::vec3(lanes[0], lanes[1], lanes[2]);
+    _mm_storeu_ps(lanes, bbMax);
+    bounds.bbMax = glm::vec3(lanes[0], lanes[1], lanes[2]);
+
+    bounds.center = (bounds.bbMin + bounds.bbMax) * 0.5f;
+
+    const __m128 center = _mm_setr_ps(bounds.center.x, bounds.center.y, bounds.center.z, 0.0f);
+    const __m128 positionMask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+    __m128 maxDistance = _mm_setzero_ps();
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        auto d = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(v + i * FloatsPerVertex), center), positionMask);
+        d = _mm_mul_ps(d, d);
+
+        // Horizontal sum, every lane ends up with x * x + y * y + z * z
+        d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+        d = _mm_add_ps(d, _mm_shuffle_ps(d, d, _MM_SHUFFLE(1, 0, 3, 2)));
+        maxDistance = _mm_max_ps(maxDistance, d);
+    }
+
+    bounds.radius = std::sqrt(_mm_cvtss_f32(maxDistance));
+#else
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        auto p = glm::vec3(v[i * FloatsPerVertex + 0], v[i * FloatsPerVertex + 1], v[i * FloatsPerVertex + 2]);
+        bounds.bbMin = glm::min(bounds.bbMin, p);
+        bounds.bbMax = glm::max(bounds.bbMax, p);
+    }
+
+    bounds.center = (bounds.bbMin + bounds.bbMax) * 0.5f;
+
+    float maxDistance = 0.0f;
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        auto d = glm::vec3(v[i * FloatsPerVertex + 0], v[i * FloatsPerVertex + 1], v[i * FloatsPerVertex + 2]) - bounds.center;
+        maxDistance = std::max(maxDistance, glm::dot(d, d));
+    }
+
+    bounds.radius = std::sqrt(maxDistance);
+#endif
+
+    return bounds;
+}
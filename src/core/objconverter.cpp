@@ -0,0 +1,410 @@
+#include <core/objconverter.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <spdlog/spdlog.h>
+
+using namespace gamestart;
+
+namespace // Local utility functions
+{
+    // Collapses the triangle soup in scratch.soup into unique vertices and an index list,
+    // vertices are only merged when all of their floats are bit-for-bit identical. The unique
+    // vertices are collected in the scratch first, so vertices is allocated once at its exact size.
+    void WeldVertices(
+        ImportScratch &scratch,
+        std::vector<float> &vertices,
+        std::vector<uint32_t> &indices)
+    {
+        const size_t vertexBytes = sizeof(MeshVertex);
+        const size_t soupCount = scratch.soup.size();
+
+        size_t tableSize = 1;
+        while (tableSize < soupCount * 2)
+        {
+            tableSize <<= 1;
+        }
+
+        // Open addressing, every slot holds an index into welded or ~0u when empty
+        auto &table = scratch.weldTable;
+        table.assign(tableSize, ~0u);
+
+        auto &welded = scratch.welded;
+        welded.clear();
+        welded.reserve(soupCount);
+
+        indices.resize(soupCount);
+
+        for (size_t i = 0; i < soupCount; i++)
+        {
+            const MeshVertex &vertex = scratch.soup[i];
+
+            uint32_t bits[FloatsPerVertex];
+            std::memcpy(bits, &vertex, vertexBytes);
+
+            // FNV-1a over the raw bits
+            uint64_t hash = 14695981039346656037ull;
+            for (int k = 0; k < FloatsPerVertex; k++)
+            {
+                hash = (hash ^ bits[k]) * 1099511628211ull;
+            }
+
+            auto slot = static_cast<size_t>(hash ^ (hash >> 32)) & (tableSize - 1);
+            while (table[slot] != ~0u &&
+                   std::memcmp(&welded[table[slot]], &vertex, vertexBytes) != 0)
+            {
+                slot = (slot + 1) & (tableSize - 1);
+            }
+
+            if (table[slot] == ~0u)
+            {
+                table[slot] = static_cast<uint32_t>(welded.size());
+                welded.push_back(vertex);
+            }
+
+            indices[i] = table[slot];
+        }
+
+        auto first = reinterpret_cast<const float *>(welded.data());
+        vertices.assign(first, first + welded.size() * FloatsPerVertex);
+    }
+} // namespace
+
+size_t ImportScratch::Bytes() const
+{
+    return (soup.capacity() + welded.capacity()) * sizeof(MeshVertex) +
+           smoothVertexNormals.capacity() * sizeof(float) +
+           weldTable.capacity() * sizeof(uint32_t) +
+           smoothing.Bytes() +
+           optimizer.Bytes();
+}
+
+void gamestart::ConvertFace(
+    const tinyobj::attrib_t &attrib,
+    const tinyobj::shape_t &shape,
+    const std::vector<tinyobj::material_t> &materials,
+    const float *smoothVertexNormals,
+    size_t f,
+    MeshVertex *out)
+{
+    tinyobj::index_t idx0 = shape.mesh.indices[3 * f + 0];
+    tinyobj::index_t idx1 = shape.mesh.indices[3 * f + 1];
+    tinyobj::index_t idx2 = shape.mesh.indices[3 * f + 2];
+
+    int current_material_id = shape.mesh.material_ids[f];
+
+    if ((current_material_id < 0) || (current_material_id >= static_cast<int>(materials.size())))
+    {
+        // Invaid material ID. Use default material.
+        // Default material is added to the last item in `materials`.
+        current_material_id = static_cast<int>(materials.size()) - 1;
+    }
+
+    float diffuse[3];
+    for (size_t i = 0; i < 3; i++)
+    {
+        diffuse[i] = materials[current_material_id].diffuse[i];
+    }
+
+    float tc[3][2];
+
+    if (attrib.texcoords.size() > 0)
+    {
+        if ((idx0.texcoord_index < 0) || (idx1.texcoord_index < 0) || (idx2.texcoord_index < 0))
+        {
+            // face does not contain valid uv index.
+            tc[0][0] = 0.0f;
+            tc[0][1] = 0.0f;
+            tc[1][0] = 0.0f;
+            tc[1][1] = 0.0f;
+            tc[2][0] = 0.0f;
+            tc[2][1] = 0.0f;
+        }
+        else
+        {
+            assert(attrib.texcoords.size() > size_t(2 * idx0.texcoord_index + 1));
+            assert(attrib.texcoords.size() > size_t(2 * idx1.texcoord_index + 1));
+            assert(attrib.texcoords.size() > size_t(2 * idx2.texcoord_index + 1));
+
+            // Flip Y coord.
+            tc[0][0] = attrib.texcoords[2 * idx0.texcoord_index];
+            tc[0][1] = 1.0f - attrib.texcoords[2 * idx0.texcoord_index + 1];
+            tc[1][0] = attrib.texcoords[2 * idx1.texcoord_index];
+            tc[1][1] = 1.0f - attrib.texcoords[2 * idx1.texcoord_index + 1];
+            tc[2][0] = attrib.texcoords[2 * idx2.texcoord_index];
+            tc[2][1] = 1.0f - attrib.texcoords[2 * idx2.texcoord_index + 1];
+        }
+    }
+    else
+    {
+        tc[0][0] = 0.0f;
+        tc[0][1] = 0.0f;
+        tc[1][0] = 0.0f;
+        tc[1][1] = 0.0f;
+        tc[2][0] = 0.0f;
+        tc[2][1] = 0.0f;
+    }
+
+    float v[3][3];
+    for (int k = 0; k < 3; k++)
+    {
+        int f0 = idx0.vertex_index;
+        int f1 = idx1.vertex_index;
+        int f2 = idx2.vertex_index;
+        assert(f0 >= 0);
+        assert(f1 >= 0);
+        assert(f2 >= 0);
+
+        v[0][k] = attrib.vertices[3 * f0 + k];
+        v[1][k] = attrib.vertices[3 * f1 + k];
+        v[2][k] = attrib.vertices[3 * f2 + k];
+    }
+
+    float n[3][3];
+    {
+        bool invalid_normal_index = false;
+        if (attrib.normals.size() > 0)
+        {
+            int nf0 = idx0.normal_index;
+            int nf1 = idx1.normal_index;
+            int nf2 = idx2.normal_index;
+
+            if ((nf0 < 0) || (nf1 < 0) || (nf2 < 0))
+            {
+                // normal index is missing from this face.
+                invalid_normal_index = true;
+            }
+            else
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    assert(size_t(3 * nf0 + k) < attrib.normals.size());
+                    assert(size_t(3 * nf1 + k) < attrib.normals.size());
+                    assert(size_t(3 * nf2 + k) < attrib.normals.size());
+                    n[0][k] = attrib.normals[3 * nf0 + k];
+                    n[1][k] = attrib.normals[3 * nf1 + k];
+                    n[2][k] = attrib.normals[3 * nf2 + k];
+                }
+            }
+        }
+        else
+        {
+            invalid_normal_index = true;
+        }
+
+        if (invalid_normal_index && smoothVertexNormals != nullptr)
+        {
+            // Use smoothing normals
+            int f0 = idx0.vertex_index;
+            int f1 = idx1.vertex_index;
+            int f2 = idx2.vertex_index;
+
+            if (f0 >= 0 && f1 >= 0 && f2 >= 0)
+            {
+                n[0][0] = smoothVertexNormals[3 * f0 + 0];
+                n[0][1] = smoothVertexNormals[3 * f0 + 1];
+                n[0][2] = smoothVertexNormals[3 * f0 + 2];
+
+                n[1][0] = smoothVertexNormals[3 * f1 + 0];
+                n[1][1] = smoothVertexNormals[3 * f1 + 1];
+                n[1][2] = smoothVertexNormals[3 * f1 + 2];
+
+                n[2][0] = smoothVertexNormals[3 * f2 + 0];
+                n[2][1] = smoothVertexNormals[3 * f2 + 1];
+                n[2][2] = smoothVertexNormals[3 * f2 + 2];
+
+                invalid_normal_index = false;
+            }
+        }
+
+        if (invalid_normal_index)
+        {
+            // compute geometric normal
+            CalcNormal(n[0], v[0], v[1], v[2]);
+            n[1][0] = n[0][0];
+            n[1][1] = n[0][1];
+            n[1][2] = n[0][2];
+            n[2][0] = n[0][0];
+            n[2][1] = n[0][1];
+            n[2][2] = n[0][2];
+        }
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+        MeshVertex &vertex = out[k];
+
+        vertex.position[0] = v[k][0];
+        vertex.position[1] = v[k][1];
+        vertex.position[2] = v[k][2];
+        vertex.normal[0] = n[k][0];
+        vertex.normal[1] = n[k][1];
+        vertex.normal[2] = n[k][2];
+        // Combine normal and diffuse to get color.
+        float normal_factor = 0.2f;
+        float diffuse_factor = 1 - normal_factor;
+        float c[3] = {
+            n[k][0] * normal_factor + diffuse[0] * diffuse_factor,
+            n[k][1] * normal_factor + diffuse[1] * diffuse_factor,
+            n[k][2] * normal_factor + diffuse[2] * diffuse_factor,
+        };
+        float len2 = c[0] * c[0] + c[1] * c[1] + c[2] * c[2];
+        if (len2 > 0.0f)
+        {
+            float len = sqrtf(len2);
+
+            c[0] /= len;
+            c[1] /= len;
+            c[2] /= len;
+        }
+        vertex.color[0] = c[0] * 0.5f + 0.5f;
+        vertex.color[1] = c[1] * 0.5f + 0.5f;
+        vertex.color[2] = c[2] * 0.5f + 0.5f;
+
+        vertex.texcoord[0] = tc[k][0];
+        vertex.texcoord[1] = tc[k][1];
+    }
+}
+
+int gamestart::ShapeMaterialId(
+    const tinyobj::shape_t &shape,
+    size_t s,
+    size_t materialCount)
+{
+    if (shape.mesh.material_ids.size() > 0 && shape.mesh.material_ids.size() > s)
+    {
+        return shape.mesh.material_ids[0]; // use the material ID
+                                           // of the first face.
+    }
+
+    return static_cast<int>(materialCount) - 1; // = ID for default material.
+}
+
+void gamestart::ConvertMaterials(
+    const std::vector<tinyobj::material_t> &materials,
+    std::vector<MeshDataMaterial> &result)
+{
+    result.resize(materials.size());
+    for (size_t m = 0; m < materials.size(); m++)
+    {
+        result[m].diffuse = glm::vec3(materials[m].diffuse[0], materials[m].diffuse[1], materials[m].diffuse[2]);
+        result[m].diffuseTexname = materials[m].diffuse_texname;
+    }
+}
+
+void gamestart::ConvertObj(
+    MeshData &meshData,
+    const tinyobj::attrib_t &attrib,
+    const std::vector<tinyobj::shape_t> &shapes,
+    const std::vector<tinyobj::material_t> &materials,
+    ThreadPool &threadPool,
+    bool buildMeshlets,
+    int lodLevelCount,
+    ImportScratch &scratch,
+    ImportStats &stats)
+{
+    ConvertMaterials(materials, meshData.materials);
+
+    float bmin[3], bmax[3];
+    bmin[0] = bmin[1] = bmin[2] = std::numeric_limits<float>::max();
+    bmax[0] = bmax[1] = bmax[2] = -std::numeric_limits<float>::max();
+
+    meshData.shapes.resize(shapes.size());
+
+    {
+        for (size_t s = 0; s < shapes.size(); s++)
+        {
+            MeshDataShape &o = meshData.shapes[s];
+
+            // Check for smoothing group and compute smoothing normals
+            bool hasSmoothVertexNormals = false;
+            if (HasSmoothingGroup(shapes[s]))
+            {
+                spdlog::info("Compute smoothingNormal for shape [{}]", s);
+
+                auto start = std::chrono::steady_clock::now();
+
+                // Only the vertices of the current shape are valid
+                ComputeSmoothingNormals(attrib, shapes[s], threadPool, scratch.smoothVertexNormals, scratch.smoothing);
+
+                stats.Record(ImportStage::NormalGeneration, start, scratch.smoothVertexNormals.size() * sizeof(float));
+
+                hasSmoothVertexNormals = !shapes[s].mesh.indices.empty();
+            }
+
+            auto start = std::chrono::steady_clock::now();
+
+            auto faceCount = shapes[s].mesh.indices.size() / 3;
+
+            scratch.soup.resize(faceCount * 3);
+            for (size_t f = 0; f < faceCount; f++)
+            {
+                ConvertFace(
+                    attrib,
+                    shapes[s],
+                    materials,
+                    hasSmoothVertexNormals ? scratch.smoothVertexNormals.data() : nullptr,
+                    f,
+                    &scratch.soup[f * 3]);
+            }
+
+            o.materialId = ShapeMaterialId(shapes[s], s, materials.size());
+
+            spdlog::info("shape[{}] material_id {}", int(s), int(o.materialId));
+            spdlog::info("shape[{}] # of triangles = {}", static_cast<int>(s), static_cast<int>(faceCount));
+
+            WeldVertices(scratch, o.vertices, o.indices);
+
+            stats.Record(ImportStage::BufferBuild, start, o.vertices.size() * sizeof(float) + o.indices.size() * sizeof(uint32_t));
+
+            spdlog::info("shape[{}] # of vertices = {} (welded from {})", static_cast<int>(s), o.vertices.size() / FloatsPerVertex, faceCount * 3);
+
+            start = std::chrono::steady_clock::now();
+
+            auto before = AnalyzeVertexCache(o.indices, o.vertices.size() / FloatsPerVertex, scratch.optimizer);
+
+            OptimizeVertexCache(o.indices, o.vertices.size() / FloatsPerVertex, scratch.optimizer);
+            OptimizeOverdraw(o.indices, o.vertices, scratch.optimizer);
+            OptimizeVertexFetch(o.vertices, o.indices, scratch.optimizer);
+
+            auto after = AnalyzeVertexCache(o.indices, o.vertices.size() / FloatsPerVertex, scratch.optimizer);
+
+            spdlog::info("shape[{}] acmr {:.3f} -> {:.3f}, atvr {:.3f} -> {:.3f}", static_cast<int>(s), before.acmr, after.acmr, before.atvr, after.atvr);
+
+            if (buildMeshlets)
+            {
+                BuildMeshlets(o.indices, o.vertices, o.meshlets, scratch.optimizer);
+
+                spdlog::info("shape[{}] # of meshlets = {}", static_cast<int>(s), o.meshlets.size());
+            }
+
+            BuildLodChain(o.indices, o.vertices, lodLevelCount, o.lodIndices, o.lods, scratch.optimizer);
+
+            for (auto &lod : o.lods)
+            {
+                spdlog::info("shape[{}] lod # of triangles = {}, error {}", static_cast<int>(s), lod.indexCount / 3, lod.error);
+            }
+
+            o.bounds = ComputeBounds(o.vertices);
+
+            stats.Record(ImportStage::Optimize, start, (o.indices.size() + o.lodIndices.size()) * sizeof(uint32_t));
+
+            for (int k = 0; k < 3; k++)
+            {
+                bmin[k] = std::min(o.bounds.bbMin[k], bmin[k]);
+                bmax[k] = std::max(o.bounds.bbMax[k], bmax[k]);
+            }
+        }
+    }
+
+    spdlog::info("bmin = {}, {}, {}", bmin[0], bmin[1], bmin[2]);
+    spdlog::info("bmax = {}, {}, {}", bmax[0], bmax[1], bmax[2]);
+
+    meshData.bbMin = glm::vec3(bmin[0], bmin[1], bmin[2]);
+    meshData.bbMax = glm::vec3(bmax[0], bmax[1], bmax[2]);
+    meshData.lodLevelCount = lodLevelCount;
+}
@@ -0,0 +1,2014 @@
+#include <core/objparser.h>
+
+#include <core/mappedfile.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <spdlog/spdlog.h>
+#include <sstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GAMESTART_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__GNUC__)
+// Only where the compiler can build a single function for AVX2, the rest of the file stays SSE2
+#define GAMESTART_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+using namespace gamestart;
+
+// Files smaller than this are not worth splitting up
+static const size_t ParallelThreshold = 4 * 1024 * 1024;
+static const size_t MinimumChunkSize = 1024 * 1024;
+
+namespace // Local utility functions
+{
+    enum class ObjEventType
+    {
+        Faces,
+        Usemtl,
+        Mtllib,
+        Group,
+        Object,
+        Smoothing,
+    };
+
+    // Everything that influences shape building is recorded as an event so the merge can
+    // replay the chunks in file order. Text payloads point straight into the mapped file.
+    struct ObjEvent
+    {
+        ObjEventType type;
+        size_t line;        // line number within the chunk
+        size_t vertexCount; // number of 'v' records within the chunk before this event
+        size_t normalCount;
+        size_t texcoordCount;
+        size_t firstFace;
+        size_t faceCount;
+        size_t firstIndex;
+        size_t triangleCount; // of the faces with at least three vertices, before ear clipping
+        unsigned int smoothingId;
+        const char *text;
+        const char *textEnd;
+    };
+
+    struct ObjChunk
+    {
+        const char *begin;
+        const char *end;
+
+        // Counting pass
+        size_t lineCount = 0;
+        size_t vertexCount = 0;
+        size_t normalCount = 0;
+        size_t texcoordCount = 0;
+        bool unsupported = false;
+
+        // Parsing pass
+        size_t lineBase = 0;
+        size_t vertexBase = 0;
+        size_t normalBase = 0;
+        size_t texcoordBase = 0;
+        std::vector<ObjIndex> indices;
+        std::vector<unsigned int> faceSizes;
+        std::vector<ObjEvent> events;
+        int greatestV = -1;
+        int greatestVn = -1;
+        int greatestVt = -1;
+        bool failed = false;
+    };
+
+    struct PendingFaces
+    {
+        const ObjChunk *chunk;
+        size_t firstFace;
+        size_t faceCount;
+        size_t firstIndex;
+        unsigned int smoothingId;
+    };
+
+    inline bool IsSpace(
+        char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    inline bool IsDigit(
+        char c)
+    {
+        return static_cast<unsigned int>(c - '0') < 10u;
+    }
+
+    // Lines are never NUL terminated in the mapping, reading past the end yields '\0' like
+    // it does for the std::string lines tinyobj parses
+    inline char At(
+        const char *p,
+        const char *end,
+        size_t offset = 0)
+    {
+        return p + offset < end ? p[offset] : '\0';
+    }
+
+    inline int FirstSetBit(
+        unsigned int mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    // The line break scan runs over every byte of the file, it gets the widest vectors the CPU
+    // has. All variants return the first '\n', '\r' or '\0' in [p, end), or end.
+    const char *FindLineBreakScalar(
+        const char *p,
+        const char *end)
+    {
+        while (p < end && *p != '\n' && *p != '\r' && *p != '\0') p++;
+        return p;
+    }
+
+#if defined(GAMESTART_SSE2)
+    const char *FindLineBreakSse2(
+        const char *p,
+        const char *end)
+    {
+        const __m128i lf = _mm_set1_epi8('\n');
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i nul = _mm_setzero_si128();
+
+        for (; end - p >= 16; p += 16)
+        {
+            auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            auto hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chars, lf), _mm_cmpeq_epi8(chars, cr)), _mm_cmpeq_epi8(chars, nul));
+
+            auto mask = static_cast<unsigned int>(_mm_movemask_epi8(hits));
+            if (mask != 0)
+            {
+                return p + FirstSetBit(mask);
+            }
+        }
+
+        return FindLineBreakScalar(p, end);
+    }
+#endif
+
+#if defined(GAMESTART_AVX2)
+    __attribute__((target("avx2"))) const char *FindLineBreakAvx2(
+        const char *p,
+        const char *end)
+    {
+        const __m256i lf = _mm256_set1_epi8('\n');
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i nul = _mm256_setzero_si256();
+
+        for (; end - p >= 32; p += 32)
+        {
+            auto chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+            auto hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(chars, lf), _mm256_cmpeq_epi8(chars, cr)), _mm256_cmpeq_epi8(chars, nul));
+
+            auto mask = static_cast<unsigned int>(_mm256_movemask_epi8(hits));
+            if (mask != 0)
+            {
+                return p + FirstSetBit(mask);
+            }
+        }
+
+        return FindLineBreakSse2(p, end);
+    }
+#endif
+
+    typedef const char *(*FindLineBreakFunction)(const char *, const char *);
+
+    FindLineBreakFunction SelectFindLineBreak()
+    {
+#if defined(GAMESTART_AVX2)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return FindLineBreakAvx2;
+        }
+#endif
+
+#if defined(GAMESTART_SSE2)
+        return FindLineBreakSse2;
+#else
+        return FindLineBreakScalar;
+#endif
+    }
+
+    const FindLineBreakFunction FindLineBreak = SelectFindLineBreak();
+
+    inline const char *SkipSpaces(
+        const char *p,
+        const char *end)
+    {
+        while (p < end && IsSpace(*p)) p++;
+        return p;
+    }
+
+    // Fields are only a few bytes long, a dispatched call would cost more than the wider
+    // vectors win. SSE2 is always there on x64, so this is inlined.
+    inline const char *FindSpace(
+        const char *p,
+        const char *end)
+    {
+#if defined(GAMESTART_SSE2)
+        if (end - p >= 16)
+        {
+            auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            auto hits = _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chars, _mm_set1_epi8('\t')));
+
+            auto mask = static_cast<unsigned int>(_mm_movemask_epi8(hits));
+            if (mask != 0)
+            {
+                return p + FirstSetBit(mask);
+            }
+            p += 16;
+        }
+#endif
+        while (p < end && !IsSpace(*p)) p++;
+        return p;
+    }
+
+    inline const char *FindSpaceOrSlash(
+        const char *p,
+        const char *end)
+    {
+        while (p < end && !IsSpace(*p) && *p != '/') p++;
+        return p;
+    }
+
+    // atoi() on a bounded range, including its strtol() overflow behaviour
+    int ParseInt(
+        const char *p,
+        const char *end)
+    {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\v' || *p == '\f')) p++;
+
+        bool negative = false;
+        if (p < end && (*p == '+' || *p == '-'))
+        {
+            negative = (*p == '-');
+            p++;
+        }
+
+        const unsigned long long limit = negative
+                                             ? static_cast<unsigned long long>(LONG_MAX) + 1
+                                             : static_cast<unsigned long long>(LONG_MAX);
+        unsigned long long value = 0;
+        bool overflow = false;
+        while (p < end && IsDigit(*p))
+        {
+            if (!overflow)
+            {
+                value = value * 10 + static_cast<unsigned long long>(*p - '0');
+                overflow = value > limit;
+            }
+            p++;
+        }
+
+        long result;
+        if (overflow)
+        {
+            result = negative ? LONG_MIN : LONG_MAX;
+        }
+        else
+        {
+            result = negative ? static_cast<long>(0 - value) : static_cast<long>(value);
+        }
+
+        return static_cast<int>(result);
+    }
+
+    // The powers tinyobj's tryParseDouble() calls std::pow() for, looked up instead. They are
+    // filled with std::pow() itself, so the values are the same to the last bit.
+    const int PowerTableSize = 64;
+
+    struct PowerTables
+    {
+        double negativePowersOfTen[PowerTableSize];
+        double powersOfFive[2 * PowerTableSize + 1];
+
+        PowerTables()
+        {
+            static const double pow_lut[] = {
+                1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001,
+            };
+            const int lut_entries = sizeof pow_lut / sizeof pow_lut[0];
+
+            for (int i = 0; i < PowerTableSize; i++)
+            {
+                negativePowersOfTen[i] = i < lut_entries ? pow_lut[i] : std::pow(10.0, -i);
+            }
+
+            for (int i = -PowerTableSize; i <= PowerTableSize; i++)
+            {
+                powersOfFive[i + PowerTableSize] = std::pow(5.0, i);
+            }
+        }
+    };
+
+    const PowerTables Powers;
+
+    inline double NegativePowerOfTen(
+        int exponent)
+    {
+        return exponent < PowerTableSize ? Powers.negativePowersOfTen[exponent] : std::pow(10.0, -exponent);
+    }
+
+    inline double PowerOfFive(
+        int exponent)
+    {
+        return (exponent >= -PowerTableSize && exponent <= PowerTableSize) ? Powers.powersOfFive[exponent + PowerTableSize] : std::pow(5.0, exponent);
+    }
+
+    // Port of tinyobj's tryParseDouble(), it has to round exactly like the original
+    bool TryParseDouble(
+        const char *s,
+        const char *s_end,
+        double *result)
+    {
+        if (s >= s_end)
+        {
+            return false;
+        }
+
+        double mantissa = 0.0;
+        int exponent = 0;
+        char sign = '+';
+        char exp_sign = '+';
+        char const *curr = s;
+        int read = 0;
+        bool end_not_reached = false;
+        bool leading_decimal_dots = false;
+
+        if (*curr == '+' || *curr == '-')
+        {
+            sign = *curr;
+            curr++;
+            if ((curr != s_end) && (*curr == '.'))
+            {
+                leading_decimal_dots = true;
+            }
+        }
+        else if (IsDigit(*curr))
+        {
+        }
+        else if (*curr == '.')
+        {
+            leading_decimal_dots = true;
+        }
+        else
+        {
+            return false;
+        }
+
+        end_not_reached = (curr != s_end);
+        if (!leading_decimal_dots)
+        {
+            while (end_not_reached && IsDigit(*curr))
+            {
+                mantissa *= 10;
+                mantissa += static_cast<int>(*curr - 0x30);
+                curr++;
+                read++;
+                end_not_reached = (curr != s_end);
+            }
+
+            if (read == 0) return false;
+        }
+
+        if (!end_not_reached) goto assemble;
+
+        if (*curr == '.')
+        {
+            curr++;
+            read = 1;
+            end_not_reached = (curr != s_end);
+            while (end_not_reached && IsDigit(*curr))
+            {
+                mantissa += static_cast<int>(*curr - 0x30) * NegativePowerOfTen(read);
+                read++;
+                curr++;
+                end_not_reached = (curr != s_end);
+            }
+        }
+        else if (*curr == 'e' || *curr == 'E')
+        {
+        }
+        else
+        {
+            goto assemble;
+        }
+
+        if (!end_not_reached) goto assemble;
+
+        if (*curr == 'e' || *curr == 'E')
+        {
+            curr++;
+            end_not_reached = (curr != s_end);
+            if (end_not_reached && (*curr == '+' || *curr == '-'))
+            {
+                exp_sign = *curr;
+                curr++;
+            }
+            else if (end_not_reached && IsDigit(*curr))
+            {
+            }
+            else
+            {
+                return false;
+            }
+
+            read = 0;
+            end_not_reached = (curr != s_end);
+            while (end_not_reached && IsDigit(*curr))
+            {
+                exponent *= 10;
+                exponent += static_cast<int>(*curr - 0x30);
+                curr++;
+                read++;
+                end_not_reached = (curr != s_end);
+            }
+            exponent *= (exp_sign == '+' ? 1 : -1);
+            if (read == 0) return false;
+        }
+
+    assemble:
+        *result = (sign == '+' ? 1 : -1) *
+                  (exponent ? std::ldexp(mantissa * PowerOfFive(exponent), exponent)
+                            : mantissa);
+        return true;
+    }
+
+    tinyobj::real_t ParseReal(
+        const char *&token,
+        const char *end,
+        double defaultValue = 0.0)
+    {
+        token = SkipSpaces(token, end);
+        auto tokenEnd = FindSpace(token, end);
+        double value = defaultValue;
+        TryParseDouble(token, tokenEnd, &value);
+        token = tokenEnd;
+
+        return static_cast<tinyobj::real_t>(value);
+    }
+
+    bool ParseReal(
+        const char *&token,
+        const char *end,
+        tinyobj::real_t *out)
+    {
+        token = SkipSpaces(token, end);
+        auto tokenEnd = FindSpace(token, end);
+        double value;
+        bool result = TryParseDouble(token, tokenEnd, &value);
+        if (result)
+        {
+            *out = static_cast<tinyobj::real_t>(value);
+        }
+        token = tokenEnd;
+
+        return result;
+    }
+
+    inline bool FixIndex(
+        int idx,
+        size_t n,
+        int *ret)
+    {
+        if (idx > 0)
+        {
+            *ret = idx - 1;
+            return true;
+        }
+
+        if (idx == 0)
+        {
+            return false;
+        }
+
+        *ret = static_cast<int>(n) + idx;
+        return true;
+    }
+
+    bool ParseTriple(
+        const char *&token,
+        const char *end,
+        size_t vsize,
+        size_t vnsize,
+        size_t vtsize,
+        ObjIndex &ret)
+    {
+        ObjIndex vi = {-1, -1, -1};
+
+        if (!FixIndex(ParseInt(token, end), vsize, &vi.v_idx))
+        {
+            return false;
+        }
+
+        token = FindSpaceOrSlash(token, end);
+        if (At(token, end) != '/')
+        {
+            ret = vi;
+            return true;
+        }
+        token++;
+
+        // i//k
+        if (At(token, end) == '/')
+        {
+            token++;
+            if (!FixIndex(ParseInt(token, end), vnsize, &vi.vn_idx))
+            {
+                return false;
+            }
+            token = FindSpaceOrSlash(token, end);
+            ret = vi;
+            return true;
+        }
+
+        // i/j/k or i/j
+        if (!FixIndex(ParseInt(token, end), vtsize, &vi.vt_idx))
+        {
+            return false;
+        }
+
+        token = FindSpaceOrSlash(token, end);
+        if (At(token, end) != '/')
+        {
+            ret = vi;
+            return true;
+        }
+
+        // i/j/k
+        token++;
+        if (!FixIndex(ParseInt(token, end), vnsize, &vi.vn_idx))
+        {
+            return false;
+        }
+        token = FindSpaceOrSlash(token, end);
+
+        ret = vi;
+        return true;
+    }
+
+    // Finds the end of the line that starts at p and returns where the next one starts, with
+    // the same line breaking rules as tinyobj's safeGetline()
+    inline const char *NextLine(
+        const char *p,
+        const char *end,
+        const char *&lineEnd)
+    {
+        p = FindLineBreak(p, end);
+
+        lineEnd = p;
+        if (p < end && *p != '\0')
+        {
+            if (*p == '\r' && p + 1 < end && p[1] == '\n')
+            {
+                p += 2;
+            }
+            else
+            {
+                p++;
+            }
+        }
+
+        return p;
+    }
+
+    // Calls fn(lineBegin, lineEnd) for every line. Returns false when the text contains a NUL
+    // character.
+    template <typename TFunction>
+    bool ForEachLine(
+        const char *begin,
+        const char *end,
+        TFunction fn)
+    {
+        auto p = begin;
+        while (p < end)
+        {
+            auto lineBegin = p;
+            const char *lineEnd;
+            p = NextLine(p, end, lineEnd);
+
+            if (lineEnd < end && *lineEnd == '\0')
+            {
+                return false;
+            }
+
+            fn(lineBegin, lineEnd);
+        }
+
+        return true;
+    }
+
+    void CountChunk(
+        ObjChunk &chunk)
+    {
+        auto ok = ForEachLine(chunk.begin, chunk.end, [&chunk](const char *token, const char *end) {
+            chunk.lineCount++;
+
+            token = SkipSpaces(token, end);
+            if (token == end)
+            {
+                return;
+            }
+
+            auto c0 = token[0];
+            auto c1 = At(token, end, 1);
+
+            if (c0 == 'v')
+            {
+                if (IsSpace(c1))
+                {
+                    chunk.vertexCount++;
+                }
+                else if (c1 == 'n' && IsSpace(At(token, end, 2)))
+                {
+                    chunk.normalCount++;
+                }
+                else if (c1 == 't' && IsSpace(At(token, end, 2)))
+                {
+                    chunk.texcoordCount++;
+                }
+                else if (c1 == 'w' && IsSpace(At(token, end, 2)))
+                {
+                    chunk.unsupported = true;
+                }
+            }
+            else if ((c0 == 'l' || c0 == 'p' || c0 == 't') && IsSpace(c1))
+            {
+                chunk.unsupported = true;
+            }
+        });
+
+        if (!ok)
+        {
+            chunk.unsupported = true;
+        }
+    }
+
+    // Without keepFaces the vertex colors are skipped and the faces are only checked and
+    // counted. The face events span their lines in the file then, to read them back later.
+    void ParseChunk(
+        ObjChunk &chunk,
+        tinyobj::attrib_t &attrib,
+        bool keepFaces)
+    {
+        auto vertices = &attrib.vertices[3 * chunk.vertexBase];
+        auto colors = keepFaces ? &attrib.colors[3 * chunk.vertexBase] : nullptr;
+        auto normals = &attrib.normals[3 * chunk.normalBase];
+        auto texcoords = &attrib.texcoords[2 * chunk.texcoordBase];
+
+        size_t v = 0, vn = 0, vt = 0;
+        size_t line = 0;
+
+        auto addEvent = [&chunk, &v, &vn, &vt, &line](ObjEventType type, const char *text, const char *textEnd) -> ObjEvent & {
+            ObjEvent event = {};
+            event.type = type;
+            event.line = line;
+            event.vertexCount = v;
+            event.normalCount = vn;
+            event.texcoordCount = vt;
+            event.text = text;
+            event.textEnd = textEnd;
+            chunk.events.push_back(event);
+
+            return chunk.events.back();
+        };
+
+        ForEachLine(chunk.begin, chunk.end, [&](const char *token, const char *end) {
+            line++;
+
+            auto lineBegin = token;
+
+            if (chunk.failed)
+            {
+                return;
+            }
+
+            token = SkipSpaces(token, end);
+            if (token == end || token[0] == '#')
+            {
+                return;
+            }
+
+            auto c0 = token[0];
+            auto c1 = At(token, end, 1);
+
+            // vertex
+            if (c0 == 'v' && IsSpace(c1))
+            {
+                token += 2;
+
+                auto out = &vertices[3 * v];
+                out[0] = ParseReal(token, end);
+                out[1] = ParseReal(token, end);
+                out[2] = ParseReal(token, end);
+
+                if (colors != nullptr)
+                {
+                    tinyobj::real_t r, g, b;
+                    bool foundColor = ParseReal(token, end, &r) && ParseReal(token, end, &g) && ParseReal(token, end, &b);
+                    if (!foundColor)
+                    {
+                        r = g = b = 1.0;
+                    }
+
+                    auto color = &colors[3 * v];
+                    color[0] = r;
+                    color[1] = g;
+                    color[2] = b;
+                }
+
+                v++;
+                return;
+            }
+
+            // normal
+            if (c0 == 'v' && c1 == 'n' && IsSpace(At(token, end, 2)))
+            {
+                token += 3;
+
+                auto out = &normals[3 * vn];
+                out[0] = ParseReal(token, end);
+                out[1] = ParseReal(token, end);
+                out[2] = ParseReal(token, end);
+
+                vn++;
+                return;
+            }
+
+            // texcoord
+            if (c0 == 'v' && c1 == 't' && IsSpace(At(token, end, 2)))
+            {
+                token += 3;
+
+                auto out = &texcoords[2 * vt];
+                out[0] = ParseReal(token, end);
+                out[1] = ParseReal(token, end);
+
+                vt++;
+                return;
+            }
+
+            // face
+            if (c0 == 'f' && IsSpace(c1))
+            {
+                token += 2;
+                token = SkipSpaces(token, end);
+
+                if (chunk.events.empty() || chunk.events.back().type != ObjEventType::Faces)
+                {
+                    auto &event = addEvent(ObjEventType::Faces, lineBegin, end);
+                    event.firstFace = chunk.faceSizes.size();
+                    event.firstIndex = chunk.indices.size();
+                }
+
+                unsigned int faceSize = 0;
+                while (token < end)
+                {
+                    ObjIndex vi;
+                    if (!ParseTriple(token, end, chunk.vertexBase + v, chunk.normalBase + vn, chunk.texcoordBase + vt, vi))
+                    {
+                        chunk.failed = true;
+                        return;
+                    }
+
+                    chunk.greatestV = std::max(chunk.greatestV, vi.v_idx);
+                    chunk.greatestVn = std::max(chunk.greatestVn, vi.vn_idx);
+                    chunk.greatestVt = std::max(chunk.greatestVt, vi.vt_idx);
+
+                    if (keepFaces)
+                    {
+                        chunk.indices.push_back(vi);
+                    }
+                    faceSize++;
+
+                    token = SkipSpaces(token, end);
+                }
+
+                if (keepFaces)
+                {
+                    chunk.faceSizes.push_back(faceSize);
+                }
+
+                auto &event = chunk.events.back();
+                event.faceCount++;
+                event.triangleCount += faceSize >= 3 ? faceSize - 2 : 0;
+                event.textEnd = end;
+
+                return;
+            }
+
+            // use mtl
+            if (end - token >= 6 && std::equal(token, token + 6, "usemtl"))
+            {
+                addEvent(ObjEventType::Usemtl, token + 6, end);
+
+                return;
+            }
+
+            // load mtl
+            if (end - token >= 6 && std::equal(token, token + 6, "mtllib") && IsSpace(At(token, end, 6)))
+            {
+                addEvent(ObjEventType::Mtllib, token + 7, end);
+
+                return;
+            }
+
+            // group name
+            if (c0 == 'g' && IsSpace(c1))
+            {
+                addEvent(ObjEventType::Group, token, end);
+
+                return;
+            }
+
+            // object name
+            if (c0 == 'o' && IsSpace(c1))
+            {
+                addEvent(ObjEventType::Object, token + 2, end);
+
+                return;
+            }
+
+            // smoothing group id
+            if (c0 == 's' && IsSpace(c1))
+            {
+                token += 2;
+                token = SkipSpaces(token, end);
+
+                if (token == end)
+                {
+                    return;
+                }
+
+                unsigned int smoothingId;
+                if (end - token >= 3 && token[0] == 'o' && token[1] == 'f' && token[2] == 'f')
+                {
+                    smoothingId = 0;
+                }
+                else
+                {
+                    int id = ParseInt(token, end);
+                    smoothingId = id < 0 ? 0 : static_cast<unsigned int>(id);
+                }
+
+                addEvent(ObjEventType::Smoothing, nullptr, nullptr).smoothingId = smoothingId;
+
+                return;
+            }
+
+            // Ignore unknown command.
+        });
+    }
+
+    // Port of tinyobj's pnpoly()
+    int PointInTriangle(
+        const tinyobj::real_t *vertx,
+        const tinyobj::real_t *verty,
+        tinyobj::real_t testx,
+        tinyobj::real_t testy)
+    {
+        int i, j, c = 0;
+        for (i = 0, j = 2; i < 3; j = i++)
+        {
+            if (((verty[i] > testy) != (verty[j] > testy)) &&
+                (testx < (vertx[j] - vertx[i]) * (testy - verty[i]) / (verty[j] - verty[i]) + vertx[i]))
+                c = !c;
+        }
+        return c;
+    }
+
+    void AddTriangle(
+        tinyobj::shape_t *shape,
+        const ObjIndex &i0,
+        const ObjIndex &i1,
+        const ObjIndex &i2,
+        int materialId,
+        unsigned int smoothingId)
+    {
+        tinyobj::index_t idx0, idx1, idx2;
+        idx0.vertex_index = i0.v_idx;
+        idx0.normal_index = i0.vn_idx;
+        idx0.texcoord_index = i0.vt_idx;
+        idx1.vertex_index = i1.v_idx;
+        idx1.normal_index = i1.vn_idx;
+        idx1.texcoord_index = i1.vt_idx;
+        idx2.vertex_index = i2.v_idx;
+        idx2.normal_index = i2.vn_idx;
+        idx2.texcoord_index = i2.vt_idx;
+
+        shape->mesh.indices.push_back(idx0);
+        shape->mesh.indices.push_back(idx1);
+        shape->mesh.indices.push_back(idx2);
+
+        shape->mesh.num_face_vertices.push_back(3);
+        shape->mesh.material_ids.push_back(materialId);
+        shape->mesh.smoothing_group_ids.push_back(smoothingId);
+    }
+
+    // Port of the ear clipping in tinyobj's exportGroupsToShape(). The vertex count is the
+    // number of 'v' records parsed when the group was exported, tinyobj only sees those.
+    void TriangulatePolygon(
+        tinyobj::shape_t *shape,
+        const ObjIndex *face,
+        size_t faceSize,
+        int materialId,
+        unsigned int smoothingId,
+        const tinyobj::real_t *v,
+        size_t vsize,
+        std::vector<ObjIndex> &remainingFace)
+    {
+        size_t npolys = faceSize;
+
+        ObjIndex i0, i1, i2;
+
+        size_t axes[2] = {1, 2};
+        for (size_t k = 0; k < npolys; ++k)
+        {
+            i0 = face[(k + 0) % npolys];
+            i1 = face[(k + 1) % npolys];
+            i2 = face[(k + 2) % npolys];
+            size_t vi0 = size_t(i0.v_idx);
+            size_t vi1 = size_t(i1.v_idx);
+            size_t vi2 = size_t(i2.v_idx);
+
+            if (((3 * vi0 + 2) >= vsize) || ((3 * vi1 + 2) >= vsize) || ((3 * vi2 + 2) >= vsize))
+            {
+                continue;
+            }
+            tinyobj::real_t v0x = v[vi0 * 3 + 0];
+            tinyobj::real_t v0y = v[vi0 * 3 + 1];
+            tinyobj::real_t v0z = v[vi0 * 3 + 2];
+            tinyobj::real_t v1x = v[vi1 * 3 + 0];
+            tinyobj::real_t v1y = v[vi1 * 3 + 1];
+            tinyobj::real_t v1z = v[vi1 * 3 + 2];
+            tinyobj::real_t v2x = v[vi2 * 3 + 0];
+            tinyobj::real_t v2y = v[vi2 * 3 + 1];
+            tinyobj::real_t v2z = v[vi2 * 3 + 2];
+            tinyobj::real_t e0x = v1x - v0x;
+            tinyobj::real_t e0y = v1y - v0y;
+            tinyobj::real_t e0z = v1z - v0z;
+            tinyobj::real_t e1x = v2x - v1x;
+            tinyobj::real_t e1y = v2y - v1y;
+            tinyobj::real_t e1z = v2z - v1z;
+            tinyobj::real_t cx = std::fabs(e0y * e1z - e0z * e1y);
+            tinyobj::real_t cy = std::fabs(e0z * e1x - e0x * e1z);
+            tinyobj::real_t cz = std::fabs(e0x * e1y - e0y * e1x);
+            const tinyobj::real_t epsilon = std::numeric_limits<tinyobj::real_t>::epsilon();
+            if (cx > epsilon || cy > epsilon || cz > epsilon)
+            {
+                if (cx > cy && cx > cz)
+                {
+                }
+                else
+                {
+                    axes[0] = 0;
+                    if (cz > cx && cz > cy) axes[1] = 1;
+                }
+                break;
+            }
+        }
+
+        tinyobj::real_t area = 0;
+        for (size_t k = 0; k < npolys; ++k)
+        {
+            i0 = face[(k + 0) % npolys];
+            i1 = face[(k + 1) % npolys];
+            size_t vi0 = size_t(i0.v_idx);
+            size_t vi1 = size_t(i1.v_idx);
+            if (((vi0 * 3 + axes[0]) >= vsize) ||
+                ((vi0 * 3 + axes[1]) >= vsize) ||
+                ((vi1 * 3 + axes[0]) >= vsize) ||
+                ((vi1 * 3 + axes[1]) >= vsize))
+            {
+                continue;
+            }
+            tinyobj::real_t v0x = v[vi0 * 3 + axes[0]];
+            tinyobj::real_t v0y = v[vi0 * 3 + axes[1]];
+            tinyobj::real_t v1x = v[vi1 * 3 + axes[0]];
+            tinyobj::real_t v1y = v[vi1 * 3 + axes[1]];
+            area += (v0x * v1y - v0y * v1x) * static_cast<tinyobj::real_t>(0.5);
+        }
+
+        remainingFace.assign(face, face + faceSize);
+        size_t guess_vert = 0;
+        ObjIndex ind[3];
+        tinyobj::real_t vx[3];
+        tinyobj::real_t vy[3];
+
+        size_t remainingIterations = faceSize;
+        size_t previousRemainingVertices = remainingFace.size();
+
+        while (remainingFace.size() > 3 && remainingIterations > 0)
+        {
+            npolys = remainingFace.size();
+            if (guess_vert >= npolys)
+            {
+                guess_vert -= npolys;
+            }
+
+            if (previousRemainingVertices != npolys)
+            {
+                previousRemainingVertices = npolys;
+                remainingIterations = npolys;
+            }
+            else
+            {
+                remainingIterations--;
+            }
+
+            for (size_t k = 0; k < 3; k++)
+            {
+                ind[k] = remainingFace[(guess_vert + k) % npolys];
+                size_t vi = size_t(ind[k].v_idx);
+                if (((vi * 3 + axes[0]) >= vsize) || ((vi * 3 + axes[1]) >= vsize))
+                {
+                    vx[k] = static_cast<tinyobj::real_t>(0.0);
+                    vy[k] = static_cast<tinyobj::real_t>(0.0);
+                }
+                else
+                {
+                    vx[k] = v[vi * 3 + axes[0]];
+                    vy[k] = v[vi * 3 + axes[1]];
+                }
+            }
+            tinyobj::real_t e0x = vx[1] - vx[0];
+            tinyobj::real_t e0y = vy[1] - vy[0];
+            tinyobj::real_t e1x = vx[2] - vx[1];
+            tinyobj::real_t e1y = vy[2] - vy[1];
+            tinyobj::real_t cross = e0x * e1y - e0y * e1x;
+            if (cross * area < static_cast<tinyobj::real_t>(0.0))
+            {
+                guess_vert += 1;
+                continue;
+            }
+
+            bool overlap = false;
+            for (size_t otherVert = 3; otherVert < npolys; ++otherVert)
+            {
+                size_t idx = (guess_vert + otherVert) % npolys;
+
+                if (idx >= remainingFace.size())
+                {
+                    continue;
+                }
+
+                size_t ovi = size_t(remainingFace[idx].v_idx);
+
+                if (((ovi * 3 + axes[0]) >= vsize) || ((ovi * 3 + axes[1]) >= vsize))
+                {
+                    continue;
+                }
+                tinyobj::real_t tx = v[ovi * 3 + axes[0]];
+                tinyobj::real_t ty = v[ovi * 3 + axes[1]];
+                if (PointInTriangle(vx, vy, tx, ty))
+                {
+                    overlap = true;
+                    break;
+                }
+            }
+
+            if (overlap)
+            {
+                guess_vert += 1;
+                continue;
+            }
+
+            AddTriangle(shape, ind[0], ind[1], ind[2], materialId, smoothingId);
+
+            size_t removed_vert_index = (guess_vert + 1) % npolys;
+            while (removed_vert_index + 1 < npolys)
+            {
+                remainingFace[removed_vert_index] = remainingFace[removed_vert_index + 1];
+                removed_vert_index += 1;
+            }
+            remainingFace.pop_back();
+        }
+
+        if (remainingFace.size() == 3)
+        {
+            AddTriangle(shape, remainingFace[0], remainingFace[1], remainingFace[2], materialId, smoothingId);
+        }
+    }
+
+    bool ExportGroupsToShape(
+        tinyobj::shape_t *shape,
+        const std::vector<PendingFaces> &primGroup,
+        int materialId,
+        const std::string &name,
+        const tinyobj::real_t *v,
+        size_t vsize,
+        std::vector<ObjIndex> &scratch)
+    {
+        if (primGroup.empty())
+        {
+            return false;
+        }
+
+        shape->name = name;
+
+        for (auto &pending : primGroup)
+        {
+            auto index = pending.firstIndex;
+            for (size_t f = 0; f < pending.faceCount; f++)
+            {
+                auto faceSize = pending.chunk->faceSizes[pending.firstFace + f];
+                auto face = &pending.chunk->indices[index];
+                index += faceSize;
+
+                if (faceSize < 3)
+                {
+                    continue;
+                }
+
+                if (faceSize == 3)
+                {
+                    AddTriangle(shape, face[0], face[1], face[2], materialId, pending.smoothingId);
+                }
+                else
+                {
+                    TriangulatePolygon(shape, face, faceSize, materialId, pending.smoothingId, v, vsize, scratch);
+                }
+            }
+        }
+
+        shape->mesh.tags.clear();
+
+        return true;
+    }
+
+    std::string ParseString(
+        const char *&token,
+        const char *end)
+    {
+        token = SkipSpaces(token, end);
+        auto tokenEnd = FindSpace(token, end);
+        std::string result(token, tokenEnd);
+        token = tokenEnd;
+
+        return result;
+    }
+
+    // Same as tinyobj's JoinPath()
+    std::string JoinPath(
+        const std::string &dir,
+        const std::string &filename)
+    {
+        if (dir.empty())
+        {
+            return filename;
+        }
+
+        return dir.back() == '/' ? dir + filename : dir + "/" + filename;
+    }
+
+    // Same results as tinyobj's SplitString(), which splits with std::getline()
+    std::vector<std::string> SplitString(
+        const char *begin,
+        const char *end,
+        char delimiter)
+    {
+        std::vector<std::string> result;
+
+        auto p = begin;
+        while (p < end)
+        {
+            auto itemEnd = std::find(p, end, delimiter);
+            result.emplace_back(p, itemEnd);
+            p = itemEnd < end ? itemEnd + 1 : end;
+        }
+
+        return result;
+    }
+
+    // Splits the file on line boundaries, every chunk but the last ends right after a '\n'.
+    // Small files, or files without threads to spread them over, are a single chunk.
+    std::vector<ObjChunk> SplitChunks(
+        const char *data,
+        size_t size,
+        const ThreadPool &threadPool)
+    {
+        size_t chunkCount = 1;
+        if (threadPool.ThreadCount() > 0 && size >= ParallelThreshold)
+        {
+            chunkCount = std::min((threadPool.ThreadCount() + 1) * 4, size / MinimumChunkSize);
+        }
+
+        std::vector<ObjChunk> chunks;
+        chunks.reserve(chunkCount);
+
+        const char *begin = data;
+        for (size_t i = 1; i <= chunkCount && begin < data + size; i++)
+        {
+            auto end = data + (i == chunkCount ? size : (size * i) / chunkCount);
+            if (end < begin)
+            {
+                end = begin;
+            }
+            while (end < data + size && end[-1] != '\n') end++;
+
+            if (end == begin)
+            {
+                continue;
+            }
+
+            ObjChunk chunk;
+            chunk.begin = begin;
+            chunk.end = end;
+            chunks.push_back(std::move(chunk));
+
+            begin = end;
+        }
+
+        return chunks;
+    }
+
+    struct ObjCounts
+    {
+        size_t lines = 0;
+        size_t vertices = 0;
+        size_t normals = 0;
+        size_t texcoords = 0;
+    };
+
+    // Counts the records of all chunks on the pool and gives every chunk its place in the
+    // attribute arrays. False when the file uses records the parser does not handle.
+    bool CountChunks(
+        std::vector<ObjChunk> &chunks,
+        ThreadPool &threadPool,
+        ObjCounts &counts)
+    {
+        threadPool.ParallelFor(chunks.size(), [&chunks](size_t i) { CountChunk(chunks[i]); });
+
+        for (auto &chunk : chunks)
+        {
+            if (chunk.unsupported)
+            {
+                return false;
+            }
+
+            chunk.lineBase = counts.lines;
+            chunk.vertexBase = counts.vertices;
+            chunk.normalBase = counts.normals;
+            chunk.texcoordBase = counts.texcoords;
+
+            counts.lines += chunk.lineCount;
+            counts.vertices += chunk.vertexCount;
+            counts.normals += chunk.normalCount;
+            counts.texcoords += chunk.texcoordCount;
+        }
+
+        return true;
+    }
+
+    // The material a usemtl event switches to, -1 when it is not in any of the loaded libraries
+    int UseMaterial(
+        const ObjEvent &event,
+        const std::map<std::string, int> &material_map,
+        std::string *warn)
+    {
+        auto token = event.text;
+        std::string namebuf = ParseString(token, event.textEnd);
+
+        auto it = material_map.find(namebuf);
+        if (it != material_map.end())
+        {
+            return it->second;
+        }
+
+        if (warn)
+        {
+            (*warn) += "material [ '" + namebuf + "' ] not found in .mtl\n";
+        }
+
+        return -1;
+    }
+
+    void LoadMaterialLibraries(
+        const ObjEvent &event,
+        size_t line_num,
+        tinyobj::MaterialReader *materialReader,
+        std::vector<tinyobj::material_t> *materials,
+        std::map<std::string, int> &material_map,
+        std::string *warn,
+        std::string *err)
+    {
+        auto filenames = SplitString(event.text, event.textEnd, ' ');
+
+        if (filenames.empty())
+        {
+            if (warn)
+            {
+                std::stringstream ss;
+                ss << "Looks like empty filename for mtllib. Use default "
+                      "material (line "
+                   << line_num << ".)\n";
+
+                (*warn) += ss.str();
+            }
+
+            return;
+        }
+
+        bool found = false;
+        for (size_t s = 0; s < filenames.size(); s++)
+        {
+            std::string warn_mtl;
+            std::string err_mtl;
+            bool ok = materialReader != nullptr && (*materialReader)(filenames[s].c_str(), materials, &material_map, &warn_mtl, &err_mtl);
+            if (warn && (!warn_mtl.empty()))
+            {
+                (*warn) += warn_mtl;
+            }
+
+            if (err && (!err_mtl.empty()))
+            {
+                (*err) += err_mtl;
+            }
+
+            if (ok)
+            {
+                found = true;
+                break;
+            }
+        }
+
+        if (!found && warn)
+        {
+            (*warn) += "Failed to load material file(s). Use default material.\n";
+        }
+    }
+
+    // Sets name to the names after 'g', as tinyobj joins them
+    void GroupName(
+        const ObjEvent &event,
+        size_t line_num,
+        std::string *warn,
+        std::string &name)
+    {
+        std::vector<std::string> names;
+        auto token = event.text;
+        while (token < event.textEnd)
+        {
+            names.push_back(ParseString(token, event.textEnd));
+            token = SkipSpaces(token, event.textEnd);
+        }
+
+        if (names.size() < 2)
+        {
+            if (warn)
+            {
+                std::stringstream ss;
+                ss << "Empty group name. line: " << line_num << "\n";
+                (*warn) += ss.str();
+                name = "";
+            }
+
+            return;
+        }
+
+        std::stringstream ss;
+        ss << names[1];
+
+        for (size_t i = 2; i < names.size(); i++)
+        {
+            ss << " " << names[i];
+        }
+
+        name = ss.str();
+    }
+
+    void WarnOutOfBounds(
+        const std::vector<ObjChunk> &chunks,
+        const ObjCounts &counts,
+        std::string *warn)
+    {
+        int greatest_v_idx = -1;
+        int greatest_vn_idx = -1;
+        int greatest_vt_idx = -1;
+        for (auto &chunk : chunks)
+        {
+            greatest_v_idx = std::max(greatest_v_idx, chunk.greatestV);
+            greatest_vn_idx = std::max(greatest_vn_idx, chunk.greatestVn);
+            greatest_vt_idx = std::max(greatest_vt_idx, chunk.greatestVt);
+        }
+
+        if (greatest_v_idx >= static_cast<int>(counts.vertices) && warn)
+        {
+            std::stringstream ss;
+            ss << "Vertex indices out of bounds (line " << counts.lines << ".)\n"
+               << std::endl;
+            (*warn) += ss.str();
+        }
+        if (greatest_vn_idx >= static_cast<int>(counts.normals) && warn)
+        {
+            std::stringstream ss;
+            ss << "Vertex normal indices out of bounds (line " << counts.lines << ".)\n"
+               << std::endl;
+            (*warn) += ss.str();
+        }
+        if (greatest_vt_idx >= static_cast<int>(counts.texcoords) && warn)
+        {
+            std::stringstream ss;
+            ss << "Vertex texcoord indices out of bounds (line " << counts.lines << ".)\n"
+               << std::endl;
+            (*warn) += ss.str();
+        }
+    }
+
+    // Notes every mtllib name it is asked for, found or not, before passing it on
+    class RecordingMaterialReader : public tinyobj::MaterialReader
+    {
+    public:
+        RecordingMaterialReader(
+            tinyobj::MaterialReader *reader,
+            std::vector<std::string> &names)
+            : _reader(reader),
+              _names(names)
+        {}
+
+        virtual bool operator()(
+            const std::string &matId,
+            std::vector<tinyobj::material_t> *materials,
+            std::map<std::string, int> *matMap,
+            std::string *warn,
+            std::string *err) override
+        {
+            _names.push_back(matId);
+
+            return (*_reader)(matId, materials, matMap, warn, err);
+        }
+
+    private:
+        tinyobj::MaterialReader *_reader;
+        std::vector<std::string> &_names;
+    };
+} // namespace
+
+MemoryStreamBuffer::MemoryStreamBuffer(
+    const char *data,
+    size_t size)
+{
+    auto begin = const_cast<char *>(data);
+    setg(begin, begin, begin + size);
+}
+
+MemoryStream::MemoryStream(
+    const char *data,
+    size_t size)
+    : MemoryStreamBuffer(data, size),
+      std::istream(static_cast<MemoryStreamBuffer *>(this))
+{}
+
+MappedMaterialReader::MappedMaterialReader(
+    const std::string &mtlBaseDir)
+    : _mtlBaseDir(mtlBaseDir),
+      _fileReader(mtlBaseDir)
+{}
+
+MappedMaterialReader::~MappedMaterialReader() = default;
+
+bool MappedMaterialReader::operator()(
+    const std::string &matId,
+    std::vector<tinyobj::material_t> *materials,
+    std::map<std::string, int> *matMap,
+    std::string *warn,
+    std::string *err)
+{
+#ifdef _WIN32
+    const char separator = ';';
+#else
+    const char separator = ':';
+#endif
+
+    // Split the way tinyobj does it with std::getline, an empty base directory is the working directory
+    std::vector<std::string> paths;
+    if (_mtlBaseDir.empty())
+    {
+        paths.push_back("");
+    }
+    for (size_t begin = 0; begin < _mtlBaseDir.size();)
+    {
+        auto end = _mtlBaseDir.find(separator, begin);
+        if (end == std::string::npos)
+        {
+            end = _mtlBaseDir.size();
+        }
+
+        paths.push_back(_mtlBaseDir.substr(begin, end - begin));
+        begin = end + 1;
+    }
+
+    for (auto &path : paths)
+    {
+        MappedFile file;
+        if (!file.Open(JoinPath(path, matId)))
+        {
+            continue;
+        }
+
+        file.AdviseSequential();
+
+        MemoryStream stream(reinterpret_cast<const char *>(file.Data()), file.Size());
+        tinyobj::LoadMtl(matMap, materials, &stream, warn, err);
+
+        return true;
+    }
+
+    // Missing, or empty and so not mappable, tinyobj reports it the way it always has
+    return _fileReader(matId, materials, matMap, warn, err);
+}
+
+ObjParser::ObjParser(
+    ThreadPool &threadPool)
+    : _threadPool(threadPool)
+{}
+
+ObjParser::~ObjParser() = default;
+
+bool ObjParser::LoadObj(
+    tinyobj::attrib_t *attrib,
+    std::vector<tinyobj::shape_t> *shapes,
+    std::vector<tinyobj::material_t> *materials,
+    std::string *warn,
+    std::string *err,
+    const char *filename,
+    const char *mtl_basedir)
+{
+    MappedFile file;
+    if (!file.Open(filename))
+    {
+        // Missing or empty, tinyobj reports the first and reads the second
+        return tinyobj::LoadObj(attrib, shapes, materials, warn, err, filename, mtl_basedir);
+    }
+
+    file.AdviseSequential();
+
+    // What tinyobj::LoadObj does with mtl_basedir
+    std::string baseDir = mtl_basedir ? mtl_basedir : "";
+    if (!baseDir.empty())
+    {
+#ifndef _WIN32
+        const char dirsep = '/';
+#else
+        const char dirsep = '\\';
+#endif
+        if (baseDir[baseDir.length() - 1] != dirsep) baseDir += dirsep;
+    }
+    MappedMaterialReader matFileReader(baseDir);
+
+    return LoadObj(attrib, shapes, materials, warn, err, reinterpret_cast<const char *>(file.Data()), file.Size(), &matFileReader);
+}
+
+bool ObjParser::LoadObj(
+    tinyobj::attrib_t *attrib,
+    std::vector<tinyobj::shape_t> *shapes,
+    std::vector<tinyobj::material_t> *materials,
+    std::string *warn,
+    std::string *err,
+    const char *data,
+    size_t size,
+    tinyobj::MaterialReader *materialReader)
+{
+    _materialLibraries.clear();
+
+    // Without a reader there is nothing to record, tinyobj then skips mtllib altogether
+    RecordingMaterialReader recordingReader(materialReader, _materialLibraries);
+    auto reader = materialReader != nullptr ? &recordingReader : nullptr;
+
+    auto loadWithTinyObj = [&]() {
+        MemoryStream stream(data, size);
+
+        return tinyobj::LoadObj(attrib, shapes, materials, warn, err, &stream, reader);
+    };
+
+    auto chunks = SplitChunks(data, size, _threadPool);
+
+    ObjCounts counts;
+    if (!CountChunks(chunks, _threadPool, counts))
+    {
+        spdlog::debug("obj file uses records the parallel parser does not handle, using tinyobj");
+
+        return loadWithTinyObj();
+    }
+
+    tinyobj::attrib_t result;
+    result.vertices.resize(3 * counts.vertices);
+    result.colors.resize(3 * counts.vertices);
+    result.normals.resize(3 * counts.normals);
+    result.texcoords.resize(2 * counts.texcoords);
+
+    _threadPool.ParallelFor(chunks.size(), [&chunks, &result](size_t i) { ParseChunk(chunks[i], result, true); });
+
+    for (auto &chunk : chunks)
+    {
+        if (chunk.failed)
+        {
+            // Let tinyobj produce the exact diagnostics
+            return loadWithTinyObj();
+        }
+    }
+
+    shapes->clear();
+
+    // Replay the chunks in file order, this is the state machine of tinyobj::LoadObj
+    std::map<std::string, int> material_map;
+    int material = -1;
+    unsigned int current_smoothing_id = 0;
+    std::string name;
+    tinyobj::shape_t shape;
+    std::vector<PendingFaces> primGroup;
+    std::vector<ObjIndex> scratch;
+
+    auto v = result.vertices.data();
+
+    for (auto &chunk : chunks)
+    {
+        for (auto &event : chunk.events)
+        {
+            auto vsize = 3 * (chunk.vertexBase + event.vertexCount);
+            auto line_num = chunk.lineBase + event.line;
+
+            switch (event.type)
+            {
+                case ObjEventType::Faces:
+                {
+                    primGroup.push_back({&chunk, event.firstFace, event.faceCount, event.firstIndex, current_smoothing_id});
+                    break;
+                }
+                case ObjEventType::Smoothing:
+                {
+                    current_smoothing_id = event.smoothingId;
+                    break;
+                }
+                case ObjEventType::Usemtl:
+                {
+                    int newMaterialId = UseMaterial(event, material_map, warn);
+
+                    if (newMaterialId != material)
+                    {
+                        ExportGroupsToShape(&shape, primGroup, material, name, v, vsize, scratch);
+                        primGroup.clear();
+                        material = newMaterialId;
+                    }
+                    break;
+                }
+                case ObjEventType::Mtllib:
+                {
+                    LoadMaterialLibraries(event, line_num, reader, materials, material_map, warn, err);
+                    break;
+                }
+                case ObjEventType::Group:
+                {
+                    ExportGroupsToShape(&shape, primGroup, material, name, v, vsize, scratch);
+
+                    if (shape.mesh.indices.size() > 0)
+                    {
+                        shapes->push_back(std::move(shape));
+                    }
+
+                    shape = tinyobj::shape_t();
+                    primGroup.clear();
+
+                    GroupName(event, line_num, warn, name);
+                    break;
+                }
+                case ObjEventType::Object:
+                {
+                    ExportGroupsToShape(&shape, primGroup, material, name, v, vsize, scratch);
+
+                    if (shape.mesh.indices.size() > 0)
+                    {
+                        shapes->push_back(std::move(shape));
+                    }
+
+                    primGroup.clear();
+                    shape = tinyobj::shape_t();
+
+                    name = std::string(event.text, event.textEnd);
+                    break;
+                }
+            }
+        }
+    }
+
+    WarnOutOfBounds(chunks, counts, warn);
+
+    bool ret = ExportGroupsToShape(&shape, primGroup, material, name, v, 3 * counts.vertices, scratch);
+    if (ret || shape.mesh.indices.size())
+    {
+        shapes->push_back(std::move(shape));
+    }
+
+    attrib->vertices.swap(result.vertices);
+    attrib->vertex_weights.clear();
+    attrib->normals.swap(result.normals);
+    attrib->texcoords.swap(result.texcoords);
+    attrib->texcoord_ws.clear();
+    attrib->colors.swap(result.colors);
+    attrib->skin_weights.clear();
+
+    return true;
+}
+
+const std::vector<std::string> &ObjParser::MaterialLibraries() const
+{
+    return _materialLibraries;
+}
+
+bool ObjParser::LoadObjForStreaming(
+    ObjStream &stream,
+    std::string *warn,
+    std::string *err,
+    const char *filename,
+    const char *mtl_basedir)
+{
+    if (!stream._file.Open(filename))
+    {
+        if (err)
+        {
+            (*err) += "Cannot open file [" + std::string(filename) + "]\n";
+        }
+
+        return false;
+    }
+
+    std::string baseDir = mtl_basedir ? mtl_basedir : "";
+    if (!baseDir.empty())
+    {
+#ifndef _WIN32
+        const char dirsep = '/';
+#else
+        const char dirsep = '\\';
+#endif
+        if (baseDir[baseDir.length() - 1] != dirsep) baseDir += dirsep;
+    }
+    MappedMaterialReader matFileReader(baseDir);
+
+    return LoadObjForStreaming(stream, warn, err, reinterpret_cast<const char *>(stream._file.Data()), stream._file.Size(), &matFileReader);
+}
+
+bool ObjParser::LoadObjForStreaming(
+    ObjStream &stream,
+    std::string *warn,
+    std::string *err,
+    const char *data,
+    size_t size,
+    tinyobj::MaterialReader *materialReader)
+{
+    auto chunks = SplitChunks(data, size, _threadPool);
+
+    ObjCounts counts;
+    if (!CountChunks(chunks, _threadPool, counts))
+    {
+        if (err)
+        {
+            (*err) += "The file uses records that can not be streamed\n";
+        }
+
+        return false;
+    }
+
+    auto &attrib = stream.attrib;
+    attrib = tinyobj::attrib_t();
+    attrib.vertices.resize(3 * counts.vertices);
+    attrib.normals.resize(3 * counts.normals);
+    attrib.texcoords.resize(2 * counts.texcoords);
+
+    _threadPool.ParallelFor(chunks.size(), [&chunks, &attrib](size_t i) { ParseChunk(chunks[i], attrib, false); });
+
+    for (auto &chunk : chunks)
+    {
+        if (chunk.failed)
+        {
+            if (err)
+            {
+                (*err) += "Failed parse `f' line\n";
+            }
+
+            return false;
+        }
+    }
+
+    // The same replay as in LoadObj, it only keeps where the faces of every shape are
+    stream.materials.clear();
+    stream.shapes.clear();
+    stream._runs.clear();
+
+    std::map<std::string, int> material_map;
+    int material = -1;
+    unsigned int current_smoothing_id = 0;
+    std::string name;
+    ObjStreamShape shape;
+
+    auto finishShape = [&stream, &shape]() {
+        if (shape.triangleCount > 0)
+        {
+            stream.shapes.push_back(std::move(shape));
+        }
+
+        shape = ObjStreamShape();
+        shape.firstRun = stream._runs.size();
+    };
+
+    for (auto &chunk : chunks)
+    {
+        for (auto &event : chunk.events)
+        {
+            auto line_num = chunk.lineBase + event.line;
+
+            switch (event.type)
+            {
+                case ObjEventType::Faces:
+                {
+                    if (event.triangleCount == 0)
+                    {
+                        break;
+                    }
+
+                    ObjFaceRun run;
+                    run.begin = event.text;
+                    run.end = event.textEnd;
+                    run.vertexCount = chunk.vertexBase + event.vertexCount;
+                    run.normalCount = chunk.normalBase + event.normalCount;
+                    run.texcoordCount = chunk.texcoordBase + event.texcoordCount;
+                    run.materialId = material;
+                    run.smoothingId = current_smoothing_id;
+                    stream._runs.push_back(run);
+
+                    if (shape.runCount == 0)
+                    {
+                        shape.name = name;
+                    }
+
+                    shape.runCount++;
+                    shape.triangleCount += event.triangleCount;
+                    shape.hasSmoothingGroup = shape.hasSmoothingGroup || current_smoothing_id > 0;
+                    break;
+                }
+                case ObjEventType::Smoothing:
+                {
+                    current_smoothing_id = event.smoothingId;
+                    break;
+                }
+                case ObjEventType::Usemtl:
+                {
+                    material = UseMaterial(event, material_map, warn);
+                    break;
+                }
+                case ObjEventType::Mtllib:
+                {
+                    LoadMaterialLibraries(event, line_num, materialReader, &stream.materials, material_map, warn, err);
+                    break;
+                }
+                case ObjEventType::Group:
+                {
+                    finishShape();
+                    GroupName(event, line_num, warn, name);
+                    break;
+                }
+                case ObjEventType::Object:
+                {
+                    finishShape();
+                    name = std::string(event.text, event.textEnd);
+                    break;
+                }
+            }
+        }
+    }
+
+    WarnOutOfBounds(chunks, counts, warn);
+
+    finishShape();
+
+    return true;
+}
+
+ObjStream::ObjStream() = default;
+
+ObjStream::~ObjStream() = default;
+
+void ObjStream::Rewind(
+    size_t shape)
+{
+    _runEnd = shapes[shape].firstRun + shapes[shape].runCount;
+
+    StartRun(shapes[shape].firstRun);
+}
+
+void ObjStream::StartRun(
+    size_t run)
+{
+    _run = run;
+
+    if (_run < _runEnd)
+    {
+        _line = _runs[_run].begin;
+        _vertexCount = _runs[_run].vertexCount;
+        _normalCount = _runs[_run].normalCount;
+        _texcoordCount = _runs[_run].texcoordCount;
+    }
+}
+
+bool ObjStream::AtEnd() const
+{
+    return _run >= _runEnd;
+}
+
+bool ObjStream::ReadTriangles(
+    size_t maxTriangles,
+    tinyobj::shape_t &shape)
+{
+    shape.mesh.indices.clear();
+    shape.mesh.num_face_vertices.clear();
+    shape.mesh.material_ids.clear();
+    shape.mesh.smoothing_group_ids.clear();
+
+    auto v = attrib.vertices.data();
+    auto vsize = attrib.vertices.size();
+
+    while (_run < _runEnd)
+    {
+        auto &run = _runs[_run];
+
+        while (_line < run.end)
+        {
+            const char *end;
+            auto next = NextLine(_line, run.end, end);
+
+            auto token = SkipSpaces(_line, end);
+            auto c0 = At(token, end);
+            auto c1 = At(token, end, 1);
+
+            // The records in between the faces, the parse pass has seen all of them
+            if (c0 == 'v' && IsSpace(c1))
+            {
+                _vertexCount++;
+            }
+            else if (c0 == 'v' && c1 == 'n' && IsSpace(At(token, end, 2)))
+            {
+                _normalCount++;
+            }
+            else if (c0 == 'v' && c1 == 't' && IsSpace(At(token, end, 2)))
+            {
+                _texcoordCount++;
+            }
+            else if (c0 == 'f' && IsSpace(c1))
+            {
+                token = SkipSpaces(token + 2, end);
+
+                _face.clear();
+                while (token < end)
+                {
+                    ObjIndex vi;
+                    if (!ParseTriple(token, end, _vertexCount, _normalCount, _texcoordCount, vi))
+                    {
+                        break;
+                    }
+
+                    _face.push_back(vi);
+
+                    token = SkipSpaces(token, end);
+                }
+
+                auto faceTriangles = _face.size() >= 3 ? _face.size() - 2 : 0;
+                if (!shape.mesh.indices.empty() && shape.mesh.indices.size() / 3 + faceTriangles > maxTriangles)
+                {
+                    return true;
+                }
+
+                if (_face.size() == 3)
+                {
+                    AddTriangle(&shape, _face[0], _face[1], _face[2], run.materialId, run.smoothingId);
+                }
+                else if (_face.size() > 3)
+                {
+                    TriangulatePolygon(&shape, _face.data(), _face.size(), run.materialId, run.smoothingId, v, vsize, _remainingFace);
+                }
+            }
+
+            _line = next;
+        }
+
+        StartRun(_run + 1);
+    }
+
+    return !shape.mesh.indices.empty();
+}
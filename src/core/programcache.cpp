@@ -0,0 +1,235 @@
+#include <core/programcache.h>
+
+#include <core/mappedfile.h>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+using namespace gamestart;
+
+static const char ProgramCacheMagic[4] = {'G', 'S', 'P', 'B'};
+
+static_assert(sizeof(ProgramCacheHeader) == 24, "ProgramCacheHeader must not contain padding");
+
+namespace // Local utility functions
+{
+    uint64_t Hash(
+        uint64_t hash,
+        const std::string &text)
+    {
+        for (auto c : text)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+
+        // Separator, so moving text from one string to the next changes the hash
+        hash ^= 0xff;
+        hash *= 1099511628211ull;
+
+        return hash;
+    }
+
+    std::string GetString(
+        GLenum name)
+    {
+        auto value = reinterpret_cast<const char *>(glGetString(name));
+
+        return value != nullptr ? value : "";
+    }
+} // namespace
+
+ProgramCache::ProgramCache() = default;
+
+ProgramCache::~ProgramCache() = default;
+
+bool ProgramCache::IsSupported()
+{
+    if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+    {
+        return false;
+    }
+
+    // Some drivers expose the entry points without supporting a single binary format
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+
+    return formatCount > 0;
+}
+
+void ProgramCache::SetDirectory(
+    const std::string &directory)
+{
+    _directory = directory;
+}
+
+uint64_t ProgramCache::KeyFor(
+    const std::string &vertShaderStr,
+    const std::string &fragShaderStr)
+{
+    if (_driver.empty())
+    {
+        _driver = GetString(GL_VENDOR) + "\n" + GetString(GL_RENDERER) + "\n" + GetString(GL_VERSION);
+    }
+
+    uint64_t key = 14695981039346656037ull;
+    key = Hash(key, _driver);
+    key = Hash(key, vertShaderStr);
+    key = Hash(key, fragShaderStr);
+
+    return key;
+}
+
+std::string ProgramCache::PathFor(
+    uint64_t key) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.glprog", static_cast<unsigned long long>(key));
+
+    return (std::filesystem::path(_directory) / std::filesystem::path(name)).string();
+}
+
+GLuint ProgramCache::Load(
+    uint64_t key)
+{
+    if (_directory.empty() || !IsSupported())
+    {
+        return 0;
+    }
+
+    auto path = PathFor(key);
+
+    MappedFile file;
+    if (!file.Open(path))
+    {
+        return 0;
+    }
+
+    ProgramCacheHeader header;
+    if (file.Size() < sizeof(header))
+    {
+        return 0;
+    }
+
+    std::memcpy(&header, file.Data(), sizeof(header));
+
+    if (std::memcmp(header.magic, ProgramCacheMagic, sizeof(header.magic)) != 0 ||
+        header.version != ProgramCacheVersion ||
+        header.key != key ||
+        sizeof(header) + uint64_t(header.binarySize) > file.Size())
+    {
+        return 0;
+    }
+
+    auto program = glCreateProgram();
+    glProgramBinary(program, header.binaryFormat, file.Data() + sizeof(header), static_cast<GLsizei>(header.binarySize));
+
+    GLint result = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &result);
+    if (result == GL_FALSE)
+    {
+        // Not an error, drivers are free to reject binaries of an older build of themselves
+        spdlog::debug("program binary {} was rejected, compiling from source", path);
+
+        glDeleteProgram(program);
+
+        file.Close();
+
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+
+        return 0;
+    }
+
+    spdlog::debug("loaded program binary {}", path);
+
+    return program;
+}
+
+void ProgramCache::MarkRetrievable(
+    GLuint program)
+{
+    if (IsSupported())
+    {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+bool ProgramCache::Store(
+    uint64_t key,
+    GLuint program)
+{
+    if (_directory.empty() || !IsSupported())
+    {
+        return false;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> binary(static_cast<size_t>(length));
+
+    GLsizei written = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &written, &format, binary.data());
+    if (written <= 0)
+    {
+        return false;
+    }
+
+    ProgramCacheHeader header = {};
+    std::memcpy(header.magic, ProgramCacheMagic, sizeof(header.magic));
+    header.version = ProgramCacheVersion;
+    header.key = key;
+    header.binaryFormat = format;
+    header.binarySize = static_cast<uint32_t>(written);
+
+    std::error_code ec;
+    std::filesystem::create_directories(_directory, ec);
+
+    auto path = PathFor(key);
+
+    // Write to a temporary file first, a half written binary must never be picked up by a later load
+    auto tempPath = path + ".tmp";
+
+    {
+        std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+        if (!stream)
+        {
+            spdlog::warn("unable to write program binary {}", path);
+
+            return false;
+        }
+
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        stream.write(reinterpret_cast<const char *>(binary.data()), written);
+
+        if (!stream)
+        {
+            spdlog::warn("unable to write program binary {}", path);
+
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec)
+    {
+        spdlog::warn("unable to write program binary {}: {}", path, ec.message());
+
+        std::filesystem::remove(tempPath, ec);
+
+        return false;
+    }
+
+    spdlog::debug("written program binary {}", path);
+
+    return true;
+}
@@ -0,0 +1,326 @@
+#include <core/shaderlibrary.h>
+
+#include <algorithm>
+#include <spdlog/spdlog.h>
+
+using namespace gamestart;
+
+namespace // Local utility functions
+{
+    bool IsShaderComplete(
+        GLuint shader)
+    {
+        GLint complete = GL_TRUE;
+        glGetShaderiv(shader, GL_COMPLETION_STATUS_KHR, &complete);
+
+        return complete == GL_TRUE;
+    }
+
+    bool IsProgramComplete(
+        GLuint program)
+    {
+        GLint complete = GL_TRUE;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+
+        return complete == GL_TRUE;
+    }
+
+    bool CheckShader(
+        GLuint shader,
+        const char *stage)
+    {
+        GLint result = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
+        if (result == GL_FALSE)
+        {
+            GLint logLength;
+            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+
+            std::vector<GLchar> shaderError(static_cast<size_t>((logLength > 1) ? logLength : 1));
+
+            glGetShaderInfoLog(shader, logLength, NULL, &shaderError[0]);
+
+            spdlog::error("error compiling {} shader {}", stage, shaderError.data());
+
+            return false;
+        }
+
+        return true;
+    }
+
+    GLuint CreateShader(
+        GLenum type,
+        const std::string &source)
+    {
+        const char *shaderSrc = source.c_str();
+
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &shaderSrc, NULL);
+        glCompileShader(shader);
+
+        return shader;
+    }
+
+    int FeatureCount(
+        uint32_t features)
+    {
+        int count = 0;
+        for (; features != 0; features &= features - 1)
+        {
+            count++;
+        }
+
+        return count;
+    }
+} // namespace
+
+ShaderLibrary::ShaderLibrary(
+    ProgramCache &programCache,
+    const ShaderSources &sources)
+    : _programCache(programCache),
+      _sources(sources)
+{}
+
+ShaderLibrary::~ShaderLibrary()
+{
+    for (auto &entry : _variants)
+    {
+        auto &variant = entry.second;
+
+        if (variant.vertShader != 0) glDeleteShader(variant.vertShader);
+        if (variant.fragShader != 0) glDeleteShader(variant.fragShader);
+        if (variant.program != 0 && variant.reflected == nullptr) glDeleteProgram(variant.program);
+    }
+}
+
+const ShaderProgram *ShaderLibrary::Get(
+    uint32_t features)
+{
+    features &= (1u << _sources.features.size()) - 1;
+
+    auto found = _variants.find(features);
+    if (found == _variants.end())
+    {
+        if (_variants.empty())
+        {
+            // GL is loaded by the time the first variant is asked for
+            _isParallel = GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+
+            if (GLAD_GL_KHR_parallel_shader_compile)
+            {
+                glMaxShaderCompilerThreadsKHR(0xffffffff);
+            }
+            else if (GLAD_GL_ARB_parallel_shader_compile)
+            {
+                glMaxShaderCompilerThreadsARB(0xffffffff);
+            }
+        }
+
+        found = Start(features);
+    }
+
+    auto &variant = found->second;
+
+    // Nothing to fall back on for the plain variant
+    if (features == 0 && (variant.state == VariantState::Compiling || variant.state == VariantState::Linking))
+    {
+        Advance(variant, true);
+    }
+
+    if (variant.state == VariantState::Ready)
+    {
+        return variant.reflected.get();
+    }
+
+    if (features == 0)
+    {
+        return nullptr;
+    }
+
+    // The ready variant sharing the most features
+    const ShaderProgram *fallback = nullptr;
+    int fallbackFeatureCount = -1;
+    for (auto &entry : _variants)
+    {
+        if (entry.second.state != VariantState::Ready || (entry.first & ~features) != 0)
+        {
+            continue;
+        }
+
+        auto count = FeatureCount(entry.first);
+        if (count > fallbackFeatureCount)
+        {
+            fallback = entry.second.reflected.get();
+            fallbackFeatureCount = count;
+        }
+    }
+
+    return fallback != nullptr ? fallback : Get(0);
+}
+
+void ShaderLibrary::Update()
+{
+    for (auto &entry : _variants)
+    {
+        auto &variant = entry.second;
+        if (variant.state != VariantState::Compiling && variant.state != VariantState::Linking)
+        {
+            continue;
+        }
+
+        if (_isParallel)
+        {
+            Advance(variant, false);
+        }
+        else
+        {
+            // Compiling blocks without the extension, spread the variants over the frames
+            Advance(variant, true);
+
+            return;
+        }
+    }
+}
+
+std::map<uint32_t, ShaderLibrary::Variant>::iterator ShaderLibrary::Start(
+    uint32_t features)
+{
+    auto vertexSource = Permutation(_sources.vertex, features);
+    auto fragmentSource = Permutation(_sources.fragment, features);
+
+    Variant variant;
+    variant.cacheKey = _programCache.KeyFor(vertexSource, fragmentSource);
+
+    variant.program = _programCache.Load(variant.cacheKey);
+    if (variant.program != 0)
+    {
+        Finish(variant);
+
+        return _variants.emplace(features, std::move(variant)).first;
+    }
+
+    // With the extension these return right away, the driver compiles in the background
+    variant.vertShader = CreateShader(GL_VERTEX_SHADER, vertexSource);
+    variant.fragShader = CreateShader(GL_FRAGMENT_SHADER, fragmentSource);
+
+    return _variants.emplace(features, std::move(variant)).first;
+}
+
+void ShaderLibrary::Advance(
+    Variant &variant,
+    bool wait)
+{
+    if (variant.state == VariantState::Compiling)
+    {
+        if (!wait && (!IsShaderComplete(variant.vertShader) || !IsShaderComplete(variant.fragShader)))
+        {
+            return;
+        }
+
+        if (!CheckShader(variant.vertShader, "vertex") || !CheckShader(variant.fragShader, "fragment"))
+        {
+            glDeleteShader(variant.vertShader);
+            glDeleteShader(variant.fragShader);
+            variant.vertShader = variant.fragShader = 0;
+            variant.state = VariantState::Failed;
+
+            return;
+        }
+
+        variant.program = glCreateProgram();
+        glAttachShader(variant.program, variant.vertShader);
+        glAttachShader(variant.program, variant.fragShader);
+
+        // The vertex arrays are set up with these locations, see SetupVertexAttributes. Cached
+        // binaries keep them, bump ProgramCacheVersion when they change.
+        for (size_t i = 0; i < _sources.attributes.size(); i++)
+        {
+            glBindAttribLocation(variant.program, static_cast<GLuint>(i), _sources.attributes[i].c_str());
+        }
+
+        ProgramCache::MarkRetrievable(variant.program);
+        glLinkProgram(variant.program);
+
+        variant.state = VariantState::Linking;
+    }
+
+    if (variant.state == VariantState::Linking)
+    {
+        if (!wait && !IsProgramComplete(variant.program))
+        {
+            return;
+        }
+
+        glDeleteShader(variant.vertShader);
+        glDeleteShader(variant.fragShader);
+        variant.vertShader = variant.fragShader = 0;
+
+        GLint result = GL_FALSE;
+        glGetProgramiv(variant.program, GL_LINK_STATUS, &result);
+        if (result == GL_FALSE)
+        {
+            GLint logLength;
+            glGetProgramiv(variant.program, GL_INFO_LOG_LENGTH, &logLength);
+
+            std::vector<GLchar> programError(static_cast<size_t>((logLength > 1) ? logLength : 1));
+
+            glGetProgramInfoLog(variant.program, logLength, NULL, &programError[0]);
+
+            spdlog::error("error linking shader {}", programError.data());
+
+            glDeleteProgram(variant.program);
+            variant.program = 0;
+            variant.state = VariantState::Failed;
+
+            return;
+        }
+
+        _programCache.Store(variant.cacheKey, variant.program);
+
+        Finish(variant);
+    }
+}
+
+void ShaderLibrary::Finish(
+    Variant &variant)
+{
+    variant.reflected = std::make_unique<ShaderProgram>(variant.program);
+    variant.state = VariantState::Ready;
+
+    // A binding that did not take leaves the vertex arrays feeding the wrong inputs
+    for (auto &attribute : variant.reflected->Attributes())
+    {
+        auto expected = std::find(_sources.attributes.begin(), _sources.attributes.end(), attribute.name);
+        if (expected != _sources.attributes.end() && attribute.location != static_cast<GLint>(expected - _sources.attributes.begin()))
+        {
+            spdlog::warn("attribute {} of program {} is at location {} instead of {}", attribute.name, variant.program, attribute.location, expected - _sources.attributes.begin());
+        }
+    }
+}
+
+std::string ShaderLibrary::Permutation(
+    const std::string &source,
+    uint32_t features) const
+{
+    std::string defines;
+    for (size_t i = 0; i < _sources.features.size(); i++)
+    {
+        if ((features & (1u << i)) != 0)
+        {
+            defines += "#define " + _sources.features[i] + "\n";
+        }
+    }
+
+    // #version has to stay the first line
+    size_t insertAt = 0;
+    if (source.compare(0, 8, "#version") == 0)
+    {
+        auto lineEnd = source.find('\n');
+        insertAt = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+    }
+
+    auto result = source;
+    result.insert(insertAt, defines);
+
+    return result;
+}
@@ -0,0 +1,252 @@
+#include <core/shaderprogram.h>
+
+#include <algorithm>
+#include <cassert>
+#include <spdlog/spdlog.h>
+
+using namespace gamestart;
+
+// Same order as ShaderUniform
+static const char *ShaderUniformNames[] = {
+    "u_projection",
+    "u_model",
+    "u_positionOffset",
+    "u_positionScale",
+    "u_texture",
+};
+
+static_assert(sizeof(ShaderUniformNames) / sizeof(ShaderUniformNames[0]) == static_cast<size_t>(ShaderUniform::Count), "every ShaderUniform needs a name");
+
+namespace // Local utility functions
+{
+    std::string VariableName(
+        const std::vector<GLchar> &buffer,
+        GLsizei length)
+    {
+        std::string name(buffer.data(), static_cast<size_t>(length));
+
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+        {
+            name.resize(name.size() - 3);
+        }
+
+        return name;
+    }
+
+    bool ByName(
+        const ShaderVariable &a,
+        const ShaderVariable &b)
+    {
+        return a.name < b.name;
+    }
+} // namespace
+
+ShaderProgram::ShaderProgram(
+    GLuint id)
+    : _id(id)
+{
+    Reflect();
+}
+
+ShaderProgram::~ShaderProgram()
+{
+    glDeleteProgram(_id);
+}
+
+GLuint ShaderProgram::Id() const
+{
+    return _id;
+}
+
+void ShaderProgram::Use() const
+{
+    glUseProgram(_id);
+}
+
+const std::vector<ShaderVariable> &ShaderProgram::Uniforms() const
+{
+    return _uniforms;
+}
+
+const std::vector<ShaderUniformBlock> &ShaderProgram::UniformBlocks() const
+{
+    return _uniformBlocks;
+}
+
+const std::vector<ShaderVariable> &ShaderProgram::Attributes() const
+{
+    return _attributes;
+}
+
+void ShaderProgram::Reflect()
+{
+    GLint count = 0, maxLength = 0;
+
+    glGetProgramiv(_id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::vector<GLchar> buffer(static_cast<size_t>(std::max(maxLength, 1)));
+
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        ShaderVariable uniform;
+        glGetActiveUniform(_id, static_cast<GLuint>(i), maxLength, &length, &uniform.size, &uniform.type, buffer.data());
+
+        uniform.name = VariableName(buffer, length);
+
+        // Block members have no location, they are set through the buffer bound to the block
+        uniform.location = glGetUniformLocation(_id, uniform.name.c_str());
+
+        _uniforms.push_back(uniform);
+    }
+
+    std::sort(_uniforms.begin(), _uniforms.end(), ByName);
+
+    glGetProgramiv(_id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(_id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+
+    buffer.resize(static_cast<size_t>(std::max(maxLength, 1)));
+
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        ShaderUniformBlock block;
+        block.index = static_cast<GLuint>(i);
+        glGetActiveUniformBlockName(_id, block.index, maxLength, &length, buffer.data());
+        glGetActiveUniformBlockiv(_id, block.index, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+
+        block.name = std::string(buffer.data(), static_cast<size_t>(length));
+
+        _uniformBlocks.push_back(block);
+    }
+
+    glGetProgramiv(_id, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(_id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+
+    buffer.resize(static_cast<size_t>(std::max(maxLength, 1)));
+
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0;
+        ShaderVariable attribute;
+        glGetActiveAttrib(_id, static_cast<GLuint>(i), maxLength, &length, &attribute.size, &attribute.type, buffer.data());
+
+        attribute.name = VariableName(buffer, length);
+        attribute.location = glGetAttribLocation(_id, attribute.name.c_str());
+
+        _attributes.push_back(attribute);
+    }
+
+    std::sort(_attributes.begin(), _attributes.end(), ByName);
+
+    for (size_t i = 0; i < static_cast<size_t>(ShaderUniform::Count); i++)
+    {
+        _locations[i] = -1;
+        _types[i] = 0;
+
+        ShaderVariable key;
+        key.name = ShaderUniformNames[i];
+
+        auto found = std::lower_bound(_uniforms.begin(), _uniforms.end(), key, ByName);
+        if (found != _uniforms.end() && found->name == key.name)
+        {
+            _locations[i] = found->location;
+            _types[i] = found->type;
+        }
+    }
+
+    spdlog::debug("program {} has {} uniforms, {} uniform blocks and {} attributes", _id, _uniforms.size(), _uniformBlocks.size(), _attributes.size());
+}
+
+GLint ShaderProgram::UniformLocation(
+    const std::string &name) const
+{
+    ShaderVariable key;
+    key.name = name;
+
+    auto found = std::lower_bound(_uniforms.begin(), _uniforms.end(), key, ByName);
+    if (found == _uniforms.end() || found->name != name)
+    {
+        return -1;
+    }
+
+    return found->location;
+}
+
+bool ShaderProgram::HasUniform(
+    ShaderUniform uniform) const
+{
+    return _locations[static_cast<size_t>(uniform)] >= 0;
+}
+
+void ShaderProgram::Set(
+    ShaderUniform uniform,
+    int value) const
+{
+    auto i = static_cast<size_t>(uniform);
+    if (_locations[i] < 0)
+    {
+        return;
+    }
+
+    // Samplers are set as ints too
+    assert(_types[i] == GL_INT || _types[i] == GL_BOOL || _types[i] == GL_SAMPLER_2D);
+    glUniform1i(_locations[i], value);
+}
+
+void ShaderProgram::Set(
+    ShaderUniform uniform,
+    float value) const
+{
+    auto i = static_cast<size_t>(uniform);
+    if (_locations[i] < 0)
+    {
+        return;
+    }
+
+    assert(_types[i] == GL_FLOAT);
+    glUniform1f(_locations[i], value);
+}
+
+void ShaderProgram::Set(
+    ShaderUniform uniform,
+    const glm::vec3 &value) const
+{
+    auto i = static_cast<size_t>(uniform);
+    if (_locations[i] < 0)
+    {
+        return;
+    }
+
+    assert(_types[i] == GL_FLOAT_VEC3);
+    glUniform3fv(_locations[i], 1, &value[0]);
+}
+
+void ShaderProgram::Set(
+    ShaderUniform uniform,
+    const glm::vec4 &value) const
+{
+    auto i = static_cast<size_t>(uniform);
+    if (_locations[i] < 0)
+    {
+        return;
+    }
+
+    assert(_types[i] == GL_FLOAT_VEC4);
+    glUniform4fv(_locations[i], 1, &value[0]);
+}
+
+void ShaderProgram::Set(
+    ShaderUniform uniform,
+    const glm::mat4 &value) const
+{
+    auto i = static_cast<size_t>(uniform);
+    if (_locations[i] < 0)
+    {
+        return;
+    }
+
+    assert(_types[i] == GL_FLOAT_MAT4);
+    glUniformMatrix4fv(_locations[i], 1, GL_FALSE, &value[0][0]);
+}
@@ -0,0 +1,310 @@
+#include <core/smoothingnormals.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define GAMESTART_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace gamestart;
+
+namespace // Local utility functions
+{
+    // Normalized normals of the faces [faceBegin, faceEnd), four faces at a time with SSE. The
+    // operations are the same as in CalcNormal, so both paths give bit identical results.
+    void CalcFaceNormals(
+        const tinyobj::attrib_t &attrib,
+        const tinyobj::shape_t &shape,
+        size_t faceBegin,
+        size_t faceEnd,
+        float *faceNormals)
+    {
+        const float *positions = attrib.vertices.data();
+        const tinyobj::index_t *indices = shape.mesh.indices.data();
+
+        size_t f = faceBegin;
+
+#if defined(GAMESTART_SSE)
+        for (; f + 4 <= faceEnd; f += 4)
+        {
+            __m128 p[3][3];
+            for (int c = 0; c < 3; c++)
+            {
+                const float *v0 = &positions[3 * indices[3 * (f + 0) + c].vertex_index];
+                const float *v1 = &positions[3 * indices[3 * (f + 1) + c].vertex_index];
+                const float *v2 = &positions[3 * indices[3 * (f + 2) + c].vertex_index];
+                const float *v3 = &positions[3 * indices[3 * (f + 3) + c].vertex_index];
+
+                for (int k = 0; k < 3; k++)
+                {
+                    p[c][k] = _mm_setr_ps(v0[k], v1[k], v2[k], v3[k]);
+                }
+            }
+
+            __m128 e1[3], e2[3];
+            for (int k = 0; k < 3; k++)
+            {
+                e1[k] = _mm_sub_ps(p[1][k], p[0][k]);
+                e2[k] = _mm_sub_ps(p[2][k], p[0][k]);
+            }
+
+            __m128 n[3];
+            n[0] = _mm_sub_ps(_mm_mul_ps(e1[1], e2[2]), _mm_mul_ps(e1[2], e2[1]));
+            n[1] = _mm_sub_ps(_mm_mul_ps(e1[2], e2[0]), _mm_mul_ps(e1[0], e2[2]));
+            n[2] = _mm_sub_ps(_mm_mul_ps(e1[0], e2[1]), _mm_mul_ps(e1[1], e2[0]));
+
+            __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(n[0], n[0]), _mm_mul_ps(n[1], n[1])), _mm_mul_ps(n[2], n[2]));
+            __m128 nonZero = _mm_cmpgt_ps(len2, _mm_setzero_ps());
+            __m128 len = _mm_sqrt_ps(len2);
+
+            float out[3][4];
+            for (int k = 0; k < 3; k++)
+            {
+                // Degenerate faces keep their zero length normal, like in CalcNormal
+                __m128 normalized = _mm_div_ps(n[k], len);
+                _mm_storeu_ps(out[k], _mm_or_ps(_mm_and_ps(nonZero, normalized), _mm_andnot_ps(nonZero, n[k])));
+            }
+
+            for (int i = 0; i < 4; i++)
+            {
+                faceNormals[3 * (f + i) + 0] = out[0][i];
+                faceNormals[3 * (f + i) + 1] = out[1][i];
+                faceNormals[3 * (f + i) + 2] = out[2][i];
+            }
+        }
+#endif
+
+        for (; f < faceEnd; f++)
+        {
+            float v[3][3];
+            for (int c = 0; c < 3; c++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    v[c][k] = positions[3 * indices[3 * f + c].vertex_index + k];
+                }
+            }
+
+            CalcNormal(&faceNormals[3 * f], v[0], v[1], v[2]);
+        }
+    }
+} // namespace
+
+size_t SmoothingNormalsScratch::Bytes() const
+{
+    return faceNormals.capacity() * sizeof(float) +
+           (vertexFaceOffsets.capacity() + vertexFaceFill.capacity() + vertexFaces.capacity()) * sizeof(uint32_t);
+}
+
+bool gamestart::HasSmoothingGroup(
+    const tinyobj::shape_t &shape)
+{
+    for (size_t i = 0; i < shape.mesh.smoothing_group_ids.size(); i++)
+    {
+        if (shape.mesh.smoothing_group_ids[i] > 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void gamestart::CalcNormal(
+    float N[3],
+    const float v0[3],
+    const float v1[3],
+    const float v2[3])
+{
+    float v10[3];
+    v10[0] = v1[0] - v0[0];
+    v10[1] = v1[1] - v0[1];
+    v10[2] = v1[2] - v0[2];
+
+    float v20[3];
+    v20[0] = v2[0] - v0[0];
+    v20[1] = v2[1] - v0[1];
+    v20[2] = v2[2] - v0[2];
+
+    N[0] = v10[1] * v20[2] - v10[2] * v20[1];
+    N[1] = v10[2] * v20[0] - v10[0] * v20[2];
+    N[2] = v10[0] * v20[1] - v10[1] * v20[0];
+
+    float len2 = N[0] * N[0] + N[1] * N[1] + N[2] * N[2];
+    if (len2 > 0.0f)
+    {
+        float len = sqrtf(len2);
+
+        N[0] /= len;
+        N[1] /= len;
+        N[2] /= len;
+    }
+}
+
+void gamestart::ComputeSmoothingNormals(
+    const tinyobj::attrib_t &attrib,
+    const tinyobj::shape_t &shape,
+    ThreadPool &threadPool,
+    std::vector<float> &normals,
+    SmoothingNormalsScratch &scratch)
+{
+    const size_t BlockSize = 64 * 1024;
+
+    const size_t faceCount = shape.mesh.indices.size() / 3;
+
+    normals.resize(attrib.vertices.size());
+
+    if (faceCount == 0)
+    {
+        return;
+    }
+
+    // Shapes usually use a contiguous part of the vertices, only that part is touched
+    int vertexBegin = std::numeric_limits<int>::max();
+    int vertexEnd = 0;
+    for (auto &index : shape.mesh.indices)
+    {
+        assert(index.vertex_index >= 0);
+
+        vertexBegin = std::min(vertexBegin, index.vertex_index);
+        vertexEnd = std::max(vertexEnd, index.vertex_index + 1);
+    }
+
+    auto &faceNormals = scratch.faceNormals;
+    faceNormals.resize(3 * faceCount);
+
+    // Passed through std::ref, std::function would copy the captures to the heap otherwise
+    auto faceBlock = [&](size_t block) {
+        CalcFaceNormals(
+            attrib,
+            shape,
+            block * BlockSize,
+            std::min(faceCount, (block + 1) * BlockSize),
+            faceNormals.data());
+    };
+
+    threadPool.ParallelFor((faceCount + BlockSize - 1) / BlockSize, std::ref(faceBlock));
+
+    // Faces per vertex, the faces of vertex v are vertexFaces[offsets[v - vertexBegin]...]
+    const size_t vertexCount = static_cast<size_t>(vertexEnd - vertexBegin);
+
+    auto &offsets = scratch.vertexFaceOffsets;
+    offsets.assign(vertexCount + 1, 0);
+    for (auto &index : shape.mesh.indices)
+    {
+        offsets[index.vertex_index - vertexBegin + 1]++;
+    }
+
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+
+    auto &vertexFaces = scratch.vertexFaces;
+    vertexFaces.resize(shape.mesh.indices.size());
+    {
+        auto &fill = scratch.vertexFaceFill;
+        fill.assign(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < shape.mesh.indices.size(); i++)
+        {
+            vertexFaces[fill[shape.mesh.indices[i].vertex_index - vertexBegin]++] = static_cast<uint32_t>(i / 3);
+        }
+    }
+
+    auto vertexBlock = [&](size_t block) {
+        auto end = std::min(vertexCount, (block + 1) * BlockSize);
+
+        for (size_t v = block * BlockSize; v < end; v++)
+        {
+            float sum[3] = {0.0f, 0.0f, 0.0f};
+            for (auto i = offsets[v]; i < offsets[v + 1]; i++)
+            {
+                const float *normal = &faceNormals[3 * vertexFaces[i]];
+
+                sum[0] += normal[0];
+                sum[1] += normal[1];
+                sum[2] += normal[2];
+            }
+
+            float len2 = sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2];
+            if (len2 > 0.0f)
+            {
+                float len = sqrtf(len2);
+
+                sum[0] /= len;
+                sum[1] /= len;
+                sum[2] /= len;
+            }
+
+            float *out = &normals[3 * (vertexBegin + v)];
+            out[0] = sum[0];
+            out[1] = sum[1];
+            out[2] = sum[2];
+        }
+    };
+
+    threadPool.ParallelFor((vertexCount + BlockSize - 1) / BlockSize, std::ref(vertexBlock));
+}
+
+void gamestart::AccumulateSmoothingNormals(
+    const tinyobj::attrib_t &attrib,
+    const tinyobj::shape_t &part,
+    std::vector<float> &normals,
+    int &vertexBegin,
+    int &vertexEnd)
+{
+    for (size_t f = 0; f < part.mesh.indices.size() / 3; f++)
+    {
+        float v[3][3];
+        for (int c = 0; c < 3; c++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                v[c][k] = attrib.vertices[3 * part.mesh.indices[3 * f + c].vertex_index + k];
+            }
+        }
+
+        float normal[3];
+        CalcNormal(normal, v[0], v[1], v[2]);
+
+        for (int c = 0; c < 3; c++)
+        {
+            auto vertex = part.mesh.indices[3 * f + c].vertex_index;
+            assert(vertex >= 0);
+
+            float *out = &normals[3 * vertex];
+            out[0] += normal[0];
+            out[1] += normal[1];
+            out[2] += normal[2];
+
+            vertexBegin = std::min(vertexBegin, vertex);
+            vertexEnd = std::max(vertexEnd, vertex + 1);
+        }
+    }
+}
+
+void gamestart::NormalizeSmoothingNormals(
+    std::vector<float> &normals,
+    int vertexBegin,
+    int vertexEnd)
+{
+    for (int v = vertexBegin; v < vertexEnd; v++)
+    {
+        float *n = &normals[3 * v];
+
+        float len2 = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+        if (len2 > 0.0f)
+        {
+            float len = sqrtf(len2);
+
+            n[0] /= len;
+            n[1] /= len;
+            n[2] /= len;
+        }
+    }
+}
@@ -0,0 +1,230 @@
+#include <core/stagingring.h>
+
+#include <algorithm>
+#include <cstring>
+#include <spdlog/spdlog.h>
+
+using namespace gamestart;
+
+namespace // Local utility functions
+{
+    // Keeps the copies in the mapping aligned
+    const size_t RingAlignment = 64;
+
+    // Upper bound for one wait on a fence, waiting goes on after it with a warning
+    const GLuint64 FenceTimeout = 1000000000;
+
+    size_t AlignUp(
+        size_t size)
+    {
+        return (size + RingAlignment - 1) & ~(RingAlignment - 1);
+    }
+} // namespace
+
+StagingRing::StagingRing(
+    size_t size)
+    : _size(std::max(size & ~(RingAlignment - 1), 4 * RingAlignment))
+{}
+
+StagingRing::~StagingRing()
+{
+    for (auto &region : _regions)
+    {
+        glDeleteSync(region.fence);
+    }
+
+    // Deleting the buffer unmaps it
+    if (_buffer != 0)
+    {
+        glDeleteBuffers(1, &_buffer);
+    }
+}
+
+bool StagingRing::IsSupported()
+{
+    return (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) &&
+           (GLAD_GL_VERSION_3_1 || GLAD_GL_ARB_copy_buffer);
+}
+
+bool StagingRing::IsAvailable()
+{
+    if (_buffer != 0)
+    {
+        return true;
+    }
+
+    if (_failed)
+    {
+        return false;
+    }
+
+    return Create();
+}
+
+void StagingRing::Upload(
+    GLuint buffer,
+    size_t offset,
+    const void *data,
+    size_t size)
+{
+    if (!IsAvailable())
+    {
+        return;
+    }
+
+    // A quarter of the ring at most, so the next piece can be written while one is copied
+    auto maxPiece = (_size / 4) & ~(RingAlignment - 1);
+    auto bytes = static_cast<const uint8_t *>(data);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, _buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+
+    while (size > 0)
+    {
+        auto piece = std::min(size, maxPiece);
+        auto ringOffset = Allocate(piece);
+
+        std::memcpy(_mapped + ringOffset, bytes, piece);
+
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(ringOffset), static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(piece));
+
+        bytes += piece;
+        offset += piece;
+        size -= piece;
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void StagingRing::Fence()
+{
+    if (_unfencedBytes > 0)
+    {
+        Region region;
+        region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region.bytes = _unfencedBytes;
+
+        _regions.push_back(region);
+        _unfencedBytes = 0;
+    }
+
+    Retire(false);
+}
+
+bool StagingRing::Create()
+{
+    if (!IsSupported())
+    {
+        spdlog::info("buffer storage is not supported, uploading without a staging ring");
+
+        _failed = true;
+
+        return false;
+    }
+
+    // Coherent, so writes through the mapping are seen by copies issued after them
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &_buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, _buffer);
+    glBufferStorage(GL_COPY_READ_BUFFER, static_cast<GLsizeiptr>(_size), nullptr, flags);
+
+    _mapped = static_cast<uint8_t *>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, static_cast<GLsizeiptr>(_size), flags));
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    if (_mapped == nullptr)
+    {
+        spdlog::warn("failed to map a staging ring of {} bytes, uploading without it", _size);
+
+        glDeleteBuffers(1, &_buffer);
+        _buffer = 0;
+        _failed = true;
+
+        return false;
+    }
+
+    spdlog::debug("created a staging ring of {} bytes", _size);
+
+    return true;
+}
+
+size_t StagingRing::Allocate(
+    size_t size)
+{
+    size = AlignUp(size);
+
+    Retire(false);
+
+    // The space left at the end is skipped when the allocation does not fit in it
+    auto skipped = _head + size > _size ? _size - _head : 0;
+
+    while (_inUse + skipped + size > _size)
+    {
+        if (_regions.empty())
+        {
+            // Everything in use was written since the last fence
+            Fence();
+        }
+
+        Retire(true);
+
+        skipped = _head + size > _size ? _size - _head : 0;
+    }
+
+    if (skipped > 0)
+    {
+        _head = 0;
+        _inUse += skipped;
+        _unfencedBytes += skipped;
+    }
+
+    auto offset = _head;
+
+    _head = (_head + size) % _size;
+    _inUse += size;
+    _unfencedBytes += size;
+
+    return offset;
+}
+
+void StagingRing::Retire(
+    bool wait)
+{
+    while (!_regions.empty())
+    {
+        auto &region = _regions.front();
+
+        auto status = glClientWaitSync(region.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? FenceTimeout : 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            if (!wait)
+            {
+                break;
+            }
+
+            spdlog::warn("still waiting for the GPU to finish reading the staging ring");
+
+            continue;
+        }
+
+        if (status == GL_WAIT_FAILED)
+        {
+            spdlog::warn("waiting on a staging ring fence failed");
+        }
+
+        glDeleteSync(region.fence);
+        _inUse -= region.bytes;
+        _regions.pop_front();
+
+        // One region is enough to make progress, the rest is only taken when already done
+        wait = false;
+    }
+
+    // Starting over at the front keeps large allocations from being split by the end
+    if (_inUse == 0)
+    {
+        _head = 0;
+    }
+}
@@ -0,0 +1,777 @@
+#include <core/texturecooker.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <spdlog/spdlog.h>
+
+using namespace gamestart;
+
+static const unsigned char KtxIdentifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+static const uint32_t KtxEndianness = 0x04030201;
+static const char CookedTextureKey[] = "gamestart.source";
+
+struct KtxHeader
+{
+    unsigned char identifier[12];
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+// Value stored under CookedTextureKey
+struct CookedTextureStamp
+{
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+};
+
+static_assert(sizeof(KtxHeader) == 64, "KtxHeader must not contain padding");
+static_assert(sizeof(CookedTextureStamp) == 24, "CookedTextureStamp must not contain padding");
+
+namespace // Local utility functions
+{
+    // Every image is handled as RGBA8 while cooking, whatever the source had
+    class Image
+    {
+    public:
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> pixels;
+    };
+
+    size_t BlockBytes(
+        GLenum internalFormat)
+    {
+        return internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 16;
+    }
+
+    GLenum BaseInternalFormat(
+        GLenum internalFormat)
+    {
+        switch (internalFormat)
+        {
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+                return GL_RGB;
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                return GL_RGBA;
+            case GL_COMPRESSED_RG_RGTC2:
+                return GL_RG;
+            default:
+                return 0;
+        }
+    }
+
+    size_t LevelSize(
+        GLenum internalFormat,
+        int width,
+        int height)
+    {
+        return size_t((width + 3) / 4) * size_t((height + 3) / 4) * BlockBytes(internalFormat);
+    }
+
+    uint32_t AlignUp4(
+        uint32_t value)
+    {
+        return (value + 3) & ~3u;
+    }
+
+    Image ExpandToRgba(
+        const unsigned char *pixels,
+        int width,
+        int height,
+        int components)
+    {
+        Image image;
+        image.width = width;
+        image.height = height;
+        image.pixels.resize(size_t(width) * size_t(height) * 4);
+
+        for (size_t i = 0; i < size_t(width) * size_t(height); i++)
+        {
+            const unsigned char *in = &pixels[i * components];
+            uint8_t *out = &image.pixels[i * 4];
+
+            switch (components)
+            {
+                case 1:
+                    out[0] = out[1] = out[2] = in[0];
+                    out[3] = 255;
+                    break;
+                case 2:
+                    // Two channel images go to BC5, the channels end up in red and green
+                    out[0] = in[0];
+                    out[1] = in[1];
+                    out[2] = 0;
+                    out[3] = 255;
+                    break;
+                case 3:
+                    out[0] = in[0];
+                    out[1] = in[1];
+                    out[2] = in[2];
+                    out[3] = 255;
+                    break;
+                default:
+                    std::memcpy(out, in, 4);
+                    break;
+            }
+        }
+
+        return image;
+    }
+
+    float SrgbToLinear(
+        uint8_t value)
+    {
+        static const auto table = []() {
+            std::vector<float> result(256);
+            for (int i = 0; i < 256; i++)
+            {
+                float c = float(i) / 255.0f;
+                result[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            return result;
+        }();
+
+        return table[value];
+    }
+
+    uint8_t LinearToSrgb(
+        float value)
+    {
+        value = std::clamp(value, 0.0f, 1.0f);
+
+        float c = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+
+        return static_cast<uint8_t>(std::lround(c * 255.0f));
+    }
+
+    // 2x2 box filter, color channels are averaged in linear light when srgb is set
+    Image Downsample(
+        const Image &source,
+        bool srgb)
+    {
+        Image result;
+        result.width = std::max(1, source.width / 2);
+        result.height = std::max(1, source.height / 2);
+        result.pixels.resize(size_t(result.width) * size_t(result.height) * 4);
+
+        for (int y = 0; y < result.height; y++)
+        {
+            for (int x = 0; x < result.width; x++)
+            {
+                int x0 = std::min(2 * x, source.width - 1);
+                int x1 = std::min(2 * x + 1, source.width - 1);
+                int y0 = std::min(2 * y, source.height - 1);
+                int y1 = std::min(2 * y + 1, source.height - 1);
+
+                const uint8_t *p[4] = {
+                    &source.pixels[(size_t(y0) * source.width + x0) * 4],
+                    &source.pixels[(size_t(y0) * source.width + x1) * 4],
+                    &source.pixels[(size_t(y1) * source.width + x0) * 4],
+                    &source.pixels[(size_t(y1) * source.width + x1) * 4],
+                };
+
+                uint8_t *out = &result.pixels[(size_t(y) * result.width + x) * 4];
+
+                for (int c = 0; c < 4; c++)
+                {
+                    if (srgb && c < 3)
+                    {
+                        float sum = SrgbToLinear(p[0][c]) + SrgbToLinear(p[1][c]) + SrgbToLinear(p[2][c]) + SrgbToLinear(p[3][c]);
+
+                        out[c] = LinearToSrgb(sum * 0.25f);
+                    }
+                    else
+                    {
+                        out[c] = static_cast<uint8_t>((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+                    }
+                }
+            }
+        }
+
+        return result;
+    }
+
+    uint16_t Pack565(
+        const float color[3])
+    {
+        auto r = static_cast<uint16_t>(std::lround(std::clamp(color[0], 0.0f, 255.0f) * 31.0f / 255.0f));
+        auto g = static_cast<uint16_t>(std::lround(std::clamp(color[1], 0.0f, 255.0f) * 63.0f / 255.0f));
+        auto b = static_cast<uint16_t>(std::lround(std::clamp(color[2], 0.0f, 255.0f) * 31.0f / 255.0f));
+
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+    }
+
+    void Unpack565(
+        uint16_t packed,
+        int color[3])
+    {
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+    }
+
+    // Four color BC1 block, the endpoints are the extremes of the pixels along their principal axis
+    void EncodeColorBlock(
+        const uint8_t block[16][4],
+        uint8_t *out)
+    {
+        float mean[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; i++)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                mean[k] += block[i][k] / 16.0f;
+            }
+        }
+
+        float covariance[3][3] = {};
+        for (int i = 0; i < 16; i++)
+        {
+            float d[3] = {block[i][0] - mean[0], block[i][1] - mean[1], block[i][2] - mean[2]};
+            for (int a = 0; a < 3; a++)
+            {
+                for (int b = 0; b < 3; b++)
+                {
+                    covariance[a][b] += d[a] * d[b];
+                }
+            }
+        }
+
+        float axis[3] = {1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < 8; iteration++)
+        {
+            float next[3];
+            for (int a = 0; a < 3; a++)
+            {
+                next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] + covariance[a][2] * axis[2];
+            }
+
+            float largest = std::max(std::fabs(next[0]), std::max(std::fabs(next[1]), std::fabs(next[2])));
+            if (largest <= 0.0f)
+            {
+                break;
+            }
+
+            for (int a = 0; a < 3; a++)
+            {
+                axis[a] = next[a] / largest;
+            }
+        }
+
+        float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        for (int a = 0; a < 3; a++)
+        {
+            axis[a] /= length;
+        }
+
+        float minT = 0.0f, maxT = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = (block[i][0] - mean[0]) * axis[0] + (block[i][1] - mean[1]) * axis[1] + (block[i][2] - mean[2]) * axis[2];
+
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+
+        float e0[3], e1[3];
+        for (int k = 0; k < 3; k++)
+        {
+            e0[k] = mean[k] + axis[k] * maxT;
+            e1[k] = mean[k] + axis[k] * minT;
+        }
+
+        auto c0 = Pack565(e0);
+        auto c1 = Pack565(e1);
+
+        // c0 > c1 selects the four color mode
+        if (c0 < c1)
+        {
+            std::swap(c0, c1);
+        }
+
+        uint32_t indices = 0;
+
+        if (c0 != c1)
+        {
+            int palette[4][3];
+            Unpack565(c0, palette[0]);
+            Unpack565(c1, palette[1]);
+            for (int k = 0; k < 3; k++)
+            {
+                palette[2][k] = (2 * palette[0][k] + palette[1][k]) / 3;
+                palette[3][k] = (palette[0][k] + 2 * palette[1][k]) / 3;
+            }
+
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0;
+                int bestDistance = std::numeric_limits<int>::max();
+
+                for (int p = 0; p < 4; p++)
+                {
+                    int dr = block[i][0] - palette[p][0];
+                    int dg = block[i][1] - palette[p][1];
+                    int db = block[i][2] - palette[p][2];
+                    int distance = dr * dr + dg * dg + db * db;
+
+                    if (distance < bestDistance)
+                    {
+                        best = p;
+                        bestDistance = distance;
+                    }
+                }
+
+                indices |= uint32_t(best) << (2 * i);
+            }
+        }
+
+        out[0] = uint8_t(c0 & 0xff);
+        out[1] = uint8_t(c0 >> 8);
+        out[2] = uint8_t(c1 & 0xff);
+        out[3] = uint8_t(c1 >> 8);
+        for (int b = 0; b < 4; b++)
+        {
+            out[4 + b] = uint8_t(indices >> (8 * b));
+        }
+    }
+
+    // Eight value BC4 block, used for the alpha of BC3 and both channels of BC5
+    void EncodeChannelBlock(
+        const uint8_t block[16][4],
+        int channel,
+        uint8_t *out)
+    {
+        int r0 = 0, r1 = 255;
+        for (int i = 0; i < 16; i++)
+        {
+            r0 = std::max(r0, int(block[i][channel]));
+            r1 = std::min(r1, int(block[i][channel]));
+        }
+
+        uint64_t indices = 0;
+
+        if (r0 != r1)
+        {
+            int palette[8];
+            palette[0] = r0;
+            palette[1] = r1;
+            for (int p = 2; p < 8; p++)
+            {
+                palette[p] = ((8 - p) * r0 + (p - 1) * r1) / 7;
+            }
+
+            for (int i = 0; i < 16; i++)
+            {
+                int best = 0;
+                int bestDistance = std::numeric_limits<int>::max();
+
+                for (int p = 0; p < 8; p++)
+                {
+                    int distance = std::abs(int(block[i][channel]) - palette[p]);
+
+                    if (distance < bestDistance)
+                    {
+                        best = p;
+                        bestDistance = distance;
+                    }
+                }
+
+                indices |= uint64_t(best) << (3 * i);
+            }
+        }
+
+        out[0] = uint8_t(r0);
+        out[1] = uint8_t(r1);
+        for (int b = 0; b < 6; b++)
+        {
+            out[2 + b] = uint8_t(indices >> (8 * b));
+        }
+    }
+
+    void EncodeLevel(
+        GLenum internalFormat,
+        const Image &image,
+        std::vector<uint8_t> &out)
+    {
+        const size_t blockBytes = BlockBytes(internalFormat);
+
+        out.resize(LevelSize(internalFormat, image.width, image.height));
+
+        uint8_t *block = out.data();
+        for (int by = 0; by < image.height; by += 4)
+        {
+            for (int bx = 0; bx < image.width; bx += 4)
+            {
+                // Levels smaller than a block repeat their edge pixels
+                uint8_t pixels[16][4];
+                for (int i = 0; i < 16; i++)
+                {
+                    int x = std::min(bx + i % 4, image.width - 1);
+                    int y = std::min(by + i / 4, image.height - 1);
+
+                    std::memcpy(pixels[i], &image.pixels[(size_t(y) * image.width + x) * 4], 4);
+                }
+
+                switch (internalFormat)
+                {
+                    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+                        EncodeColorBlock(pixels, block);
+                        break;
+                    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                        EncodeChannelBlock(pixels, 3, block);
+                        EncodeColorBlock(pixels, block + 8);
+                        break;
+                    case GL_COMPRESSED_RG_RGTC2:
+                        EncodeChannelBlock(pixels, 0, block);
+                        EncodeChannelBlock(pixels, 1, block + 8);
+                        break;
+                }
+
+                block += blockBytes;
+            }
+        }
+    }
+} // namespace
+
+CookedTexture::CookedTexture() = default;
+
+CookedTexture::~CookedTexture() = default;
+
+std::string CookedTexture::PathFor(
+    const std::string &sourcePath)
+{
+    // Appended instead of replacing the extension, tree.png and tree.tga are different textures
+    return sourcePath + ".ktx";
+}
+
+GLenum CookedTexture::FormatFor(
+    const unsigned char *pixels,
+    int width,
+    int height,
+    int components)
+{
+    if (components == 2)
+    {
+        return GL_COMPRESSED_RG_RGTC2;
+    }
+
+    if (components == 4)
+    {
+        for (size_t i = 0; i < size_t(width) * size_t(height); i++)
+        {
+            if (pixels[i * 4 + 3] != 255)
+            {
+                return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            }
+        }
+    }
+
+    return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+}
+
+bool CookedTexture::IsFormatSupported(
+    GLenum internalFormat)
+{
+    switch (internalFormat)
+    {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            return GLAD_GL_EXT_texture_compression_s3tc != 0;
+        case GL_COMPRESSED_RG_RGTC2:
+            return GLAD_GL_VERSION_3_0 != 0 || GLAD_GL_ARB_texture_compression_rgtc != 0;
+        default:
+            return false;
+    }
+}
+
+bool CookedTexture::Cook(
+    const std::string &cookedPath,
+    const std::string &sourcePath,
+    const unsigned char *pixels,
+    int width,
+    int height,
+    int components)
+{
+    if (width <= 0 || height <= 0 || components < 1 || components > 4)
+    {
+        return false;
+    }
+
+    CookedTextureStamp stamp = {};
+    stamp.version = CookedTextureVersion;
+    if (!GetFileStamp(sourcePath, stamp.sourceSize, stamp.sourceTime))
+    {
+        return false;
+    }
+
+    auto internalFormat = FormatFor(pixels, width, height, components);
+
+    // Two channel images are data, not color, those are filtered as is
+    bool srgb = internalFormat != GL_COMPRESSED_RG_RGTC2;
+
+    std::vector<std::vector<uint8_t>> levels;
+
+    auto image = ExpandToRgba(pixels, width, height, components);
+    while (true)
+    {
+        levels.emplace_back();
+        EncodeLevel(internalFormat, image, levels.back());
+
+        if (image.width == 1 && image.height == 1)
+        {
+            break;
+        }
+
+        image = Downsample(image, srgb);
+    }
+
+    auto keyAndValueSize = static_cast<uint32_t>(sizeof(CookedTextureKey) + sizeof(stamp));
+
+    KtxHeader header = {};
+    std::memcpy(header.identifier, KtxIdentifier, sizeof(KtxIdentifier));
+    header.endianness = KtxEndianness;
+    header.glType = 0;
+    header.glTypeSize = 1;
+    header.glFormat = 0;
+    header.glInternalFormat = internalFormat;
+    header.glBaseInternalFormat = BaseInternalFormat(internalFormat);
+    header.pixelWidth = static_cast<uint32_t>(width);
+    header.pixelHeight = static_cast<uint32_t>(height);
+    header.numberOfFaces = 1;
+    header.numberOfMipmapLevels = static_cast<uint32_t>(levels.size());
+    header.bytesOfKeyValueData = sizeof(uint32_t) + AlignUp4(keyAndValueSize);
+
+    // Write to a temporary file first, a half written texture must never be picked up by a later load
+    auto tempPath = cookedPath + ".tmp";
+
+    {
+        std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+        if (!stream)
+        {
+            spdlog::warn("unable to write cooked texture {}", cookedPath);
+
+            return false;
+        }
+
+        static const char zeros[4] = {};
+
+        stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        stream.write(reinterpret_cast<const char *>(&keyAndValueSize), sizeof(keyAndValueSize));
+        stream.write(CookedTextureKey, sizeof(CookedTextureKey));
+        stream.write(reinterpret_cast<const char *>(&stamp), sizeof(stamp));
+        stream.write(zeros, AlignUp4(keyAndValueSize) - keyAndValueSize);
+
+        // Block sizes are multiples of 4, so no mip padding is needed
+        for (auto &level : levels)
+        {
+            auto imageSize = static_cast<uint32_t>(level.size());
+
+            stream.write(reinterpret_cast<const char *>(&imageSize), sizeof(imageSize));
+            stream.write(reinterpret_cast<const char *>(level.data()), static_cast<std::streamsize>(level.size()));
+        }
+
+        if (!stream)
+        {
+            spdlog::warn("unable to write cooked texture {}", cookedPath);
+
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, cookedPath, ec);
+    if (ec)
+    {
+        spdlog::warn("unable to write cooked texture {}: {}", cookedPath, ec.message());
+
+        std::filesystem::remove(tempPath, ec);
+
+        return false;
+    }
+
+    spdlog::info("written cooked texture {}, {} levels", cookedPath, levels.size());
+
+    return true;
+}
+
+bool CookedTexture::Open(
+    const std::string &cookedPath,
+    const std::string &sourcePath)
+{
+    _internalFormat = 0;
+    _levels.clear();
+
+    if (!_file.Open(cookedPath))
+    {
+        return false;
+    }
+
+    if (!Parse(_file.Data(), _file.Size(), sourcePath))
+    {
+        spdlog::info("cooked texture {} is out of date", cookedPath);
+
+        _file.Close();
+        _levels.clear();
+
+        return false;
+    }
+
+    return true;
+}
+
+bool CookedTexture::Open(
+    const unsigned char *data,
+    size_t size)
+{
+    _internalFormat = 0;
+    _levels.clear();
+    _file.Close();
+
+    if (!Parse(data, size, std::string()))
+    {
+        _levels.clear();
+
+        return false;
+    }
+
+    return true;
+}
+
+bool CookedTexture::Parse(
+    const unsigned char *data,
+    uint64_t size,
+    const std::string &sourcePath)
+{
+    if (size < sizeof(KtxHeader))
+    {
+        return false;
+    }
+
+    KtxHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    if (std::memcmp(header.identifier, KtxIdentifier, sizeof(KtxIdentifier)) != 0 ||
+        header.endianness != KtxEndianness ||
+        header.glType != 0 ||
+        BaseInternalFormat(header.glInternalFormat) == 0 ||
+        header.pixelWidth == 0 ||
+        header.pixelHeight == 0 ||
+        header.pixelDepth != 0 ||
+        header.numberOfArrayElements != 0 ||
+        header.numberOfFaces != 1 ||
+        header.numberOfMipmapLevels == 0 ||
+        header.numberOfMipmapLevels > 32 ||
+        sizeof(KtxHeader) + uint64_t(header.bytesOfKeyValueData) > size)
+    {
+        return false;
+    }
+
+    // Find the stamp in the key/value data
+    bool isCurrent = false;
+
+    uint64_t offset = sizeof(KtxHeader);
+    const uint64_t keyValueEnd = offset + header.bytesOfKeyValueData;
+    while (offset + sizeof(uint32_t) <= keyValueEnd)
+    {
+        uint32_t keyAndValueSize;
+        std::memcpy(&keyAndValueSize, data + offset, sizeof(keyAndValueSize));
+        offset += sizeof(uint32_t);
+
+        if (offset + keyAndValueSize > keyValueEnd)
+        {
+            return false;
+        }
+
+        if (keyAndValueSize == sizeof(CookedTextureKey) + sizeof(CookedTextureStamp) &&
+            std::memcmp(data + offset, CookedTextureKey, sizeof(CookedTextureKey)) == 0)
+        {
+            CookedTextureStamp stamp;
+            std::memcpy(&stamp, data + offset + sizeof(CookedTextureKey), sizeof(stamp));
+
+            uint64_t sourceSize;
+            int64_t sourceTime;
+            isCurrent = stamp.version == CookedTextureVersion &&
+                        (sourcePath.empty() ||
+                         (GetFileStamp(sourcePath, sourceSize, sourceTime) &&
+                          sourceSize == stamp.sourceSize &&
+                          sourceTime == stamp.sourceTime));
+        }
+
+        offset += AlignUp4(keyAndValueSize);
+    }
+
+    if (!isCurrent)
+    {
+        return false;
+    }
+
+    offset = keyValueEnd;
+
+    for (uint32_t i = 0; i < header.numberOfMipmapLevels; i++)
+    {
+        CookedTextureLevel level;
+        level.width = std::max(1, int(header.pixelWidth >> i));
+        level.height = std::max(1, int(header.pixelHeight >> i));
+        level.size = LevelSize(header.glInternalFormat, level.width, level.height);
+
+        if (offset + sizeof(uint32_t) > size)
+        {
+            return false;
+        }
+
+        uint32_t imageSize;
+        std::memcpy(&imageSize, data + offset, sizeof(imageSize));
+        offset += sizeof(uint32_t);
+
+        if (imageSize != level.size || offset + imageSize > size)
+        {
+            return false;
+        }
+
+        level.data = data + offset;
+        offset += AlignUp4(imageSize);
+
+        _levels.push_back(level);
+    }
+
+    _internalFormat = header.glInternalFormat;
+
+    return true;
+}
+
+GLenum CookedTexture::InternalFormat() const
+{
+    return _internalFormat;
+}
+
+size_t CookedTexture::LevelCount() const
+{
+    return _levels.size();
+}
+
+const CookedTextureLevel &CookedTexture::Level(
+    size_t index) const
+{
+    return _levels[index];
+}
@@ -0,0 +1,151 @@
+#include <core/threadpool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+using namespace gamestart;
+
+ThreadPool::ThreadPool(
+    size_t threadCount)
+{
+#if defined(EMSCRIPTEN)
+    // Without pthreads everything runs on the calling thread
+    threadCount = 0;
+#else
+    if (threadCount == 0)
+    {
+        auto hardwareThreads = std::thread::hardware_concurrency();
+
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 0;
+    }
+#endif
+
+    for (size_t i = 0; i < threadCount; i++)
+    {
+        _threads.emplace_back(&ThreadPool::WorkerMain, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        _stopping = true;
+    }
+
+    _condition.notify_all();
+
+    for (auto &thread : _threads)
+    {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::ThreadCount() const
+{
+    return _threads.size();
+}
+
+void ThreadPool::Enqueue(
+    std::function<void()> task)
+{
+    if (_threads.empty())
+    {
+        task();
+
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        _tasks.push_back(std::move(task));
+    }
+
+    _condition.notify_one();
+}
+
+void ThreadPool::ParallelFor(
+    size_t count,
+    const std::function<void(size_t)> &body)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    // Nothing to share, skip setting up the shared state
+    if (count == 1)
+    {
+        body(0);
+
+        return;
+    }
+
+    struct State
+    {
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+        size_t count = 0;
+        const std::function<void(size_t)> *body = nullptr;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    auto state = std::make_shared<State>();
+    state->count = count;
+    state->body = &body;
+
+    // Helpers that start after all indices are taken return without touching body
+    auto run = [state]() {
+        size_t index;
+        while ((index = state->next++) < state->count)
+        {
+            (*state->body)(index);
+
+            if (++state->done == state->count)
+            {
+                std::unique_lock<std::mutex> lock(state->mutex);
+
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    auto helpers = std::min(_threads.size(), count - 1);
+    for (size_t i = 0; i < helpers; i++)
+    {
+        Enqueue(run);
+    }
+
+    run();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(lock, [&state]() { return state->done == state->count; });
+}
+
+void ThreadPool::WorkerMain()
+{
+    while (true)
+    {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+
+            _condition.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+
+            if (_stopping && _tasks.empty())
+            {
+                return;
+            }
+
+            task = std::move(_tasks.front());
+            _tasks.pop_front();
+        }
+
+        task();
+    }
+}
@@ -0,0 +1,258 @@
+#include <core/vertexlayout.h>
+
+#include <algorithm>
+#include <cmath>
+#include <core/meshdata.h>
+#include <cstring>
+#include <glad/glad.h>
+
+using namespace gamestart;
+
+namespace // Local utility functions
+{
+    uint16_t FloatToHalf(
+        float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        uint32_t sign = (bits >> 16) & 0x8000;
+        uint32_t exponent = (bits >> 23) & 0xff;
+        uint32_t mantissa = bits & 0x7fffff;
+
+        // NaN and infinity
+        if (exponent == 0xff)
+        {
+            return static_cast<uint16_t>(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+        }
+
+        int halfExponent = static_cast<int>(exponent) - 127 + 15;
+
+        // Too large, clamp to infinity
+        if (halfExponent >= 0x1f)
+        {
+            return static_cast<uint16_t>(sign | 0x7c00);
+        }
+
+        // Subnormal or zero, shift the mantissa including the implicit one into place
+        if (halfExponent <= 0)
+        {
+            if (halfExponent < -10)
+            {
+                return static_cast<uint16_t>(sign);
+            }
+
+            mantissa |= 0x800000;
+
+            auto shift = static_cast<uint32_t>(14 - halfExponent);
+            auto half = mantissa >> shift;
+            auto rest = mantissa & ((1u << shift) - 1);
+            auto halfway = 1u << (shift - 1);
+
+            // Round to nearest even
+            if (rest > halfway || (rest == halfway && (half & 1)))
+            {
+                half++;
+            }
+
+            return static_cast<uint16_t>(sign | half);
+        }
+
+        auto half = (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+        auto rest = mantissa & 0x1fff;
+
+        // Round to nearest even, a carry into the exponent is exactly what should happen
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        {
+            half++;
+        }
+
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t PackNormal(
+        const float *normal)
+    {
+        uint32_t packed = 0;
+
+        for (int k = 0; k < 3; k++)
+        {
+            auto value = static_cast<int32_t>(std::lround(std::clamp(normal[k], -1.0f, 1.0f) * 511.0f));
+
+            packed |= (static_cast<uint32_t>(value) & 0x3ff) << (10 * k);
+        }
+
+        return packed;
+    }
+
+    uint8_t PackUnorm8(
+        float value)
+    {
+        return static_cast<uint8_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+    }
+
+    uint16_t PackUnorm16(
+        float value)
+    {
+        return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+    }
+
+    template <typename T>
+    void Append(
+        unsigned char *&out,
+        T value)
+    {
+        std::memcpy(out, &value, sizeof(T));
+        out += sizeof(T);
+    }
+} // namespace
+
+bool gamestart::IsValidVertexLayout(
+    uint32_t layout)
+{
+    return layout <= static_cast<uint32_t>(VertexLayout::PackedQuantized);
+}
+
+size_t gamestart::VertexStrideFor(
+    VertexLayout layout)
+{
+    switch (layout)
+    {
+        case VertexLayout::Packed:
+            return 3 * sizeof(float) + sizeof(uint32_t) + 4 * sizeof(uint8_t) + 2 * sizeof(uint16_t);
+        case VertexLayout::PackedQuantized:
+            return 4 * sizeof(uint16_t) + sizeof(uint32_t) + 4 * sizeof(uint8_t) + 2 * sizeof(uint16_t);
+        default:
+            return FloatsPerVertex * sizeof(float);
+    }
+}
+
+void gamestart::PackVertices(
+    VertexLayout layout,
+    const float *vertices,
+    size_t vertexCount,
+    const glm::vec3 &bbMin,
+    const glm::vec3 &bbMax,
+    std::vector<unsigned char> &packed)
+{
+    packed.resize(vertexCount * VertexStrideFor(layout));
+
+    if (layout == VertexLayout::Float)
+    {
+        std::memcpy(packed.data(), vertices, packed.size());
+
+        return;
+    }
+
+    glm::vec3 offset, scale;
+    PositionDequantization(layout, bbMin, bbMax, offset, scale);
+
+    auto out = packed.data();
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const float *vertex = &vertices[i * FloatsPerVertex];
+
+        if (layout == VertexLayout::PackedQuantized)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                Append<uint16_t>(out, scale[k] > 0.0f ? PackUnorm16((vertex[k] - offset[k]) / scale[k]) : 0);
+            }
+            Append<uint16_t>(out, 0);
+        }
+        else
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                Append<float>(out, vertex[k]);
+            }
+        }
+
+        Append<uint32_t>(out, PackNormal(vertex + 3));
+
+        Append<uint8_t>(out, PackUnorm8(vertex[6]));
+        Append<uint8_t>(out, PackUnorm8(vertex[7]));
+        Append<uint8_t>(out, PackUnorm8(vertex[8]));
+        Append<uint8_t>(out, 255);
+
+        Append<uint16_t>(out, FloatToHalf(vertex[9]));
+        Append<uint16_t>(out, FloatToHalf(vertex[10]));
+    }
+}
+
+void gamestart::PositionDequantization(
+    VertexLayout layout,
+    const glm::vec3 &bbMin,
+    const glm::vec3 &bbMax,
+    glm::vec3 &offset,
+    glm::vec3 &scale)
+{
+    if (layout == VertexLayout::PackedQuantized)
+    {
+        offset = bbMin;
+        scale = glm::max(bbMax - bbMin, glm::vec3(0.0f));
+    }
+    else
+    {
+        offset = glm::vec3(0.0f);
+        scale = glm::vec3(1.0f);
+    }
+}
+
+VertexLayout gamestart::SupportedVertexLayout(
+    VertexLayout layout)
+{
+    // Signed 2_10_10_10 attributes are core since 3.3, the context we ask for is 3.1
+    if (layout != VertexLayout::Float && !GLAD_GL_VERSION_3_3 && !GLAD_GL_ARB_vertex_type_2_10_10_10_rev)
+    {
+        return VertexLayout::Float;
+    }
+
+    return layout;
+}
+
+void gamestart::SetupVertexAttributes(
+    VertexLayout layout)
+{
+    auto stride = static_cast<GLsizei>(VertexStrideFor(layout));
+
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
+
+    if (layout == VertexLayout::Float)
+    {
+        auto vertexAttribSize = 3 * sizeof(float);
+        auto normalAttribSize = 3 * sizeof(float);
+        auto colorAttribSize = 3 * sizeof(float);
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)vertexAttribSize);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, (void *)(vertexAttribSize + normalAttribSize));
+        glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, stride, (void *)(vertexAttribSize + normalAttribSize + colorAttribSize));
+
+        return;
+    }
+
+    size_t offset = 0;
+
+    if (layout == VertexLayout::PackedQuantized)
+    {
+        glVertexAttribPointer(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void *)offset);
+        offset += 4 * sizeof(uint16_t);
+    }
+    else
+    {
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)offset);
+        offset += 3 * sizeof(float);
+    }
+
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void *)offset);
+    offset += sizeof(uint32_t);
+
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void *)offset);
+    offset += 4 * sizeof(uint8_t);
+
+    glVertexAttribPointer(3, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void *)offset);
+}
@@ -1,4 +1,5 @@
 #include <core/application.h>
+#include <core/assetsmanager.h>
 #include <core/gamelayer.h>
 #include <core/imguilayer.h>
 #include <iostream>
@@ -14,7 +15,10 @@ int main(
 {
     int width = 1024, height = 768;
     bool show_help = false;
+    bool build_pack = false;
     auto cli = lyra::help(show_help) |
+               lyra::opt(build_pack)
+                   ["--build-pack"]("Pack the assets directory into assets.gspak and exit") |
                lyra::opt(width, "width")
                    ["-w"]["--width"]("Game window width") |
                lyra::opt(height, "height")
@@ -38,6 +42,11 @@ int main(
         return 0;
     }
 
+    if (build_pack)
+    {
+        return gamestart::AssetsManager::BuildAssetPack() ? 0 : 1;
+    }
+
     gamestart::Application app(
         "Game Start",
         width,
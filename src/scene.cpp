@@ -1,10 +1,13 @@
 #include <scene.h>
 
+#include <algorithm>
 #include <entities/graphicscomponent.h>
 #include <entities/namecomponent.h>
 #include <entities/transformcomponent.h>
 #include <entt/entt.hpp>
 #include <glad/glad.h>
+#include <unordered_map>
+#include <vector>
 
 using namespace gamestart;
 
@@ -39,30 +42,81 @@ void Scene::SetEntityAsset(
     m_Registry.emplace_or_replace<GraphicsComponent>(e, comp);
 }
 
+bool Scene::GetWorldBounds(
+    entt::entity e,
+    MeshBounds &bounds) const
+{
+    auto component = m_Registry.try_get<LoadedGraphicsAssetComponent>(e);
+    if (component == nullptr || !component->asset->isResident)
+    {
+        return false;
+    }
+
+    MeshBounds assetBounds;
+    assetBounds.bbMin = component->asset->bbMin;
+    assetBounds.bbMax = component->asset->bbMax;
+    assetBounds.center = component->asset->center;
+    assetBounds.radius = component->asset->radius;
+
+    bounds = TransformBounds(assetBounds, m_Registry.get<TransformComponent>(e));
+
+    return true;
+}
+
 void Scene::Initialize(
     AssetsManager &assetsManager)
 {
     auto view = m_Registry.view<GraphicsComponent>();
 
+    // Many entities share a few assets, every distinct asset is loaded once for all of them
+    std::unordered_map<std::string, size_t> assetIndices;
+    std::vector<std::string> assetNames;
+    std::vector<int> references;
+
+    std::vector<entt::entity> entities;
+    std::vector<size_t> entityAssets;
+    entities.reserve(view.size());
+    entityAssets.reserve(view.size());
+
     for (auto entity : view)
     {
-        auto graphicsComponent = m_Registry.get<GraphicsComponent>(entity);
+        auto &graphicsComponent = m_Registry.get<GraphicsComponent>(entity);
 
-        auto loadedAsset = assetsManager.LoadAsset(graphicsComponent.asset);
+        auto found = assetIndices.emplace(graphicsComponent.asset, assetNames.size());
+        if (found.second)
+        {
+            assetNames.push_back(graphicsComponent.asset);
+            references.push_back(0);
+        }
+
+        references[found.first->second]++;
 
-        m_Registry.emplace<LoadedGraphicsAssetComponent>(entity, loadedAsset);
+        entities.push_back(entity);
+        entityAssets.push_back(found.first->second);
     }
+
+    auto loadedAssets = assetsManager.LoadAssetsAsync(assetNames, references);
+
+    std::vector<LoadedGraphicsAssetComponent> components;
+    components.reserve(entities.size());
+    for (auto index : entityAssets)
+    {
+        components.push_back({loadedAssets[index]});
+    }
+
+    m_Registry.insert<LoadedGraphicsAssetComponent>(entities.begin(), entities.end(), components.begin(), components.end());
 }
 
 void Scene::OnResizeEvent(
     int width,
     int height)
 {
-    (void)width;
-    (void)height;
+    m_Width = width;
+    m_Height = height;
 }
 
 void Scene::OnUpdate(
+    AssetsManager &assetsManager,
     uint32_t time)
 {
     (void)time;
@@ -72,27 +126,74 @@ void Scene::OnUpdate(
     {
         auto graphicsComponent = m_Registry.get<LoadedGraphicsAssetComponent>(entity);
 
-        if (graphicsComponent.asset.get()->shaderId == 0)
+        // Still being imported or uploaded, it shows up once it is resident. A failed import was
+        // logged by the AssetsManager and is tried again by the next load of the asset.
+        if (!graphicsComponent.asset.get()->isResident || graphicsComponent.asset.get()->shaderId == 0)
         {
             continue;
         }
 
-        glUseProgram(graphicsComponent.asset.get()->shaderId);
+        // Without a camera the viewport is the upper bound of how large the asset can get on screen
+        assetsManager.RequestTextureResolution(graphicsComponent.asset, float(std::max(m_Width, m_Height)));
+
+        const ShaderProgram *program = nullptr;
 
-        for (auto mesh : graphicsComponent.asset.get()->loadedMeshes)
+        for (auto &mesh : graphicsComponent.asset.get()->loadedMeshes)
         {
             if (mesh.vao == 0)
             {
                 continue;
             }
 
+            auto &materials = graphicsComponent.asset.get()->materials;
+
+            LoadedTexture *texture = nullptr;
+            if (mesh.materialId < materials.size() && materials[mesh.materialId].diffuseTexture != nullptr)
+            {
+                texture = materials[mesh.materialId].diffuseTexture.get();
+            }
+
+            uint32_t features = 0;
+            if (texture != nullptr && texture->textureId != 0)
+            {
+                features |= MeshShaderTextured;
+                if (texture->hasAlpha)
+                {
+                    features |= MeshShaderAlphaTested;
+                }
+            }
+
+            // Falls back on a variant with fewer features while the exact one compiles
+            auto meshProgram = assetsManager.GetMeshShader(features);
+            if (meshProgram == nullptr)
+            {
+                continue;
+            }
+
+            if (meshProgram != program)
+            {
+                program = meshProgram;
+                program->Use();
+                program->Set(ShaderUniform::Texture, 0);
+            }
+
+            if ((features & MeshShaderTextured) != 0)
+            {
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, texture->textureId);
+            }
+
+            program->Set(ShaderUniform::PositionOffset, mesh.positionOffset);
+            program->Set(ShaderUniform::PositionScale, mesh.positionScale);
+
             glBindVertexArray(mesh.vao);
 
-            glDrawArrays(GL_TRIANGLES, 0, 3 * mesh.triangleCount);
+            glDrawElements(GL_TRIANGLES, mesh.indexCount, mesh.indexType, nullptr);
 
             glBindVertexArray(0);
         }
 
+        glBindTexture(GL_TEXTURE_2D, 0);
         glUseProgram(0);
     }
 }
@@ -102,12 +203,16 @@ void Scene::Cleanup(
 {
     auto view = m_Registry.view<LoadedGraphicsAssetComponent>();
 
+    std::unordered_map<std::shared_ptr<LoadedAsset>, int> references;
     for (auto entity : view)
     {
-        auto graphicsComponent = m_Registry.get<LoadedGraphicsAssetComponent>(entity);
-
-        assetsManager.UnloadAsset(graphicsComponent.asset);
+        references[m_Registry.get<LoadedGraphicsAssetComponent>(entity).asset]++;
+    }
 
-        m_Registry.remove<LoadedGraphicsAssetComponent>(entity);
+    for (auto &entry : references)
+    {
+        assetsManager.UnloadAsset(entry.first, entry.second);
     }
+
+    m_Registry.clear<LoadedGraphicsAssetComponent>();
 }
@@ -0,0 +1,241 @@
+#include <core/objconverter.h>
+#include <core/threadpool.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <new>
+#include <spdlog/spdlog.h>
+#include <tiny_obj_loader.h>
+#include <vector>
+
+using namespace gamestart;
+
+// Converts the same parsed mesh twice with one ImportScratch and counts the heap allocations of
+// the second conversion. Every one of them has to be one of the vectors of the MeshData it
+// produces, each allocated once at its exact size, the passes themselves work in the scratch.
+
+namespace // Local utility functions
+{
+    std::atomic<bool> counting{false};
+    std::atomic<size_t> allocationCount{0};
+
+    // Nothing the conversion allocates is over-aligned, the aligned operators are left alone
+    void *Allocate(
+        size_t size)
+    {
+        if (counting)
+        {
+            allocationCount++;
+        }
+
+        auto p = std::malloc(size > 0 ? size : 1);
+        if (p == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+
+        return p;
+    }
+
+    // A grid of size by size quads in the xz plane, with a bump so the normals differ
+    void AddGrid(
+        tinyobj::attrib_t &attrib,
+        tinyobj::shape_t &shape,
+        int size,
+        float offset,
+        bool withNormals,
+        int materialId,
+        unsigned int smoothingGroup)
+    {
+        auto first = static_cast<int>(attrib.vertices.size() / 3);
+        auto firstNormal = static_cast<int>(attrib.normals.size() / 3);
+        auto firstTexcoord = static_cast<int>(attrib.texcoords.size() / 2);
+
+        for (int z = 0; z <= size; z++)
+        {
+            for (int x = 0; x <= size; x++)
+            {
+                auto y = std::sin(x * 0.3f) * std::cos(z * 0.2f);
+                attrib.vertices.insert(attrib.vertices.end(), {offset + float(x), y, float(z)});
+                attrib.normals.insert(attrib.normals.end(), {0.0f, 1.0f, 0.0f});
+                attrib.texcoords.insert(attrib.texcoords.end(), {float(x) / size, float(z) / size});
+            }
+        }
+
+        for (int z = 0; z < size; z++)
+        {
+            for (int x = 0; x < size; x++)
+            {
+                int corner[4] = {z * (size + 1) + x, z * (size + 1) + x + 1, (z + 1) * (size + 1) + x, (z + 1) * (size + 1) + x + 1};
+                int triangles[2][3] = {{corner[0], corner[2], corner[1]}, {corner[1], corner[2], corner[3]}};
+
+                for (auto &triangle : triangles)
+                {
+                    for (auto v : triangle)
+                    {
+                        tinyobj::index_t index;
+                        index.vertex_index = first + v;
+                        index.normal_index = withNormals ? firstNormal + v : -1;
+                        index.texcoord_index = firstTexcoord + v;
+                        shape.mesh.indices.push_back(index);
+                    }
+
+                    shape.mesh.num_face_vertices.push_back(3);
+                    shape.mesh.material_ids.push_back(materialId);
+                    shape.mesh.smoothing_group_ids.push_back(smoothingGroup);
+                }
+            }
+        }
+    }
+
+    // Output vectors that hold anything, each has to be allocated once at its exact size
+    size_t OutputAllocations(
+        const MeshData &meshData,
+        bool &exactSize)
+    {
+        size_t count = 0;
+        exactSize = true;
+
+        auto add = [&count, &exactSize](size_t size, size_t capacity) {
+            if (capacity > 0)
+            {
+                count++;
+            }
+
+            exactSize = exactSize && size == capacity;
+        };
+
+        add(meshData.shapes.size(), meshData.shapes.capacity());
+        add(meshData.materials.size(), meshData.materials.capacity());
+
+        for (auto &shape : meshData.shapes)
+        {
+            add(shape.vertices.size(), shape.vertices.capacity());
+            add(shape.indices.size(), shape.indices.capacity());
+            add(shape.meshlets.size(), shape.meshlets.capacity());
+            add(shape.lodIndices.size(), shape.lodIndices.capacity());
+            add(shape.lods.size(), shape.lods.capacity());
+        }
+
+        return count;
+    }
+
+    bool IsSame(
+        const MeshData &a,
+        const MeshData &b)
+    {
+        if (a.shapes.size() != b.shapes.size())
+        {
+            return false;
+        }
+
+        for (size_t s = 0; s < a.shapes.size(); s++)
+        {
+            auto &x = a.shapes[s];
+            auto &y = b.shapes[s];
+
+            if (x.vertices != y.vertices || x.indices != y.indices || x.lodIndices != y.lodIndices ||
+                x.meshlets.size() != y.meshlets.size() || x.lods.size() != y.lods.size() || x.materialId != y.materialId)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+} // namespace
+
+void *operator new(
+    size_t size)
+{
+    return Allocate(size);
+}
+
+void *operator new[](
+    size_t size)
+{
+    return Allocate(size);
+}
+
+void operator delete(
+    void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](
+    void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(
+    void *p,
+    size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](
+    void *p,
+    size_t) noexcept
+{
+    std::free(p);
+}
+
+int main()
+{
+    // Shapes under 64K faces, so ComputeSmoothingNormals runs its one block on this thread and
+    // the pool never sets up a ParallelFor
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes(3);
+    AddGrid(attrib, shapes[0], 120, 0.0f, false, 0, 1);
+    AddGrid(attrib, shapes[1], 60, 200.0f, true, 1, 0);
+    AddGrid(attrib, shapes[2], 3, 400.0f, false, -1, 2);
+
+    std::vector<tinyobj::material_t> materials(3);
+    materials[0].diffuse[0] = 1.0f;
+    materials[1].diffuse[1] = 1.0f;
+
+    ThreadPool threadPool;
+    ImportScratch scratch;
+    ImportStats stats;
+
+    MeshData first;
+    ConvertObj(first, attrib, shapes, materials, threadPool, true, 4, scratch, stats);
+
+    MeshData second;
+
+    counting = true;
+    ConvertObj(second, attrib, shapes, materials, threadPool, true, 4, scratch, stats);
+    counting = false;
+
+    bool exactSize = false;
+    auto expected = OutputAllocations(second, exactSize);
+
+    spdlog::info("{} allocations converting again, {} output vectors, {} bytes of scratch", allocationCount.load(), expected, scratch.Bytes());
+
+    if (!IsSame(first, second))
+    {
+        spdlog::error("converting the same mesh twice gives different shapes");
+
+        return 1;
+    }
+
+    if (second.shapes[0].lods.empty() || second.shapes[0].meshlets.empty())
+    {
+        spdlog::error("the first shape has no levels of detail or meshlets");
+
+        return 1;
+    }
+
+    if (allocationCount != expected || !exactSize)
+    {
+        spdlog::error("converting again allocated outside the output vectors, or grew them");
+
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,652 @@
+#include <core/objparser.h>
+#include <core/threadpool.h>
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <random>
+#include <spdlog/spdlog.h>
+#include <sstream>
+#include <string>
+#include <tiny_obj_loader.h>
+#include <vector>
+
+using namespace gamestart;
+
+// Generates random OBJ files, well formed and not, and checks that ObjParser gives exactly what
+// tinyobj::LoadObj gives for them. Small files go through the single chunk path, the large ones
+// are split over the threads. Files without out of range vertex indices are streamed as well,
+// and have to give the same triangles read back a few at a time. Pass a seed to reproduce a run.
+
+namespace // Local utility functions
+{
+    const int SmallFileCount = 2000;
+    const int LargeFileCount = 6;
+    const size_t LargeFileSize = 6 * 1024 * 1024;
+
+    const char *MaterialFile =
+        "newmtl red\n"
+        "Kd 1 0 0\n"
+        "Ns 10\n"
+        "newmtl green\n"
+        "Kd 0 1 0\n"
+        "map_Kd green.png\n"
+        "newmtl blue\n"
+        "Kd 0 0 1\n"
+        "d 0.5\n";
+
+    const char *OtherMaterialFile =
+        "newmtl red\n"
+        "Kd 0.5 0 0\n"
+        "newmtl white\n"
+        "Ka 1 1 1\n"
+        "illum 2\n";
+
+    // Reads the mtllib files from memory, so both parsers see exactly the same materials
+    class MemoryMaterialReader : public tinyobj::MaterialReader
+    {
+    public:
+        virtual bool operator()(
+            const std::string &matId,
+            std::vector<tinyobj::material_t> *materials,
+            std::map<std::string, int> *matMap,
+            std::string *warn,
+            std::string *err) override
+        {
+            const char *data = nullptr;
+            if (matId == "a.mtl")
+            {
+                data = MaterialFile;
+            }
+            else if (matId == "b.mtl")
+            {
+                data = OtherMaterialFile;
+            }
+
+            if (data == nullptr)
+            {
+                (*warn) += "Material file [ " + matId + " ] not found.\n";
+
+                return false;
+            }
+
+            std::istringstream stream(data);
+            tinyobj::LoadMtl(matMap, materials, &stream, warn, err);
+
+            return true;
+        }
+    };
+
+    class ObjGenerator
+    {
+    public:
+        ObjGenerator(
+            unsigned int seed)
+            : _random(seed)
+        {}
+
+        // Polygons of the last file may use vertices after them, these triangulate differently
+        // when streamed
+        bool HasOutOfRangeIndices() const
+        {
+            return _outOfRangeIndices;
+        }
+
+        std::string Generate(
+            size_t size)
+        {
+            std::string obj;
+
+            _vertexCount = 0;
+            _normalCount = 0;
+            _texcoordCount = 0;
+            _crlf = Chance(0.2);
+
+            // A zero index fails the whole file, only some files get them
+            _zeroIndices = Chance(0.05);
+            _outOfRangeIndices = Chance(0.5);
+
+            while (obj.size() < size)
+            {
+                Line(obj);
+            }
+
+            // The last line does not always end
+            if (Chance(0.2))
+            {
+                while (!obj.empty() && (obj.back() == '\n' || obj.back() == '\r'))
+                {
+                    obj.pop_back();
+                }
+            }
+
+            return obj;
+        }
+
+    private:
+        std::mt19937 _random;
+        int _vertexCount = 0;
+        int _normalCount = 0;
+        int _texcoordCount = 0;
+        bool _crlf = false;
+        bool _zeroIndices = false;
+        bool _outOfRangeIndices = false;
+
+        bool Chance(
+            double p)
+        {
+            return std::uniform_real_distribution<double>(0.0, 1.0)(_random) < p;
+        }
+
+        int Between(
+            int min,
+            int max)
+        {
+            return std::uniform_int_distribution<int>(min, max)(_random);
+        }
+
+        template <typename T>
+        const T &Pick(
+            const std::vector<T> &options)
+        {
+            return options[Between(0, int(options.size()) - 1)];
+        }
+
+        void Space(
+            std::string &obj)
+        {
+            static const std::vector<std::string> spaces = {" ", " ", " ", "  ", "\t", " \t", "\t\t"};
+
+            obj += Pick(spaces);
+        }
+
+        void EndLine(
+            std::string &obj)
+        {
+            if (Chance(0.05))
+            {
+                Space(obj);
+            }
+
+            obj += _crlf || Chance(0.01) ? "\r\n" : "\n";
+        }
+
+        void Real(
+            std::string &obj)
+        {
+            static const std::vector<std::string> odd = {
+                "0", "-0", "+1", ".5", "-.5", "5.", "1e3", "1E-3", "-2.5e+2", "1.5e", "1e+", "3.4e38", "1e-40",
+                "0001.2500", "+-1", "--1", "1.2.3", "abc", "nan", "inf", "0x10", "1,5", "1e400", "-1e-400", ".", "-",
+                "123456789012345678901234567890", "0.000000000000000000000000000001"};
+
+            if (Chance(0.08))
+            {
+                obj += Pick(odd);
+
+                return;
+            }
+
+            std::ostringstream ss;
+            switch (Between(0, 3))
+            {
+                case 0:
+                {
+                    ss << Between(-1000, 1000);
+                    break;
+                }
+                case 1:
+                {
+                    ss << std::uniform_real_distribution<float>(-100.0f, 100.0f)(_random);
+                    break;
+                }
+                case 2:
+                {
+                    ss.precision(Between(1, 9));
+                    ss << std::scientific << std::uniform_real_distribution<double>(-1e6, 1e6)(_random);
+                    break;
+                }
+                default:
+                {
+                    ss.precision(Between(1, 12));
+                    ss << std::fixed << std::uniform_real_distribution<double>(-1.0, 1.0)(_random);
+                    break;
+                }
+            }
+            obj += ss.str();
+        }
+
+        void Reals(
+            std::string &obj,
+            int min,
+            int max)
+        {
+            auto count = Between(min, max);
+            for (int i = 0; i < count; i++)
+            {
+                Space(obj);
+                Real(obj);
+            }
+        }
+
+        // A valid index most of the time, relative or absolute, sometimes out of range
+        int Index(
+            int count)
+        {
+            if (_zeroIndices && Chance(0.001))
+            {
+                return 0;
+            }
+
+            if (_outOfRangeIndices && Chance(0.005))
+            {
+                return Pick(std::vector<int>{count + 1, count + 1000, -(count + 1)});
+            }
+
+            if (count == 0)
+            {
+                return 1;
+            }
+
+            return Chance(0.2) ? -Between(1, std::min(count, 16)) : Between(1, count);
+        }
+
+        void Face(
+            std::string &obj)
+        {
+            if (_vertexCount == 0 && !_outOfRangeIndices)
+            {
+                obj += "# no vertices yet";
+                return;
+            }
+
+            obj += "f";
+
+            auto format = Between(0, 3);
+            auto count = Chance(0.05) ? Between(0, 2) : Chance(0.01) ? Between(7, 255) : Between(3, 6);
+
+            for (int i = 0; i < count; i++)
+            {
+                Space(obj);
+                obj += std::to_string(Index(_vertexCount));
+
+                // Mixed formats on one line happen too
+                auto vertexFormat = Chance(0.02) ? Between(0, 3) : format;
+                if (vertexFormat == 1 || vertexFormat == 3)
+                {
+                    obj += "/" + std::to_string(Index(_texcoordCount));
+                }
+                else if (vertexFormat == 2)
+                {
+                    obj += "/";
+                }
+
+                if (vertexFormat >= 2)
+                {
+                    obj += "/" + std::to_string(Index(_normalCount));
+                }
+            }
+        }
+
+        void Name(
+            std::string &obj)
+        {
+            static const std::vector<std::string> names = {"a", "Cube", "Cube_Material.001", "group 1", "x\ty", "ü"};
+
+            if (Chance(0.002))
+            {
+                obj += std::string(Between(1000, 70000), 'n');
+            }
+            else
+            {
+                obj += Pick(names);
+            }
+        }
+
+        void Line(
+            std::string &obj)
+        {
+            if (Chance(0.1))
+            {
+                Space(obj);
+            }
+
+            auto kind = Between(0, 99);
+            if (kind < 25)
+            {
+                obj += "v";
+                Reals(obj, 3, 3);
+                if (Chance(0.1))
+                {
+                    // w, or a vertex color
+                    Reals(obj, 1, 3);
+                }
+                else if (Chance(0.01))
+                {
+                    Reals(obj, 0, 2);
+                }
+                _vertexCount++;
+            }
+            else if (kind < 35)
+            {
+                obj += "vn";
+                Reals(obj, Chance(0.01) ? 0 : 3, 3);
+                _normalCount++;
+            }
+            else if (kind < 45)
+            {
+                obj += "vt";
+                Reals(obj, Chance(0.01) ? 0 : 2, 3);
+                _texcoordCount++;
+            }
+            else if (kind < 75)
+            {
+                Face(obj);
+            }
+            else if (kind < 78)
+            {
+                obj += "g";
+                auto count = Between(0, 3);
+                for (int i = 0; i < count; i++)
+                {
+                    Space(obj);
+                    Name(obj);
+                }
+            }
+            else if (kind < 80)
+            {
+                obj += "o";
+                if (Chance(0.9))
+                {
+                    Space(obj);
+                    Name(obj);
+                }
+            }
+            else if (kind < 84)
+            {
+                obj += "usemtl";
+                if (Chance(0.95))
+                {
+                    Space(obj);
+                    obj += Pick(std::vector<std::string>{"red", "green", "blue", "white", "missing"});
+                }
+            }
+            else if (kind < 85)
+            {
+                obj += "mtllib";
+                auto count = Between(0, 2);
+                for (int i = 0; i < count; i++)
+                {
+                    Space(obj);
+                    obj += Pick(std::vector<std::string>{"a.mtl", "b.mtl", "c.mtl"});
+                }
+            }
+            else if (kind < 88)
+            {
+                obj += "s";
+                if (Chance(0.95))
+                {
+                    Space(obj);
+                    obj += Pick(std::vector<std::string>{"off", "0", "1", "2", "12", "on", "x"});
+                }
+            }
+            else if (kind < 92)
+            {
+                obj += "#";
+                if (Chance(0.005))
+                {
+                    obj += std::string(Between(1000, 70000), 'c');
+                }
+                else
+                {
+                    obj += " comment v 1 2 3";
+                }
+            }
+            else if (kind < 95)
+            {
+                // Empty and blank lines
+                if (Chance(0.5))
+                {
+                    Space(obj);
+                }
+            }
+            else
+            {
+                // Junk, and records that are close to known ones
+                static const std::vector<std::string> junk = {
+                    "vx 1 2 3", "vp 1 2", "fo 1 2 3", "gg", "usemtlred", "mg 1", "curv 0 1 2", "Kd 1 1 1", "v", "f", "\x01\x02"};
+
+                obj += Pick(junk);
+            }
+
+            EndLine(obj);
+        }
+    };
+
+    bool SameMaterial(
+        const tinyobj::material_t &a,
+        const tinyobj::material_t &b)
+    {
+        return a.name == b.name &&
+               std::memcmp(a.ambient, b.ambient, sizeof(a.ambient)) == 0 &&
+               std::memcmp(a.diffuse, b.diffuse, sizeof(a.diffuse)) == 0 &&
+               std::memcmp(a.specular, b.specular, sizeof(a.specular)) == 0 &&
+               std::memcmp(a.transmittance, b.transmittance, sizeof(a.transmittance)) == 0 &&
+               std::memcmp(a.emission, b.emission, sizeof(a.emission)) == 0 &&
+               std::memcmp(&a.shininess, &b.shininess, sizeof(a.shininess)) == 0 &&
+               std::memcmp(&a.ior, &b.ior, sizeof(a.ior)) == 0 &&
+               std::memcmp(&a.dissolve, &b.dissolve, sizeof(a.dissolve)) == 0 &&
+               a.illum == b.illum &&
+               a.ambient_texname == b.ambient_texname &&
+               a.diffuse_texname == b.diffuse_texname &&
+               a.specular_texname == b.specular_texname &&
+               a.bump_texname == b.bump_texname &&
+               a.alpha_texname == b.alpha_texname &&
+               a.unknown_parameter == b.unknown_parameter;
+    }
+
+    template <typename T>
+    bool SameBytes(
+        const std::vector<T> &a,
+        const std::vector<T> &b)
+    {
+        return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+    }
+
+    // Empty when both results are the same, otherwise what differs first
+    std::string Compare(
+        const std::string &obj,
+        ThreadPool &threadPool,
+        int &parsed)
+    {
+        MemoryMaterialReader materialReader;
+
+        tinyobj::attrib_t expectedAttrib;
+        std::vector<tinyobj::shape_t> expectedShapes;
+        std::vector<tinyobj::material_t> expectedMaterials;
+        std::string expectedWarn, expectedErr;
+
+        std::istringstream stream(obj);
+        bool expectedResult = tinyobj::LoadObj(&expectedAttrib, &expectedShapes, &expectedMaterials, &expectedWarn, &expectedErr, &stream, &materialReader);
+
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+
+        ObjParser parser(threadPool);
+        bool result = parser.LoadObj(&attrib, &shapes, &materials, &warn, &err, obj.data(), obj.size(), &materialReader);
+
+        if (result != expectedResult) return "return value";
+        if (result) parsed++;
+        if (warn != expectedWarn) return "warnings";
+        if (err != expectedErr) return "errors";
+
+        if (!SameBytes(attrib.vertices, expectedAttrib.vertices)) return "attrib.vertices";
+        if (!SameBytes(attrib.vertex_weights, expectedAttrib.vertex_weights)) return "attrib.vertex_weights";
+        if (!SameBytes(attrib.normals, expectedAttrib.normals)) return "attrib.normals";
+        if (!SameBytes(attrib.texcoords, expectedAttrib.texcoords)) return "attrib.texcoords";
+        if (!SameBytes(attrib.texcoord_ws, expectedAttrib.texcoord_ws)) return "attrib.texcoord_ws";
+        if (!SameBytes(attrib.colors, expectedAttrib.colors)) return "attrib.colors";
+
+        if (shapes.size() != expectedShapes.size()) return "shape count";
+        for (size_t s = 0; s < shapes.size(); s++)
+        {
+            auto &mesh = shapes[s].mesh;
+            auto &expected = expectedShapes[s].mesh;
+
+            if (shapes[s].name != expectedShapes[s].name) return "name of shape " + std::to_string(s);
+            if (!SameBytes(mesh.indices, expected.indices)) return "indices of shape " + std::to_string(s);
+            if (!SameBytes(mesh.num_face_vertices, expected.num_face_vertices)) return "num_face_vertices of shape " + std::to_string(s);
+            if (!SameBytes(mesh.material_ids, expected.material_ids)) return "material_ids of shape " + std::to_string(s);
+            if (!SameBytes(mesh.smoothing_group_ids, expected.smoothing_group_ids)) return "smoothing_group_ids of shape " + std::to_string(s);
+            if (mesh.tags.size() != expected.tags.size()) return "tags of shape " + std::to_string(s);
+            if (!SameBytes(shapes[s].lines.indices, expectedShapes[s].lines.indices)) return "lines of shape " + std::to_string(s);
+            if (!SameBytes(shapes[s].points.indices, expectedShapes[s].points.indices)) return "points of shape " + std::to_string(s);
+        }
+
+        if (materials.size() != expectedMaterials.size()) return "material count";
+        for (size_t m = 0; m < materials.size(); m++)
+        {
+            if (!SameMaterial(materials[m], expectedMaterials[m])) return "material " + std::to_string(m);
+        }
+
+        return std::string();
+    }
+
+    // Empty when reading the triangles of the stream a few at a time gives the non-empty shapes
+    // ObjParser::LoadObj gives, otherwise what differs first
+    std::string CompareStream(
+        const std::string &obj,
+        ThreadPool &threadPool,
+        size_t maxTriangles)
+    {
+        MemoryMaterialReader materialReader;
+
+        tinyobj::attrib_t expectedAttrib;
+        std::vector<tinyobj::shape_t> expectedShapes;
+        std::vector<tinyobj::material_t> expectedMaterials;
+        std::string expectedWarn, expectedErr;
+
+        ObjParser parser(threadPool);
+        if (!parser.LoadObj(&expectedAttrib, &expectedShapes, &expectedMaterials, &expectedWarn, &expectedErr, obj.data(), obj.size(), &materialReader))
+        {
+            return std::string();
+        }
+
+        ObjStream stream;
+        std::string warn, err;
+        if (!parser.LoadObjForStreaming(stream, &warn, &err, obj.data(), obj.size(), &materialReader)) return "return value";
+        if (warn != expectedWarn) return "warnings";
+        if (err != expectedErr) return "errors";
+
+        if (!SameBytes(stream.attrib.vertices, expectedAttrib.vertices)) return "attrib.vertices";
+        if (!SameBytes(stream.attrib.normals, expectedAttrib.normals)) return "attrib.normals";
+        if (!SameBytes(stream.attrib.texcoords, expectedAttrib.texcoords)) return "attrib.texcoords";
+        if (!stream.attrib.colors.empty()) return "attrib.colors";
+
+        if (stream.materials.size() != expectedMaterials.size()) return "material count";
+        for (size_t m = 0; m < stream.materials.size(); m++)
+        {
+            if (!SameMaterial(stream.materials[m], expectedMaterials[m])) return "material " + std::to_string(m);
+        }
+
+        std::vector<tinyobj::shape_t> shapes;
+        for (size_t s = 0; s < stream.shapes.size(); s++)
+        {
+            tinyobj::shape_t shape;
+            tinyobj::shape_t part;
+
+            stream.Rewind(s);
+            while (stream.ReadTriangles(maxTriangles, part))
+            {
+                auto &mesh = shape.mesh;
+                mesh.indices.insert(mesh.indices.end(), part.mesh.indices.begin(), part.mesh.indices.end());
+                mesh.num_face_vertices.insert(mesh.num_face_vertices.end(), part.mesh.num_face_vertices.begin(), part.mesh.num_face_vertices.end());
+                mesh.material_ids.insert(mesh.material_ids.end(), part.mesh.material_ids.begin(), part.mesh.material_ids.end());
+                mesh.smoothing_group_ids.insert(mesh.smoothing_group_ids.end(), part.mesh.smoothing_group_ids.begin(), part.mesh.smoothing_group_ids.end());
+            }
+
+            if (shape.mesh.indices.size() > 3 * stream.shapes[s].triangleCount) return "triangle count of shape " + std::to_string(s);
+
+            bool hasSmoothingGroup = false;
+            for (auto id : shape.mesh.smoothing_group_ids)
+            {
+                hasSmoothingGroup = hasSmoothingGroup || id > 0;
+            }
+            if (hasSmoothingGroup && !stream.shapes[s].hasSmoothingGroup) return "smoothing group of shape " + std::to_string(s);
+
+            if (!shape.mesh.indices.empty())
+            {
+                shape.name = stream.shapes[s].name;
+                shapes.push_back(std::move(shape));
+            }
+        }
+
+        // Shapes whose polygons all fail to triangulate are still in the stream
+        expectedShapes.erase(
+            std::remove_if(expectedShapes.begin(), expectedShapes.end(), [](const tinyobj::shape_t &shape) { return shape.mesh.indices.empty(); }),
+            expectedShapes.end());
+
+        if (shapes.size() != expectedShapes.size()) return "shape count";
+        for (size_t s = 0; s < shapes.size(); s++)
+        {
+            auto &mesh = shapes[s].mesh;
+            auto &expected = expectedShapes[s].mesh;
+
+            if (shapes[s].name != expectedShapes[s].name) return "name of shape " + std::to_string(s);
+            if (!SameBytes(mesh.indices, expected.indices)) return "indices of shape " + std::to_string(s);
+            if (!SameBytes(mesh.num_face_vertices, expected.num_face_vertices)) return "num_face_vertices of shape " + std::to_string(s);
+            if (!SameBytes(mesh.material_ids, expected.material_ids)) return "material_ids of shape " + std::to_string(s);
+            if (!SameBytes(mesh.smoothing_group_ids, expected.smoothing_group_ids)) return "smoothing_group_ids of shape " + std::to_string(s);
+        }
+
+        return std::string();
+    }
+} // namespace
+
+int main(
+    int argc,
+    char *argv[])
+{
+    unsigned int seed = argc > 1 ? static_cast<unsigned int>(std::stoul(argv[1])) : 1;
+
+    ObjGenerator generator(seed);
+
+    // Large files are only split when the pool has workers, whatever the machine has
+    ThreadPool threadPool(3);
+
+    int failures = 0;
+    int parsed = 0;
+    for (int i = 0; i < SmallFileCount + LargeFileCount; i++)
+    {
+        bool large = i >= SmallFileCount;
+        auto obj = generator.Generate(large ? LargeFileSize : size_t(1) << (i % 14));
+
+        auto difference = Compare(obj, threadPool, parsed);
+        if (!difference.empty())
+        {
+            spdlog::error("file {} of seed {} ({} bytes): {} differ", i, seed, obj.size(), difference);
+            failures++;
+        }
+        else if (!generator.HasOutOfRangeIndices())
+        {
+            difference = CompareStream(obj, threadPool, large ? 4096 : 1 + i % 8);
+            if (!difference.empty())
+            {
+                spdlog::error("file {} of seed {} ({} bytes): {} of the stream differ", i, seed, obj.size(), difference);
+                failures++;
+            }
+        }
+    }
+
+    if (failures > 0)
+    {
+        spdlog::error("{} of {} files differ", failures, SmallFileCount + LargeFileCount);
+
+        return 1;
+    }
+
+    spdlog::info("{} files match, {} of them parse without errors", SmallFileCount + LargeFileCount, parsed);
+
+    return 0;
+}